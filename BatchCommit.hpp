@@ -0,0 +1,88 @@
+#pragma once
+
+// Drives the batch commands that rewrite many files (fanOut, remove,
+// applyPatch): each file is prepared into a PendingFile on a pool of
+// threads, and the prepared copies are renamed over the files in batches
+// with one SyncBatch, so durability costs one flush per batch instead of
+// one per file. Results are reported in input order after each batch.
+
+#include "Parallel.hpp"
+#include "ResLib/PendingFile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace BatchCommit
+{
+	// The state of one file that Run passes to prepare and report; commands
+	// derive their slots from it.
+	struct Slot
+	{
+		std::optional<ResLib::PendingFile> pending;     // set by prepare to commit the file
+		std::string error;                              // of prepare or of the commit
+	};
+
+	// The files without the ones listed more than once (by canonical path,
+	// the first is kept).
+	static std::vector<std::string> Unique(std::vector<std::string> const& files)
+	{
+		std::vector<std::string> unique;
+		std::set<std::filesystem::path> seen;
+		for (auto const& file : files)
+		{
+			std::error_code ec;
+			auto path = std::filesystem::weakly_canonical(file, ec);
+			if (seen.insert(ec ? std::filesystem::path(file) : path).second) unique.push_back(file);
+		}
+		return unique;
+	}
+
+	// Calls prepare(file, slot) for every file on up to `threads` threads,
+	// `batchSize` files at a time, commits the pending files of the batch and
+	// calls report(file, slot) for each of them in order; out is flushed after
+	// every batch. What prepare throws ends up in slot.error.
+	template<typename SlotType, typename Prepare, typename Report>
+	static void Run(std::vector<std::string> const& files, size_t threads, size_t batchSize, std::ostream& out, Prepare&& prepare, Report&& report)
+	{
+		for (size_t first = 0; first < files.size(); first += batchSize)
+		{
+			const auto count = std::min(batchSize, files.size() - first);
+			std::vector<SlotType> slots(count);
+			Parallel::ForEach(count, threads, [&](size_t index)
+			{
+				auto& slot = slots[index];
+				try
+				{
+					prepare(files[first + index], slot);
+				}
+				catch (std::exception const& e)
+				{
+					slot.pending.reset();
+					slot.error = e.what();
+					if (slot.error.empty()) slot.error = "unknown error";
+				}
+			});
+
+			ResLib::SyncBatch batch;
+			std::vector<size_t> batched;
+			for (size_t index = 0; index < count; ++index)
+			{
+				if (!slots[index].pending) continue;
+				batch.Add(std::move(*slots[index].pending));
+				slots[index].pending.reset();
+				batched.push_back(index);
+			}
+			const auto commitErrors = batch.Commit();
+			for (size_t i = 0; i < batched.size(); ++i) slots[batched[i]].error = commitErrors[i];
+
+			for (size_t index = 0; index < count; ++index) report(files[first + index], slots[index]);
+			out.flush();
+		}
+	}
+}
@@ -81,6 +81,7 @@ public:
 		_additionalHelp.emplace_back(std::move(s));
 	}
 
+#ifdef _WIN32
 	void Parse(int argc, wchar_t** argv)
 	{
         auto args = std::vector<std::string>();
@@ -88,7 +89,18 @@ public:
         {
             args.emplace_back(Utf8::FromWide(argv[i]));
         }
+        Parse(std::move(args));
+	}
+#endif
+
+	// arguments are expected to be UTF-8 encoded
+	void Parse(int argc, char** argv)
+	{
+		Parse(std::vector<std::string>(argv, argv + argc));
+	}
 
+	void Parse(std::vector<std::string> args)
+	{
 		// find command in args
 		auto pos = std::find_first_of(RANGE(args), RANGE(_commands), 
             [](std::string const& s, CommandSet const& c) 
@@ -108,6 +120,7 @@ public:
 			auto&& value = TakeArg(args, cmdArg.id);
 			if (value.empty())
 			{
+				if (cmdArg.required == RequiredArg::no) continue;
 				throw InvalidCommandArgsException(_parsedArgs.command, std::string("\nerror: argument '") + cmdArg.id + "' is invalid\n");
 			}
 			_parsedArgs.args.emplace(cmdArg.id, std::move(value));
@@ -165,6 +178,11 @@ public:
 		return pos != cend(_parsedArgs.args) ? pos->second : std::string();
 	}
 
+	bool HasValue(std::string const& s) const
+	{
+		return _parsedArgs.args.find(s) != cend(_parsedArgs.args);
+	}
+
 private:
 	static std::string TakeArg(std::vector<std::string>& args, std::string const& tag)
 	{
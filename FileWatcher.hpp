@@ -0,0 +1,166 @@
+#pragma once
+
+// Reports modifications of a fixed set of files. The containing directories
+// are watched rather than the files themselves, so editors and build tools that
+// replace a file (write to a temp file + rename) are noticed as well.
+// Linux uses inotify, Windows directory change notifications.
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "Utf8.hpp"
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+class FileWatcher
+{
+public:
+	explicit FileWatcher(std::vector<std::string> const& files)
+	{
+		for (auto const& file : files)
+		{
+			const auto path = Normalize(file);
+			_files[path.parent_path().string()].insert(path.filename().string());
+		}
+		Open();
+	}
+
+	~FileWatcher() { Close(); }
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// all paths are reported in this form
+	static std::filesystem::path Normalize(std::string const& file)
+	{
+		return std::filesystem::absolute(file).lexically_normal();
+	}
+
+	// Waits up to timeout for changes and returns the watched files that may
+	// have been modified (empty on timeout).
+	std::set<std::string> Wait(std::chrono::milliseconds timeout);
+
+private:
+	void Open();
+	void Close() noexcept;
+
+	// directory -> names of the watched files in it
+	std::map<std::string, std::set<std::string>> _files;
+
+#ifdef _WIN32
+	std::vector<HANDLE> _handles;
+	std::vector<std::string> _directories;
+#else
+	int _fd{ -1 };
+	std::map<int, std::string> _directories;
+#endif
+};
+
+#ifdef _WIN32
+
+inline void FileWatcher::Open()
+{
+	if (_files.size() > MAXIMUM_WAIT_OBJECTS) throw std::runtime_error("Too many directories to watch");
+	for (auto const& [directory, names] : _files)
+	{
+		auto handle = ::FindFirstChangeNotificationW(Utf8::ToWide(directory).c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			const auto err = std::error_code(::GetLastError(), std::system_category());
+			Close();
+			throw std::system_error(err, "Watching directory '" + directory + "' failed");
+		}
+		_handles.push_back(handle);
+		_directories.push_back(directory);
+	}
+}
+
+inline void FileWatcher::Close() noexcept
+{
+	for (auto handle : _handles) ::FindCloseChangeNotification(handle);
+	_handles.clear();
+}
+
+inline std::set<std::string> FileWatcher::Wait(std::chrono::milliseconds timeout)
+{
+	std::set<std::string> changed;
+	auto wait = static_cast<DWORD>(timeout.count());
+	for (;;)
+	{
+		// the notification doesn't tell which file changed, so all files of the directory are reported
+		const auto result = ::WaitForMultipleObjects(static_cast<DWORD>(_handles.size()), _handles.data(), FALSE, wait);
+		if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + _handles.size()) break;
+		const auto index = result - WAIT_OBJECT_0;
+		for (auto const& name : _files[_directories[index]])
+		{
+			changed.insert((std::filesystem::path(_directories[index]) / name).string());
+		}
+		::FindNextChangeNotification(_handles[index]);
+		wait = 0;
+	}
+	return changed;
+}
+
+#else
+
+inline void FileWatcher::Open()
+{
+	_fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (_fd < 0) throw std::system_error(errno, std::generic_category(), "inotify_init1 failed");
+	for (auto const& [directory, names] : _files)
+	{
+		const int wd = ::inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0)
+		{
+			const auto err = errno;
+			Close();
+			throw std::system_error(err, std::generic_category(), "Watching directory '" + directory + "' failed");
+		}
+		_directories[wd] = directory;
+	}
+}
+
+inline void FileWatcher::Close() noexcept
+{
+	if (_fd >= 0) ::close(_fd);
+	_fd = -1;
+}
+
+inline std::set<std::string> FileWatcher::Wait(std::chrono::milliseconds timeout)
+{
+	std::set<std::string> changed;
+	pollfd pfd{ _fd, POLLIN, 0 };
+	if (::poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) return changed;
+
+	alignas(inotify_event) char buffer[16 * 1024];
+	for (;;)
+	{
+		const auto length = ::read(_fd, buffer, sizeof(buffer));
+		if (length <= 0) break;
+		for (const char* pos = buffer; pos < buffer + length;)
+		{
+			auto event = reinterpret_cast<const inotify_event*>(pos);
+			pos += sizeof(inotify_event) + event->len;
+
+			auto directory = _directories.find(event->wd);
+			if (event->len == 0 || directory == _directories.end()) continue;
+			auto const& names = _files[directory->second];
+			if (names.count(event->name)) changed.insert((std::filesystem::path(directory->second) / event->name).string());
+		}
+	}
+	return changed;
+}
+
+#endif
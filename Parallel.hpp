@@ -0,0 +1,56 @@
+#pragma once
+
+// Runs per-file work of the batch commands (validate, search, ...) on a pool
+// of threads, the calling one included.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+	// Calls work(index) for every index in [0, count) on up to `threads`
+	// threads. work must not throw.
+	template<typename Work>
+	static void ForEach(size_t count, size_t threads, Work&& work)
+	{
+		std::atomic<size_t> next{ 0 };
+		auto worker = [&]
+		{
+			for (size_t index; (index = next++) < count;) work(index);
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < std::min(threads, count); ++i) pool.emplace_back(worker);
+		worker();
+		for (auto& thread : pool) thread.join();
+	}
+
+	// Like ForEach, but hands the value work(index) returns to done(index,
+	// value) in index order: each as soon as it and all before it are there,
+	// so output appears while later indexes are still being worked on. done
+	// is called under a lock, one at a time; a value is dropped after it.
+	template<typename Work, typename Done>
+	static void ForEachOrdered(size_t count, size_t threads, Work&& work, Done&& done)
+	{
+		using Value = decltype(work(size_t{ 0 }));
+		std::vector<std::optional<Value>> values(count);
+		std::mutex mutex;
+		size_t nextDone = 0;
+		ForEach(count, threads, [&](size_t index)
+		{
+			auto value = work(index);
+			std::lock_guard lock(mutex);
+			values[index].emplace(std::move(value));
+			for (; nextDone < count && values[nextDone]; ++nextDone)
+			{
+				done(nextDone, *values[nextDone]);
+				values[nextDone].reset();
+			}
+		});
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Writes one resource into many target files. The payload is read once and
+// shared by all workers; each target gets its own update session. Up to
+// `threads` targets are loaded and prepared at the same time, and at most
+// `queueDepth` of them write their updated copy at once. The copies are
+// renamed over the targets in batches of `batchSize` with one SyncBatch, so
+// durability costs one flush per batch instead of one per target. Results
+// are reported in input order, one line per target, after each batch.
+
+#include "BatchCommit.hpp"
+#include "ResLib/ResLib.hpp"
+#include "ResUtil.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResFanOut
+{
+public:
+	struct Options
+	{
+		size_t threads{ 0 };        // 0: one per core
+		size_t queueDepth{ 0 };     // commits in flight, 0: one per thread
+		size_t batchSize{ 256 };    // targets per sync batch
+		ResLib::CommitOptions commit;
+	};
+
+	struct Result
+	{
+		size_t targets{ 0 };
+		size_t written{ 0 };
+		size_t errors{ 0 };
+	};
+
+	ResFanOut(ResLib::ResId type, ResLib::ResId name, uint16_t lang, std::vector<unsigned char> payload, Options const& options)
+		: _type{ std::move(type) }
+		, _name{ std::move(name) }
+		, _lang{ lang }
+		, _payload{ std::move(payload) }
+		, _options{ options }
+	{
+		if (_payload.empty()) throw ResLib::InvalidDataException();
+		if (!_options.threads) _options.threads = std::max(1u, std::thread::hardware_concurrency());
+		if (!_options.queueDepth) _options.queueDepth = _options.threads;
+		if (!_options.batchSize) _options.batchSize = 1;
+	}
+
+	// A target listed more than once is written once.
+	Result Run(std::vector<std::string> const& targets, std::ostream& out, std::ostream& err)
+	{
+		const auto unique = BatchCommit::Unique(targets);
+		std::counting_semaphore<> commits(static_cast<std::ptrdiff_t>(_options.queueDepth));
+		Result result;
+		BatchCommit::Run<BatchCommit::Slot>(unique, _options.threads, _options.batchSize, out,
+			[&](std::string const& target, BatchCommit::Slot& slot) { slot.pending.emplace(Prepare(target, commits)); },
+			[&](std::string const& target, BatchCommit::Slot const& slot)
+		{
+			if (slot.error.empty())
+			{
+				out << target << ": written\n";
+				++result.written;
+			}
+			else
+			{
+				err << target << ": error: " << slot.error << "\n";
+				++result.errors;
+			}
+		});
+
+		result.targets = unique.size();
+		return result;
+	}
+
+private:
+	// the native session on all platforms, for its PendingFile
+	ResLib::PendingFile Prepare(std::string const& target, std::counting_semaphore<>& commits) const
+	{
+		ResLib::NativeUpdateSession session(target.c_str(), _options.commit);
+		session.Set(_type, _name, _lang, _payload.data(), static_cast<uint32_t>(_payload.size()));
+
+		commits.acquire();
+		try
+		{
+			auto pending = session.Prepare();
+			commits.release();
+			return pending;
+		}
+		catch (...)
+		{
+			commits.release();
+			throw;
+		}
+	}
+
+	ResLib::ResId _type;
+	ResLib::ResId _name;
+	uint16_t _lang;
+	std::vector<unsigned char> _payload;
+	Options _options;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "PeImage.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESLIB_BYTESEARCH_SSE2
+#endif
+
+namespace ResLib
+{
+    // Substring search for a fixed byte pattern. Sixteen candidate positions
+    // are tested at once by comparing the first and the last pattern byte
+    // (SSE2); only positions where both match are verified with memcmp, so
+    // for typical patterns the data is scanned at close to memory speed.
+    class ByteSearch
+    {
+    public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        explicit ByteSearch(std::vector<unsigned char> pattern) : _pattern{ std::move(pattern) }
+        {
+            if (_pattern.empty()) throw InvalidArgsException();
+        }
+
+        std::vector<unsigned char> const& Pattern() const noexcept { return _pattern; }
+
+        // offset of the first match at or after from, npos if there is none
+        size_t Find(Pe::Bytes data, size_t from = 0) const noexcept
+        {
+            const size_t size = _pattern.size();
+            if (size > data.size()) return npos;
+            const size_t lastStart = data.size() - size;
+            const auto* const text = data.data();
+            const auto* const pattern = _pattern.data();
+            size_t pos = from;
+
+#ifdef RESLIB_BYTESEARCH_SSE2
+            const auto first = _mm_set1_epi8(static_cast<char>(pattern[0]));
+            const auto last = _mm_set1_epi8(static_cast<char>(pattern[size - 1]));
+            for (; pos + 16 <= lastStart + 1; pos += 16)
+            {
+                const auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+                const auto blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos + size - 1));
+                auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+                while (mask)
+                {
+                    const auto candidate = pos + std::countr_zero(mask);
+                    if (size <= 2 || std::memcmp(text + candidate + 1, pattern + 1, size - 2) == 0) return candidate;
+                    mask &= mask - 1;
+                }
+            }
+#endif
+
+            for (; pos <= lastStart; ++pos)
+            {
+                if (text[pos] == pattern[0] && text[pos + size - 1] == pattern[size - 1]
+                    && (size <= 2 || std::memcmp(text + pos + 1, pattern + 1, size - 2) == 0))
+                {
+                    return pos;
+                }
+            }
+            return npos;
+        }
+
+        // Calls f(size_t offset) for every match, overlapping ones included.
+        // f returns false to stop.
+        template<typename F>
+        void ForEach(Pe::Bytes data, F&& f) const
+        {
+            for (auto pos = Find(data); pos != npos; pos = Find(data, pos + 1))
+            {
+                if (!f(pos)) break;
+            }
+        }
+
+    private:
+        std::vector<unsigned char> _pattern;
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+namespace ResLib
+{
+    struct ResLibException : public std::exception
+    {
+        ResLibException(std::string const& msg)
+            : std::exception()
+            , _msg {msg}
+        {}
+
+        const char* what() const noexcept override { return _msg.c_str(); }
+
+    private:
+        std::string _msg;
+    };
+
+    struct InvalidArgsException : public std::exception {};
+    struct ArgumentNullException : public std::exception {};
+    struct InvalidDataException : public std::exception {};
+
+    struct InvalidFileException : public ResLibException
+    {
+        InvalidFileException(std::string const& msg) : ResLibException(msg) {}
+    };
+
+    // the file could not be opened or mapped at all (as opposed to invalid content)
+    struct FileAccessException : public InvalidFileException
+    {
+        FileAccessException(std::string const& msg) : InvalidFileException(msg) {}
+    };
+
+    struct UpdateResourceException : public ResLibException
+    {
+        UpdateResourceException(std::string const& msg) : ResLibException(msg) {}
+    };
+
+    // the image carries an Authenticode signature that an update would invalidate
+    struct SignedImageException : public UpdateResourceException
+    {
+        SignedImageException(std::string const& msg) : UpdateResourceException(msg) {}
+    };
+
+    struct InvalidResourceException : public ResLibException
+    {
+        InvalidResourceException(std::string const& msg) : ResLibException(msg) {}
+    };
+}
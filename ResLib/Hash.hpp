@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace ResLib
+{
+    namespace Hash
+    {
+        // FNV-1a, 64 bit. Fast and good enough to find candidates for byte-wise
+        // comparison; not meant to identify data on its own.
+        static inline uint64_t Fnv1a64(std::span<const unsigned char> data, uint64_t seed = 0xCBF29CE484222325ull) noexcept
+        {
+            uint64_t hash = seed;
+            for (auto b : data)
+            {
+                hash ^= b;
+                hash *= 0x100000001B3ull;
+            }
+            return hash;
+        }
+
+        using Digest = std::array<unsigned char, 32>;
+
+        // SHA-256 (FIPS 180-4), for identifying data by its hash alone.
+        static inline Digest Sha256(std::span<const unsigned char> data) noexcept
+        {
+            static constexpr uint32_t K[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+            uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+            auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+            auto block = [&](const unsigned char* p)
+            {
+                uint32_t w[64];
+                for (int i = 0; i < 16; ++i) w[i] = uint32_t{ p[4 * i] } << 24 | uint32_t{ p[4 * i + 1] } << 16 | uint32_t{ p[4 * i + 2] } << 8 | p[4 * i + 3];
+                for (int i = 16; i < 64; ++i)
+                {
+                    const auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                    const auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
+                uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+                for (int i = 0; i < 64; ++i)
+                {
+                    const auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                    const auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                    h = g; g = f; f = e; e = d + t1;
+                    d = c; c = b; b = a; a = t1 + t2;
+                }
+                state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+                state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+            };
+
+            size_t pos = 0;
+            for (; pos + 64 <= data.size(); pos += 64) block(data.data() + pos);
+
+            // padding: 0x80, zeros, bit length (big endian) in the last 8 bytes of the last block
+            unsigned char tail[128]{};
+            const size_t rest = data.size() - pos;
+            if (rest) std::memcpy(tail, data.data() + pos, rest);
+            tail[rest] = 0x80;
+            const size_t tailSize = rest < 56 ? 64 : 128;
+            const uint64_t bits = uint64_t{ data.size() } * 8;
+            for (int i = 0; i < 8; ++i) tail[tailSize - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+            block(tail);
+            if (tailSize == 128) block(tail + 64);
+
+            Digest digest;
+            for (int i = 0; i < 8; ++i)
+            {
+                for (int j = 0; j < 4; ++j) digest[4 * i + j] = static_cast<unsigned char>(state[i] >> (24 - 8 * j));
+            }
+            return digest;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "PeImage.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // .ico files and their resource counterparts (RT_ICON images referenced
+    // by an RT_GROUP_ICON directory).
+    namespace Icons
+    {
+        static constexpr size_t DirHeaderSize = 6;         // ICONDIR / GRPICONDIR
+        static constexpr size_t FileEntrySize = 16;        // ICONDIRENTRY
+        static constexpr size_t GroupEntrySize = 14;       // GRPICONDIRENTRY
+        static constexpr uint16_t IconType = 1;
+
+        struct Image
+        {
+            uint8_t width{ 0 };         // 0 means 256
+            uint8_t height{ 0 };
+            uint8_t colorCount{ 0 };
+            uint16_t planes{ 0 };
+            uint16_t bitCount{ 0 };
+            Pe::Bytes data;             // BITMAPINFOHEADER + bits or PNG, points into the .ico file
+        };
+
+        struct GroupEntry
+        {
+            uint8_t width{ 0 };
+            uint8_t height{ 0 };
+            uint8_t colorCount{ 0 };
+            uint16_t planes{ 0 };
+            uint16_t bitCount{ 0 };
+            uint32_t bytesInRes{ 0 };
+            uint16_t id{ 0 };           // RT_ICON id of the image
+        };
+
+        struct ImportResult
+        {
+            size_t added{ 0 };          // images stored as new RT_ICON resources
+            size_t reused{ 0 };         // images already present in the target
+            size_t removed{ 0 };        // images only the replaced group referred to
+        };
+
+        static std::vector<Image> ParseIcoFile(Pe::Bytes file)
+        {
+            if (Pe::Read<uint16_t>(file, 0) != 0 || Pe::Read<uint16_t>(file, 2) != IconType)
+            {
+                throw InvalidFileException("Not an icon file");
+            }
+
+            const auto count = Pe::Read<uint16_t>(file, 4);
+            std::vector<Image> images;
+            images.reserve(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const size_t entry = DirHeaderSize + i * FileEntrySize;
+                Image image;
+                image.width = Pe::Read<uint8_t>(file, entry);
+                image.height = Pe::Read<uint8_t>(file, entry + 1);
+                image.colorCount = Pe::Read<uint8_t>(file, entry + 2);
+                image.planes = Pe::Read<uint16_t>(file, entry + 4);
+                image.bitCount = Pe::Read<uint16_t>(file, entry + 6);
+                const auto size = Pe::Read<uint32_t>(file, entry + 8);
+                const auto offset = Pe::Read<uint32_t>(file, entry + 12);
+                if (size == 0 || offset > file.size() || file.size() - offset < size)
+                {
+                    throw InvalidFileException("Icon image " + std::to_string(i) + " is out of range");
+                }
+                image.data = file.subspan(offset, size);
+                images.emplace_back(image);
+            }
+            return images;
+        }
+
+        static std::vector<GroupEntry> ParseGroup(Pe::Bytes group)
+        {
+            const auto count = Pe::Read<uint16_t>(group, 4);
+            std::vector<GroupEntry> entries;
+            entries.reserve(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const size_t offset = DirHeaderSize + i * GroupEntrySize;
+                GroupEntry entry;
+                entry.width = Pe::Read<uint8_t>(group, offset);
+                entry.height = Pe::Read<uint8_t>(group, offset + 1);
+                entry.colorCount = Pe::Read<uint8_t>(group, offset + 2);
+                entry.planes = Pe::Read<uint16_t>(group, offset + 4);
+                entry.bitCount = Pe::Read<uint16_t>(group, offset + 6);
+                entry.bytesInRes = Pe::Read<uint32_t>(group, offset + 8);
+                entry.id = Pe::Read<uint16_t>(group, offset + 12);
+                entries.emplace_back(entry);
+            }
+            return entries;
+        }
+
+        static std::vector<unsigned char> BuildGroup(std::vector<GroupEntry> const& entries)
+        {
+            std::vector<unsigned char> group(DirHeaderSize + entries.size() * GroupEntrySize);
+            Pe::Write<uint16_t>(group, 0, 0);
+            Pe::Write<uint16_t>(group, 2, IconType);
+            Pe::Write<uint16_t>(group, 4, static_cast<uint16_t>(entries.size()));
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const size_t offset = DirHeaderSize + i * GroupEntrySize;
+                auto const& entry = entries[i];
+                Pe::Write<uint8_t>(group, offset, entry.width);
+                Pe::Write<uint8_t>(group, offset + 1, entry.height);
+                Pe::Write<uint8_t>(group, offset + 2, entry.colorCount);
+                Pe::Write<uint8_t>(group, offset + 3, 0);
+                Pe::Write<uint16_t>(group, offset + 4, entry.planes);
+                Pe::Write<uint16_t>(group, offset + 6, entry.bitCount);
+                Pe::Write<uint32_t>(group, offset + 8, entry.bytesInRes);
+                Pe::Write<uint16_t>(group, offset + 12, entry.id);
+            }
+            return group;
+        }
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "MappedFile.hpp"
+#include "PeImage.hpp"
+#include "ResourceLayout.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // The optional header checksum as computed by CheckSumMappedFile: the
+    // 16 bit one's complement sum of the whole file (the checksum field
+    // excluded) plus the file size.
+    //
+    // A one's complement sum of 16 bit words is the sum modulo 0xFFFF, and as
+    // 0x10000 == 1 (mod 0xFFFF) a 32 bit word contributes the same as its two
+    // halves. Sum() therefore adds plain 32 bit words into 64 bit accumulators,
+    // which the compiler turns into wide vector adds, and reduces only once.
+    namespace Checksum
+    {
+        // A range of the file that changed. before and after may only differ
+        // in size if everything behind the range moved by an even number of
+        // bytes (or is gone), so that it still adds up to the same sum.
+        struct Change
+        {
+            size_t offset{ 0 };     // file offset of the modified range
+            Pe::Bytes before;
+            Pe::Bytes after;
+        };
+
+        // Sum of data placed at the given file offset, modulo 0xFFFF.
+        // A byte at an odd file offset is the high byte of its word.
+        static uint32_t Sum(Pe::Bytes data, size_t offset = 0) noexcept
+        {
+            uint64_t total = 0;
+            size_t i = 0;
+            if (offset & 1 && i < data.size())
+            {
+                total += uint64_t{ data[i] } << 8;
+                ++i;
+            }
+
+            uint64_t acc[4] = {};
+            for (; i + 16 <= data.size(); i += 16)
+            {
+                uint32_t words[4];
+                std::memcpy(words, data.data() + i, sizeof(words));
+                acc[0] += words[0];
+                acc[1] += words[1];
+                acc[2] += words[2];
+                acc[3] += words[3];
+            }
+            total += acc[0] % 0xFFFF + acc[1] % 0xFFFF + acc[2] % 0xFFFF + acc[3] % 0xFFFF;
+
+            for (; i < data.size(); ++i)
+            {
+                total += uint64_t{ data[i] } << (8 * ((offset + i) & 1));
+            }
+            return static_cast<uint32_t>(total % 0xFFFF);
+        }
+
+        // Turns the sum of the whole file (stored checksum included) into the
+        // checksum value, following CheckSumMappedFile step by step.
+        static uint32_t Finish(uint32_t sum, uint32_t storedChecksum, size_t fileSize) noexcept
+        {
+            // the folded sum is never 0 for a non-zero file
+            uint32_t result = sum % 0xFFFF;
+            if (result == 0) result = 0xFFFF;
+
+            auto subtract = [&](uint32_t word)
+            {
+                if ((result & 0xFFFF) >= word) result -= word;
+                else result = ((result - word) & 0xFFFF) - 1;
+            };
+            subtract(storedChecksum & 0xFFFF);
+            subtract(storedChecksum >> 16);
+            return result + static_cast<uint32_t>(fileSize);
+        }
+
+        static uint32_t Compute(Pe::Bytes file, size_t checksumOffset)
+        {
+            return Finish(Sum(file), Pe::Read<uint32_t>(file, checksumOffset), file.size());
+        }
+
+        static uint32_t Compute(Pe::Image const& image)
+        {
+            return Compute(image.Data(), image.CheckSumOffset());
+        }
+
+        // Derives the new checksum from the stored one after the given ranges
+        // changed (checksum field unchanged). Returns nullopt if the stored
+        // value can't be a checksum of a file of the old size (e.g. 0 because
+        // the linker didn't set it); a full Compute() is needed then. A stale
+        // checksum stays stale.
+        static std::optional<uint32_t> Update(uint32_t storedChecksum, size_t oldSize, size_t newSize, size_t checksumOffset, std::span<const Change> changes)
+        {
+            if (storedChecksum == 0 || storedChecksum < oldSize || storedChecksum - oldSize > 0xFFFF) return std::nullopt;
+
+            uint64_t sum = (storedChecksum - oldSize) % 0xFFFF;
+            for (auto const& change : changes)
+            {
+                const auto end = change.offset + std::max(change.before.size(), change.after.size());
+                if (change.offset < checksumOffset + 4 && checksumOffset < end) throw InvalidArgsException();
+                sum += 0xFFFF - Sum(change.before, change.offset);
+                sum += Sum(change.after, change.offset);
+            }
+            sum += (storedChecksum & 0xFFFF) + (storedChecksum >> 16);
+            return Finish(static_cast<uint32_t>(sum % 0xFFFF), storedChecksum, newSize);
+        }
+
+        // Recomputes and stores the checksum of an image in memory.
+        static void Update(std::vector<unsigned char>& file)
+        {
+            const Pe::Image image(file);
+            Pe::Write<uint32_t>(file, image.CheckSumOffset(), Compute(image));
+        }
+
+        // Recomputes and stores the checksum of a file.
+        static void Update(const char* fileName)
+        {
+            MappedFile file(fileName, MappedFile::Access::ReadWrite);
+            const Pe::Image image(file.Data());
+            Pe::Write<uint32_t>(file.MutableData(), image.CheckSumOffset(), Compute(image));
+            file.Flush();
+        }
+    }
+
+    // What a resource update does with an Authenticode signature. Changing
+    // resources invalidates it either way, so the default is to refuse.
+    enum class SignaturePolicy
+    {
+        Refuse,
+        Strip,
+    };
+
+    struct CommitOptions
+    {
+        bool updateChecksum{ false };
+        SignaturePolicy signature{ SignaturePolicy::Refuse };
+        SectionLayout layout;                   // native writer only
+    };
+
+    static bool IsSigned(Pe::Image const& image)
+    {
+        if (image.NumberOfDataDirectories() <= Pe::SecurityDirectory) return false;
+        const auto security = image.GetDataDirectory(Pe::SecurityDirectory);
+        return security.virtualAddress != 0 && security.size != 0;
+    }
+
+    // Removes the certificate table from the file. The table itself is cut
+    // off if it is at the end of the file (where signtool puts it), otherwise
+    // only the directory entry is cleared. Returns false if there was none.
+    static bool StripCertificate(const char* fileName)
+    {
+        if (!fileName) throw ArgumentNullException();
+
+        size_t newSize = 0;
+        size_t oldSize = 0;
+        {
+            MappedFile file(fileName, MappedFile::Access::ReadWrite);
+            const Pe::Image image(file.Data());
+            if (!IsSigned(image)) return false;
+
+            const auto security = image.GetDataDirectory(Pe::SecurityDirectory);
+            const auto offset = image.DataDirectoryOffset(Pe::SecurityDirectory);
+            Pe::Write<uint32_t>(file.MutableData(), offset, 0);
+            Pe::Write<uint32_t>(file.MutableData(), offset + 4, 0);
+            file.Flush();
+
+            oldSize = newSize = file.Size();
+            if (size_t{ security.virtualAddress } + security.size >= oldSize && security.virtualAddress < oldSize) newSize = security.virtualAddress;
+        }
+        if (newSize < oldSize)
+        {
+#ifdef _WIN32
+            std::filesystem::resize_file(Utf8::ToWide(fileName), newSize);
+#else
+            std::filesystem::resize_file(fileName, newSize);
+#endif
+        }
+        return true;
+    }
+
+    // Applies the signature policy to an image about to be updated: throws if
+    // it is signed and signatures are refused. Returns whether the signature
+    // has to be stripped.
+    static bool CheckSignature(Pe::Image const& image, std::string const& fileName, SignaturePolicy policy)
+    {
+        if (!IsSigned(image)) return false;
+        if (policy == SignaturePolicy::Refuse) throw SignedImageException("File '" + fileName + "' is signed; updating its resources would invalidate the signature");
+        return true;
+    }
+}
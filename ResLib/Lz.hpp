@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "PeImage.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // Byte oriented LZ77 block compression in the LZ4 block layout: a
+    // sequence is a token (literal length << 4 | match length - 4), extra
+    // length bytes for either nibble at 15 (each adding up to 255), the
+    // literals and a 16 bit match offset; the last sequence has literals
+    // only. Compression is a single greedy pass with a hash table, so it is
+    // fast but doesn't get near deflate on text; decompression only copies.
+    // The uncompressed size is kept by the caller.
+    namespace Lz
+    {
+        static constexpr size_t MinMatch = 4;
+        static constexpr size_t MaxOffset = 0xFFFF;
+        static constexpr size_t HashBits = 14;
+
+        static uint32_t Read32(const unsigned char* p) noexcept
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static void AppendLength(std::vector<unsigned char>& out, size_t length)
+        {
+            for (; length >= 255; length -= 255) out.push_back(255);
+            out.push_back(static_cast<unsigned char>(length));
+        }
+
+        static void AppendSequence(std::vector<unsigned char>& out, Pe::Bytes literals, size_t offset, size_t matchLength)
+        {
+            const auto extra = matchLength ? matchLength - MinMatch : 0;
+            out.push_back(static_cast<unsigned char>(std::min<size_t>(literals.size(), 15) << 4 | std::min<size_t>(extra, 15)));
+            if (literals.size() >= 15) AppendLength(out, literals.size() - 15);
+            out.insert(out.end(), literals.begin(), literals.end());
+            if (!matchLength) return;
+            out.push_back(static_cast<unsigned char>(offset & 0xFF));
+            out.push_back(static_cast<unsigned char>(offset >> 8));
+            if (extra >= 15) AppendLength(out, extra - 15);
+        }
+
+        static std::vector<unsigned char> Compress(Pe::Bytes data)
+        {
+            std::vector<unsigned char> out;
+            out.reserve(data.size() / 2 + 16);
+            std::vector<uint32_t> table(size_t{ 1 } << HashBits, 0);    // position + 1 of the last occurrence
+            size_t anchor = 0;
+            for (size_t pos = 0; pos + MinMatch <= data.size();)
+            {
+                const auto value = Read32(data.data() + pos);
+                auto& slot = table[(value * 2654435761u) >> (32 - HashBits)];
+                const size_t candidate = slot;
+                slot = static_cast<uint32_t>(pos + 1);
+                if (!candidate || pos - (candidate - 1) > MaxOffset || Read32(data.data() + candidate - 1) != value)
+                {
+                    ++pos;
+                    continue;
+                }
+
+                const auto match = candidate - 1;
+                auto length = MinMatch;
+                while (pos + length < data.size() && data[match + length] == data[pos + length]) ++length;
+                AppendSequence(out, data.subspan(anchor, pos - anchor), pos - match, length);
+                pos += length;
+                anchor = pos;
+            }
+            if (anchor < data.size()) AppendSequence(out, data.subspan(anchor), 0, 0);
+            return out;
+        }
+
+        // Decompresses into out, which has the uncompressed size. Every
+        // length and offset is checked, corrupt input throws.
+        static void Decompress(Pe::Bytes in, std::span<unsigned char> out)
+        {
+            auto fail = [&](size_t at) { throw InvalidFileException("Corrupt compressed data at offset " + std::to_string(at)); };
+            auto readLength = [&](size_t& pos, size_t length)
+            {
+                for (unsigned char b = 255; b == 255; length += b)
+                {
+                    if (pos >= in.size() || length > out.size()) fail(pos);
+                    b = in[pos++];
+                }
+                return length;
+            };
+
+            size_t pos = 0;
+            size_t written = 0;
+            while (pos < in.size())
+            {
+                const auto token = in[pos++];
+                auto literals = static_cast<size_t>(token >> 4);
+                if (literals == 15) literals = readLength(pos, literals);
+                if (literals > in.size() - pos || literals > out.size() - written) fail(pos);
+                std::copy_n(in.begin() + pos, literals, out.begin() + written);
+                pos += literals;
+                written += literals;
+                if (pos == in.size()) break;
+
+                if (in.size() - pos < 2) fail(pos);
+                const size_t offset = in[pos] | static_cast<size_t>(in[pos + 1]) << 8;
+                pos += 2;
+                auto length = static_cast<size_t>(token & 15);
+                if (length == 15) length = readLength(pos, length);
+                length += MinMatch;
+                if (offset == 0 || offset > written || length > out.size() - written) fail(pos);
+                // byte by byte: the match may overlap what it produces
+                for (size_t i = 0; i < length; ++i, ++written) out[written] = out[written - offset];
+            }
+            if (written != out.size()) fail(pos);
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "Exceptions.hpp"
+
+#ifdef _WIN32
+#define VC_EXTRALEAN  // Exclude rarely-used stuff from Windows headers
+#include <Windows.h>
+#include "../Utf8.hpp"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <system_error>
+
+namespace ResLib
+{
+    // Maps a whole file into memory. Used by the native PE parser so that
+    // resources can be inspected (and patched) without loading the image.
+    class MappedFile
+    {
+    public:
+        enum class Access { Read, ReadWrite };
+
+        explicit MappedFile(const char* fileName, Access access = Access::Read)
+            : _fileName{ fileName ? fileName : "" }
+            , _access{ access }
+        {
+            if (!fileName) throw ArgumentNullException();
+            Open();
+        }
+
+        ~MappedFile() { Close(); }
+
+        MappedFile() = delete;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        std::span<const unsigned char> Data() const noexcept { return { _data, _size }; }
+        std::span<unsigned char> MutableData() const
+        {
+            if (_access != Access::ReadWrite) throw InvalidArgsException();
+            return { _data, _size };
+        }
+        size_t Size() const noexcept { return _size; }
+        std::string const& FileName() const noexcept { return _fileName; }
+
+        // writes modified pages back to disk
+        void Flush() const;
+
+    private:
+        void Open();
+        void Close() noexcept;
+
+        [[noreturn]] void Fail(const char* what, std::error_code const& err)
+        {
+            Close();
+            throw FileAccessException(std::string(what) + " '" + _fileName + "' failed: " + err.message());
+        }
+
+        std::string _fileName;
+        Access _access;
+        unsigned char* _data{ nullptr };
+        size_t _size{ 0 };
+#ifdef _WIN32
+        HANDLE _file{ INVALID_HANDLE_VALUE };
+        HANDLE _mapping{ nullptr };
+#else
+        int _fd{ -1 };
+#endif
+    };
+
+#ifdef _WIN32
+
+    inline void MappedFile::Open()
+    {
+        const bool write = _access == Access::ReadWrite;
+        _file = ::CreateFileW(
+            Utf8::ToWide(_fileName).c_str(),
+            write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr);
+        if (_file == INVALID_HANDLE_VALUE) Fail("Opening file", std::error_code(::GetLastError(), std::system_category()));
+
+        LARGE_INTEGER size{};
+        if (!::GetFileSizeEx(_file, &size)) Fail("Getting size of file", std::error_code(::GetLastError(), std::system_category()));
+        if (size.QuadPart == 0) Fail("Mapping empty file", std::make_error_code(std::errc::invalid_argument));
+        _size = static_cast<size_t>(size.QuadPart);
+
+        _mapping = ::CreateFileMappingW(_file, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (!_mapping) Fail("Mapping file", std::error_code(::GetLastError(), std::system_category()));
+
+        _data = static_cast<unsigned char*>(::MapViewOfFile(_mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+        if (!_data) Fail("Mapping view of file", std::error_code(::GetLastError(), std::system_category()));
+    }
+
+    inline void MappedFile::Close() noexcept
+    {
+        if (_data) ::UnmapViewOfFile(_data);
+        if (_mapping) ::CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) ::CloseHandle(_file);
+        _data = nullptr;
+        _mapping = nullptr;
+        _file = INVALID_HANDLE_VALUE;
+    }
+
+    inline void MappedFile::Flush() const
+    {
+        if (_access != Access::ReadWrite) return;
+        if (!::FlushViewOfFile(_data, 0) || !::FlushFileBuffers(_file))
+        {
+            throw InvalidFileException("Flushing file '" + _fileName + "' failed: " + std::error_code(::GetLastError(), std::system_category()).message());
+        }
+    }
+
+#else
+
+    inline void MappedFile::Open()
+    {
+        const bool write = _access == Access::ReadWrite;
+        _fd = ::open(_fileName.c_str(), (write ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+        if (_fd < 0) Fail("Opening file", std::error_code(errno, std::generic_category()));
+
+        struct stat st {};
+        if (::fstat(_fd, &st) != 0) Fail("Getting size of file", std::error_code(errno, std::generic_category()));
+        if (st.st_size == 0) Fail("Mapping empty file", std::make_error_code(std::errc::invalid_argument));
+        _size = static_cast<size_t>(st.st_size);
+
+        void* data = ::mmap(nullptr, _size, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+        if (data == MAP_FAILED) Fail("Mapping file", std::error_code(errno, std::generic_category()));
+        _data = static_cast<unsigned char*>(data);
+    }
+
+    inline void MappedFile::Close() noexcept
+    {
+        if (_data) ::munmap(_data, _size);
+        if (_fd >= 0) ::close(_fd);
+        _data = nullptr;
+        _fd = -1;
+    }
+
+    inline void MappedFile::Flush() const
+    {
+        if (_access != Access::ReadWrite) return;
+        if (::msync(_data, _size, MS_SYNC) != 0 || ::fsync(_fd) != 0)
+        {
+            throw InvalidFileException("Flushing file '" + _fileName + "' failed: " + std::error_code(errno, std::generic_category()).message());
+        }
+    }
+
+#endif
+}
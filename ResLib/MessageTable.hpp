@@ -0,0 +1,179 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "PeImage.hpp"
+#include "ResourceDirectory.hpp"
+#include "ResTypes.h"
+#include "../Utf8.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // Read-only view of an RT_MESSAGETABLE resource (MESSAGE_RESOURCE_DATA).
+    // The constructor builds an index over the blocks and the entry offsets
+    // inside them, lookups are a binary search plus one array access. Text is
+    // only decoded for the requested message. Tables with overlapping blocks,
+    // or with more entries than their size can hold, are rejected.
+    class MessageTable
+    {
+    public:
+        static constexpr uint16_t AnsiFlag = 0x0000;
+        static constexpr uint16_t UnicodeFlag = 0x0001;
+        static constexpr uint16_t Utf8Flag = 0x0002;
+
+        explicit MessageTable(Pe::Bytes data, uint16_t lang = 0) : _data{ data }, _lang{ lang }
+        {
+            const auto numberOfBlocks = Pe::Read<uint32_t>(_data, 0);
+            if (numberOfBlocks > (_data.size() - 4) / 12) throw InvalidResourceException("Message table block count is out of range");
+
+            // every entry takes at least 4 bytes, so blocks that share entries can't make the index larger than the data
+            const uint64_t maxEntries = (_data.size() - 4) / 4;
+            uint64_t entries = 0;
+            _blocks.reserve(numberOfBlocks);
+            for (size_t i = 0; i < numberOfBlocks; ++i)
+            {
+                Block block;
+                block.lowId = Pe::Read<uint32_t>(_data, 4 + i * 12);
+                block.highId = Pe::Read<uint32_t>(_data, 8 + i * 12);
+                const auto offsetToEntries = Pe::Read<uint32_t>(_data, 12 + i * 12);
+                if (block.highId < block.lowId) throw InvalidResourceException("Message table block " + std::to_string(i) + " has an invalid id range");
+                entries += uint64_t{ block.highId } - block.lowId + 1;
+                if (entries > maxEntries) throw InvalidResourceException("Message table has more entries than fit into it");
+
+                // entries are stored back to back, remember where each one starts
+                size_t offset = offsetToEntries;
+                block.firstEntry = _entryOffsets.size();
+                for (uint64_t id = block.lowId; id <= block.highId; ++id)
+                {
+                    const auto length = Pe::Read<uint16_t>(_data, offset);
+                    if (length < 4 || offset + length > _data.size()) throw InvalidResourceException("Message table entry " + std::to_string(id) + " is out of range");
+                    _entryOffsets.push_back(static_cast<uint32_t>(offset));
+                    offset += length;
+                }
+                _blocks.push_back(block);
+            }
+
+            std::sort(_blocks.begin(), _blocks.end(), [](Block const& lhs, Block const& rhs) { return lhs.lowId < rhs.lowId; });
+            for (size_t i = 1; i < _blocks.size(); ++i)
+            {
+                if (_blocks[i].lowId <= _blocks[i - 1].highId) throw InvalidResourceException("Message table blocks overlap at id " + std::to_string(_blocks[i].lowId));
+            }
+        }
+
+        uint16_t Lang() const noexcept { return _lang; }
+        size_t Size() const noexcept { return _entryOffsets.size(); }
+
+        bool Contains(uint32_t id) const noexcept { return FindBlock(id) != nullptr; }
+
+        // message text as UTF-8, trailing nulls removed
+        std::optional<std::string> Find(uint32_t id) const
+        {
+            auto block = FindBlock(id);
+            if (!block) return std::nullopt;
+            return Decode(_entryOffsets[block->firstEntry + (id - block->lowId)]);
+        }
+
+        // calls f(id, text) for every message in ascending id order
+        template<typename F>
+        void ForEach(F&& f) const
+        {
+            for (auto const& block : _blocks)
+            {
+                for (uint64_t id = block.lowId; id <= block.highId; ++id)
+                {
+                    f(static_cast<uint32_t>(id), Decode(_entryOffsets[block.firstEntry + (id - block.lowId)]));
+                }
+            }
+        }
+
+    private:
+        struct Block
+        {
+            uint32_t lowId{ 0 };
+            uint32_t highId{ 0 };
+            size_t firstEntry{ 0 };     // index into _entryOffsets
+        };
+
+        Block const* FindBlock(uint32_t id) const noexcept
+        {
+            auto pos = std::upper_bound(_blocks.begin(), _blocks.end(), id, [](uint32_t value, Block const& block) { return value < block.lowId; });
+            if (pos == _blocks.begin()) return nullptr;
+            --pos;
+            return id <= pos->highId ? &*pos : nullptr;
+        }
+
+        std::string Decode(size_t offset) const
+        {
+            const auto length = Pe::Read<uint16_t>(_data, offset);
+            const auto flags = Pe::Read<uint16_t>(_data, offset + 2);
+            const auto text = _data.subspan(offset + 4, length - 4u);
+
+            std::string result;
+            if (flags & UnicodeFlag)
+            {
+                std::u16string wide(text.size() / 2, u'\0');
+                for (size_t i = 0; i < wide.size(); ++i) wide[i] = static_cast<char16_t>(text[2 * i] | (text[2 * i + 1] << 8));
+                wide.erase(std::find(wide.begin(), wide.end(), u'\0'), wide.end());
+                result = Utf8::FromUtf16(wide);
+            }
+            else if (flags & Utf8Flag)
+            {
+                result.assign(text.begin(), std::find(text.begin(), text.end(), '\0'));
+            }
+            else
+            {
+                // ANSI text: decoded as Latin-1, which matches code page 1252 for nearly all message text
+                std::u16string wide(text.begin(), std::find(text.begin(), text.end(), '\0'));
+                result = Utf8::FromUtf16(wide);
+            }
+            return result;
+        }
+
+        Pe::Bytes _data;
+        uint16_t _lang;
+        std::vector<Block> _blocks;
+        std::vector<uint32_t> _entryOffsets;
+    };
+
+    // All message tables of one module. The file stays mapped for the lifetime
+    // of the object so that any number of ids can be resolved against it.
+    class MessageModule
+    {
+    public:
+        explicit MessageModule(const char* fileName, std::optional<uint16_t> lang = std::nullopt)
+            : _file{ fileName }
+            , _image{ _file.Data() }
+        {
+            ResourceDirectory resources(_image);
+            resources.ForEachOfType(ResId(Types::ResNameToIdMap.at(Types::Strings::Messagetable)), [&](ResourceEntry const& entry)
+            {
+                if (!lang || entry.lang == *lang) _tables.emplace_back(resources.GetData(entry), entry.lang);
+                return true;
+            });
+        }
+
+        std::string const& FileName() const noexcept { return _file.FileName(); }
+        std::vector<MessageTable> const& Tables() const noexcept { return _tables; }
+
+        // first match in directory order (i.e. ordered by language id)
+        std::optional<std::string> Find(uint32_t id) const
+        {
+            for (auto const& table : _tables)
+            {
+                if (auto text = table.Find(id)) return text;
+            }
+            return std::nullopt;
+        }
+
+    private:
+        MappedFile _file;
+        Pe::Image _image;
+        std::vector<MessageTable> _tables;
+    };
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "PeImage.hpp"
+#include "ResourceDirectory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ResLib
+{
+    // A mapped module together with a sorted index of all its resources, so
+    // that repeated lookups don't walk the resource directory again.
+    class Module
+    {
+    public:
+        explicit Module(std::string const& fileName)
+            : _file{ fileName.c_str() }
+            , _image{ _file.Data() }
+            , _resources{ _image }
+        {
+            _resources.ForEach([&](ResourceEntry const& entry)
+            {
+                _index.push_back({ MakeKey(entry.type.ToResId()), MakeKey(entry.name.ToResId()), entry });
+                return true;
+            });
+            std::stable_sort(_index.begin(), _index.end(), [](IndexEntry const& lhs, IndexEntry const& rhs)
+            {
+                return lhs.type < rhs.type || (lhs.type == rhs.type && lhs.name < rhs.name);
+            });
+        }
+
+        std::string const& FileName() const noexcept { return _file.FileName(); }
+        Pe::Bytes Data() const noexcept { return _file.Data(); }
+        Pe::Image const& Image() const noexcept { return _image; }
+        ResourceDirectory const& Resources() const noexcept { return _resources; }
+        size_t Size() const noexcept { return _index.size(); }
+
+        // Same semantics as ResourceDirectory::Find, but a binary search.
+        std::optional<ResourceEntry> Find(ResId const& type, ResId const& name, std::optional<uint16_t> lang = std::nullopt) const
+        {
+            const auto typeKey = MakeKey(type);
+            const auto nameKey = MakeKey(name);
+            auto pos = std::partition_point(_index.begin(), _index.end(), [&](IndexEntry const& entry)
+            {
+                return entry.type < typeKey || (entry.type == typeKey && entry.name < nameKey);
+            });
+            for (; pos != _index.end() && pos->type == typeKey && pos->name == nameKey; ++pos)
+            {
+                if (!lang || pos->entry.lang == *lang) return pos->entry;
+            }
+            return std::nullopt;
+        }
+
+        // Calls f(ResourceEntry const&) for every resource of the given type,
+        // or for all resources if no type is given.
+        template<typename F>
+        void ForEach(std::optional<ResId> const& type, F&& f) const
+        {
+            auto pos = _index.begin();
+            auto end = _index.end();
+            if (type)
+            {
+                const auto typeKey = MakeKey(*type);
+                auto range = std::equal_range(_index.begin(), _index.end(), typeKey, TypeLess{});
+                pos = range.first;
+                end = range.second;
+            }
+            for (; pos != end; ++pos) f(pos->entry);
+        }
+
+    private:
+        struct IndexEntry
+        {
+            ResId type;
+            ResId name;
+            ResourceEntry entry;
+        };
+
+        struct TypeLess
+        {
+            bool operator()(IndexEntry const& entry, ResId const& type) const noexcept { return entry.type < type; }
+            bool operator()(ResId const& type, IndexEntry const& entry) const noexcept { return type < entry.type; }
+        };
+
+        // names compare case insensitive (see ResNameRef::Matches)
+        static ResId MakeKey(ResId id)
+        {
+            for (auto& c : id.name) c = ResNameRef::ToUpper(c);
+            return id;
+        }
+
+        MappedFile _file;
+        Pe::Image _image;
+        ResourceDirectory _resources;
+        std::vector<IndexEntry> _index;
+    };
+
+    // Thread safe LRU cache of opened modules. A module is reopened when the
+    // file's size or modification time changed since it was mapped. Callers
+    // share ownership, so an evicted module stays valid while it is in use.
+    class ModuleCache
+    {
+    public:
+        explicit ModuleCache(size_t capacity) : _capacity{ std::max<size_t>(capacity, 1) } {}
+
+        ModuleCache(const ModuleCache&) = delete;
+        ModuleCache& operator=(const ModuleCache&) = delete;
+
+        std::shared_ptr<const Module> Get(std::string const& fileName)
+        {
+            const auto stamp = GetStamp(fileName);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                auto iter = _map.find(fileName);
+                if (iter != _map.end())
+                {
+                    if (iter->second->stamp == stamp)
+                    {
+                        _lru.splice(_lru.begin(), _lru, iter->second);
+                        ++_hits;
+                        return iter->second->module;
+                    }
+                    _lru.erase(iter->second);
+                    _map.erase(iter);
+                }
+                ++_misses;
+            }
+
+            // opening and indexing happens outside the lock, a concurrent miss on
+            // the same file just does the work twice
+            auto module = std::make_shared<const Module>(fileName);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto iter = _map.find(fileName);
+            if (iter != _map.end())
+            {
+                _lru.erase(iter->second);
+                _map.erase(iter);
+            }
+            _lru.push_front({ fileName, stamp, module });
+            _map.emplace(fileName, _lru.begin());
+            while (_lru.size() > _capacity)
+            {
+                _map.erase(_lru.back().fileName);
+                _lru.pop_back();
+            }
+            return module;
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _map.clear();
+            _lru.clear();
+        }
+
+        size_t Size() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _lru.size();
+        }
+
+        size_t Hits() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _hits;
+        }
+
+        size_t Misses() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _misses;
+        }
+
+    private:
+        struct Stamp
+        {
+            uintmax_t size{ 0 };
+            std::filesystem::file_time_type lastWrite{};
+
+            bool operator==(Stamp const& other) const noexcept { return size == other.size && lastWrite == other.lastWrite; }
+        };
+
+        struct Item
+        {
+            std::string fileName;
+            Stamp stamp;
+            std::shared_ptr<const Module> module;
+        };
+
+        static Stamp GetStamp(std::string const& fileName)
+        {
+            std::error_code err;
+            Stamp stamp;
+            stamp.size = std::filesystem::file_size(fileName, err);
+            if (!err) stamp.lastWrite = std::filesystem::last_write_time(fileName, err);
+            if (err) throw FileAccessException("Accessing file '" + fileName + "' failed: " + err.message());
+            return stamp;
+        }
+
+        const size_t _capacity;
+        mutable std::mutex _mutex;
+        std::list<Item> _lru;
+        std::unordered_map<std::string, std::list<Item>::iterator> _map;
+        size_t _hits{ 0 };
+        size_t _misses{ 0 };
+    };
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "ResTypes.h"
+#include "../Utf8.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ResLib
+{
+    // Result of a type or name enumeration. All string names share a single
+    // UTF-8 buffer and are addressed by offset; numeric ids are stored in the
+    // slot itself and only formatted on request. Adding an entry therefore
+    // doesn't allocate except when one of the two buffers grows.
+    class NameList
+    {
+    public:
+        // one entry; like ResId, an empty name means the entry is an id
+        struct Item
+        {
+            uint16_t id{ 0 };
+            std::string_view name;
+
+            bool IsId() const noexcept { return name.empty(); }
+            std::string ToString() const { return IsId() ? std::to_string(id) : std::string(name); }
+            std::string ToTypeString() const { return IsId() ? Types::GetTypeName(id) : std::string(name); }
+        };
+
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Item;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Item;
+
+            const_iterator(NameList const* list, size_t index) noexcept : _list{ list }, _index{ index } {}
+
+            Item operator*() const noexcept { return (*_list)[_index]; }
+            const_iterator& operator++() noexcept { ++_index; return *this; }
+            const_iterator operator++(int) noexcept { auto copy = *this; ++_index; return copy; }
+            friend bool operator==(const_iterator const& lhs, const_iterator const& rhs) noexcept { return lhs._index == rhs._index; }
+            friend bool operator!=(const_iterator const& lhs, const_iterator const& rhs) noexcept { return lhs._index != rhs._index; }
+
+        private:
+            NameList const* _list;
+            size_t _index;
+        };
+
+        void Reserve(size_t count, size_t nameBytes)
+        {
+            _slots.reserve(count);
+            _names.reserve(nameBytes);
+        }
+
+        void Add(uint16_t id)
+        {
+            _slots.push_back({ id, 0 });
+        }
+
+        void Add(std::string_view name)
+        {
+            if (name.empty()) throw InvalidArgsException();
+            const auto offset = static_cast<uint32_t>(_names.size());
+            _names.append(name);
+            _slots.push_back({ offset, static_cast<uint32_t>(name.size()) });
+        }
+
+        // converts the name straight into the buffer
+        void Add(std::u16string_view name)
+        {
+            if (name.empty()) throw InvalidArgsException();
+            const auto offset = static_cast<uint32_t>(_names.size());
+            Utf8::AppendFromUtf16(_names, name);
+            _slots.push_back({ offset, static_cast<uint32_t>(_names.size() - offset) });
+        }
+
+        size_t Size() const noexcept { return _slots.size(); }
+        bool Empty() const noexcept { return _slots.empty(); }
+
+        // views stay valid until the next Add
+        Item operator[](size_t index) const noexcept
+        {
+            auto const& slot = _slots[index];
+            if (slot.size == 0) return { static_cast<uint16_t>(slot.offset), {} };
+            return { 0, std::string_view(_names.data() + slot.offset, slot.size) };
+        }
+
+        const_iterator begin() const noexcept { return { this, 0 }; }
+        const_iterator end() const noexcept { return { this, _slots.size() }; }
+
+        // ids formatted as numbers
+        std::vector<std::string> ToStrings() const
+        {
+            std::vector<std::string> result;
+            result.reserve(Size());
+            for (auto const& item : *this) result.emplace_back(item.ToString());
+            return result;
+        }
+
+        // predefined type ids formatted by name ("icon", "version", ...)
+        std::vector<std::string> ToTypeStrings() const
+        {
+            std::vector<std::string> result;
+            result.reserve(Size());
+            for (auto const& item : *this) result.emplace_back(item.ToTypeString());
+            return result;
+        }
+
+    private:
+        struct Slot
+        {
+            uint32_t offset;    // into _names, or the id if size is 0
+            uint32_t size;
+        };
+
+        std::string _names;
+        std::vector<Slot> _slots;
+    };
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "Exceptions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // Minimal, platform independent view of a PE image held in memory (usually a
+    // MappedFile). All reads are bounds checked against the underlying buffer.
+    // Values are stored little endian in the file, which matches all supported hosts.
+    namespace Pe
+    {
+        using Bytes = std::span<const unsigned char>;
+        using MutableBytes = std::span<unsigned char>;
+
+        static constexpr uint16_t DosSignature = 0x5A4D;          // "MZ"
+        static constexpr uint32_t NtSignature = 0x00004550;       // "PE\0\0"
+        static constexpr uint16_t Pe32Magic = 0x10B;
+        static constexpr uint16_t Pe32PlusMagic = 0x20B;
+        static constexpr size_t SectionHeaderSize = 40;
+
+        static constexpr uint16_t MachineI386 = 0x014C;
+        static constexpr uint16_t MachineAmd64 = 0x8664;
+        static constexpr uint16_t MachineArm64 = 0xAA64;
+
+        enum DirectoryIndex : uint32_t
+        {
+            ExportDirectory = 0,
+            ImportDirectory = 1,
+            ResourceDirectory = 2,
+            ExceptionDirectory = 3,
+            SecurityDirectory = 4,
+            BaseRelocDirectory = 5,
+            DebugDirectory = 6,
+        };
+
+        template<typename T>
+        static T Read(Bytes data, size_t offset)
+        {
+            if (offset > data.size() || data.size() - offset < sizeof(T))
+            {
+                throw InvalidFileException("Read of " + std::to_string(sizeof(T)) + " bytes at offset " + std::to_string(offset) + " is out of range");
+            }
+            T value{};
+            std::memcpy(&value, data.data() + offset, sizeof(T));
+            return value;
+        }
+
+        template<typename T>
+        static void Write(MutableBytes data, size_t offset, T value)
+        {
+            if (offset > data.size() || data.size() - offset < sizeof(T))
+            {
+                throw InvalidFileException("Write of " + std::to_string(sizeof(T)) + " bytes at offset " + std::to_string(offset) + " is out of range");
+            }
+            std::memcpy(data.data() + offset, &value, sizeof(T));
+        }
+
+        static constexpr uint32_t AlignUp(uint32_t value, uint32_t alignment) noexcept
+        {
+            return alignment ? (value + alignment - 1) / alignment * alignment : value;
+        }
+
+        struct DataDirectory
+        {
+            uint32_t virtualAddress{ 0 };
+            uint32_t size{ 0 };
+        };
+
+        struct Section
+        {
+            std::string name;
+            uint32_t virtualSize{ 0 };
+            uint32_t virtualAddress{ 0 };
+            uint32_t sizeOfRawData{ 0 };
+            uint32_t pointerToRawData{ 0 };
+            uint32_t characteristics{ 0 };
+            size_t headerOffset{ 0 };   // file offset of the IMAGE_SECTION_HEADER
+
+            bool ContainsRva(uint32_t rva) const noexcept
+            {
+                const auto extent = virtualSize ? virtualSize : sizeOfRawData;
+                return rva >= virtualAddress && rva - virtualAddress < extent;
+            }
+        };
+
+        class Image
+        {
+        public:
+            explicit Image(Bytes data) : _data{ data }
+            {
+                if (Read<uint16_t>(_data, 0) != DosSignature) throw InvalidFileException("Missing DOS signature");
+                _ntHeaderOffset = Read<uint32_t>(_data, 0x3C);
+                if (Read<uint32_t>(_data, _ntHeaderOffset) != NtSignature) throw InvalidFileException("Missing PE signature");
+
+                const size_t fileHeader = _ntHeaderOffset + 4;
+                const auto numberOfSections = Read<uint16_t>(_data, fileHeader + 2);
+                const auto sizeOfOptionalHeader = Read<uint16_t>(_data, fileHeader + 16);
+
+                _optionalHeaderOffset = fileHeader + 20;
+                const auto magic = Read<uint16_t>(_data, _optionalHeaderOffset);
+                if (magic != Pe32Magic && magic != Pe32PlusMagic) throw InvalidFileException("Unknown optional header magic");
+                _pe32Plus = magic == Pe32PlusMagic;
+
+                _dataDirectoryOffset = _optionalHeaderOffset + (_pe32Plus ? 112 : 96);
+                _numberOfDataDirectories = Read<uint32_t>(_data, _dataDirectoryOffset - 4);
+                if (_dataDirectoryOffset + size_t{ 8 } * _numberOfDataDirectories > _optionalHeaderOffset + sizeOfOptionalHeader)
+                {
+                    _numberOfDataDirectories = static_cast<uint32_t>((_optionalHeaderOffset + sizeOfOptionalHeader - std::min<size_t>(_dataDirectoryOffset, _optionalHeaderOffset + sizeOfOptionalHeader)) / 8);
+                }
+
+                _sectionTableOffset = _optionalHeaderOffset + sizeOfOptionalHeader;
+                _sections.reserve(numberOfSections);
+                for (size_t i = 0; i < numberOfSections; ++i)
+                {
+                    const size_t offset = _sectionTableOffset + i * SectionHeaderSize;
+                    Section section;
+                    const auto name = Read<std::array<char, 8>>(_data, offset);
+                    section.name.assign(name.data(), std::find(name.begin(), name.end(), '\0'));
+                    section.virtualSize = Read<uint32_t>(_data, offset + 8);
+                    section.virtualAddress = Read<uint32_t>(_data, offset + 12);
+                    section.sizeOfRawData = Read<uint32_t>(_data, offset + 16);
+                    section.pointerToRawData = Read<uint32_t>(_data, offset + 20);
+                    section.characteristics = Read<uint32_t>(_data, offset + 36);
+                    section.headerOffset = offset;
+                    _sections.emplace_back(std::move(section));
+                }
+            }
+
+            Bytes Data() const noexcept { return _data; }
+            bool IsPe32Plus() const noexcept { return _pe32Plus; }
+
+            size_t NtHeaderOffset() const noexcept { return _ntHeaderOffset; }
+            size_t NumberOfSectionsOffset() const noexcept { return _ntHeaderOffset + 6; }
+            size_t OptionalHeaderOffset() const noexcept { return _optionalHeaderOffset; }
+            size_t SizeOfInitializedDataOffset() const noexcept { return _optionalHeaderOffset + 8; }
+            size_t SizeOfImageOffset() const noexcept { return _optionalHeaderOffset + 56; }
+            size_t CheckSumOffset() const noexcept { return _optionalHeaderOffset + 64; }
+            size_t SectionTableOffset() const noexcept { return _sectionTableOffset; }
+
+            uint32_t SectionAlignment() const { return Read<uint32_t>(_data, _optionalHeaderOffset + 32); }
+            uint32_t FileAlignment() const { return Read<uint32_t>(_data, _optionalHeaderOffset + 36); }
+            uint32_t SizeOfImage() const { return Read<uint32_t>(_data, SizeOfImageOffset()); }
+            uint32_t SizeOfHeaders() const { return Read<uint32_t>(_data, _optionalHeaderOffset + 60); }
+            uint32_t CheckSum() const { return Read<uint32_t>(_data, CheckSumOffset()); }
+
+            uint32_t NumberOfDataDirectories() const noexcept { return _numberOfDataDirectories; }
+
+            size_t DataDirectoryOffset(uint32_t index) const
+            {
+                if (index >= _numberOfDataDirectories) throw InvalidFileException("Data directory " + std::to_string(index) + " does not exist");
+                return _dataDirectoryOffset + size_t{ 8 } * index;
+            }
+
+            DataDirectory GetDataDirectory(uint32_t index) const
+            {
+                if (index >= _numberOfDataDirectories) return {};
+                const auto offset = DataDirectoryOffset(index);
+                return { Read<uint32_t>(_data, offset), Read<uint32_t>(_data, offset + 4) };
+            }
+
+            std::vector<Section> const& Sections() const noexcept { return _sections; }
+
+            Section const* FindSection(uint32_t rva) const noexcept
+            {
+                for (auto const& section : _sections)
+                {
+                    if (section.ContainsRva(rva)) return &section;
+                }
+                return nullptr;
+            }
+
+            // Translates an RVA into a file offset. Fails if [rva, rva + size) is not
+            // backed by file data.
+            std::optional<size_t> RvaToOffset(uint32_t rva, uint32_t size = 0) const
+            {
+                size_t offset = 0;
+                if (rva < SizeOfHeaders())
+                {
+                    offset = rva;
+                }
+                else
+                {
+                    auto section = FindSection(rva);
+                    if (!section) return std::nullopt;
+                    const auto delta = rva - section->virtualAddress;
+                    if (delta > section->sizeOfRawData || section->sizeOfRawData - delta < size) return std::nullopt;
+                    offset = size_t{ section->pointerToRawData } + delta;
+                }
+
+                if (offset > _data.size() || _data.size() - offset < size) return std::nullopt;
+                return offset;
+            }
+
+            // End of the last section's raw data; anything behind it is overlay data.
+            size_t EndOfSectionData() const noexcept
+            {
+                size_t end = 0;
+                for (auto const& section : _sections)
+                {
+                    if (section.sizeOfRawData) end = std::max<size_t>(end, size_t{ section.pointerToRawData } + section.sizeOfRawData);
+                }
+                return end;
+            }
+
+        private:
+            Bytes _data;
+            bool _pe32Plus{ false };
+            size_t _ntHeaderOffset{ 0 };
+            size_t _optionalHeaderOffset{ 0 };
+            size_t _dataDirectoryOffset{ 0 };
+            size_t _sectionTableOffset{ 0 };
+            uint32_t _numberOfDataDirectories{ 0 };
+            std::vector<Section> _sections;
+        };
+    }
+}
@@ -0,0 +1,445 @@
+#pragma once
+
+#include "Exceptions.hpp"
+
+#ifdef _WIN32
+#define VC_EXTRALEAN  // Exclude rarely-used stuff from Windows headers
+#include <Windows.h>
+#include "../Utf8.hpp"
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#define RESLIB_PENDINGFILE_SYNCFS
+#endif
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace ResLib
+{
+    // The new version of a file, written to a temporary file next to it and
+    // renamed over the original on Commit. A crash leaves either the old or
+    // the complete new file behind (plus possibly a stray temporary), never
+    // a half written one. An uncommitted temporary is removed again.
+    //
+    // On Linux the temporary starts as a reflink clone of the original where
+    // the file system supports it (btrfs, XFS, ...), so it shares all blocks
+    // that aren't rewritten; otherwise it starts empty and the caller writes
+    // the whole file. A symlinked target is resolved, the link stays. Other
+    // hard links of the target keep the old content.
+    //
+    // A target that exists but isn't a regular file (a FIFO, /dev/null, a
+    // console) can't be replaced by renaming; it is written to directly:
+    // TempName() is the target itself and Commit() does nothing.
+    class PendingFile
+    {
+    public:
+        explicit PendingFile(std::string target, bool clone = true)
+            : _target{ std::move(target) }
+        {
+            Create(clone);
+        }
+
+        ~PendingFile()
+        {
+            if (_tempName.empty() || _committed || _direct) return;
+            std::error_code ec;
+            std::filesystem::remove(ToPath(_tempName), ec);
+        }
+
+        PendingFile(PendingFile&& other) noexcept
+            : _target{ std::move(other._target) }
+            , _tempName{ std::exchange(other._tempName, std::string()) }
+            , _cloned{ other._cloned }
+            , _direct{ other._direct }
+            , _committed{ other._committed }
+        {}
+
+        PendingFile& operator=(PendingFile&&) = delete;
+        PendingFile(const PendingFile&) = delete;
+        PendingFile& operator=(const PendingFile&) = delete;
+
+        std::string const& Target() const noexcept { return _target; }
+        std::string const& TempName() const noexcept { return _tempName; }
+
+        // true if the temporary has the content of the target, false if it is empty
+        bool Cloned() const noexcept { return _cloned; }
+
+        // true if the target isn't a regular file and TempName() is the target
+        bool Direct() const noexcept { return _direct; }
+
+        // Makes the new content durable, replaces the target and makes the
+        // rename durable. SyncBatch does the same for many files at once.
+        void Commit()
+        {
+            Sync();
+            Rename();
+            SyncDirectory(Directory());
+        }
+
+        // flushes the temporary file to disk
+        void Sync() const
+        {
+            if (!_direct) SyncFile(_tempName);
+        }
+
+        // flushes a file written by other means to disk
+        static void SyncFile(std::string const& fileName)
+        {
+#ifdef _WIN32
+            HANDLE file = ::CreateFileW(Utf8::ToWide(fileName).c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            const bool ok = file != INVALID_HANDLE_VALUE && ::FlushFileBuffers(file);
+            const auto error = ::GetLastError();
+            if (file != INVALID_HANDLE_VALUE) ::CloseHandle(file);
+            if (!ok) throw FileAccessException("Flushing file '" + fileName + "' failed: " + std::system_category().message(static_cast<int>(error)));
+#else
+            const int file = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0 || ::fsync(file) != 0)
+            {
+                const auto error = errno;
+                if (file >= 0) ::close(file);
+                throw FileAccessException("Flushing file '" + fileName + "' failed: " + std::generic_category().message(error));
+            }
+            ::close(file);
+#endif
+        }
+
+        // atomically replaces the target by the temporary file
+        void Rename()
+        {
+            if (_direct)
+            {
+                _committed = true;
+                return;
+            }
+#ifdef _WIN32
+            if (!::MoveFileExW(Utf8::ToWide(_tempName).c_str(), Utf8::ToWide(_target).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            {
+                throw FileAccessException("Replacing file '" + _target + "' failed: " + std::system_category().message(static_cast<int>(::GetLastError())));
+            }
+#else
+            if (::rename(_tempName.c_str(), _target.c_str()) != 0)
+            {
+                throw FileAccessException("Replacing file '" + _target + "' failed: " + std::generic_category().message(errno));
+            }
+#endif
+            _committed = true;
+        }
+
+        std::string Directory() const
+        {
+            const auto slash = _target.find_last_of(Separators);
+            return slash == std::string::npos ? std::string(".") : slash == 0 ? _target.substr(0, 1) : _target.substr(0, slash);
+        }
+
+        // Makes renames in the directory durable. NTFS journals them, there
+        // is nothing to do on Windows.
+        static void SyncDirectory([[maybe_unused]] std::string const& directory)
+        {
+#ifndef _WIN32
+            const int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir < 0 || ::fsync(dir) != 0)
+            {
+                const auto error = errno;
+                if (dir >= 0) ::close(dir);
+                throw FileAccessException("Flushing directory '" + directory + "' failed: " + std::generic_category().message(error));
+            }
+            ::close(dir);
+#endif
+        }
+
+        static std::filesystem::path ToPath(std::string const& fileName)
+        {
+#ifdef _WIN32
+            return std::filesystem::path(Utf8::ToWide(fileName));
+#else
+            return std::filesystem::path(fileName);
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        static constexpr const char* Separators = "\\/";
+#else
+        static constexpr const char* Separators = "/";
+#endif
+
+        static std::string RandomSuffix()
+        {
+            std::random_device random;
+            const uint64_t value = (uint64_t{ random() } << 32) | random();
+            char suffix[24];
+            std::snprintf(suffix, sizeof(suffix), ".~%016llx", static_cast<unsigned long long>(value));
+            return suffix;
+        }
+
+#ifdef _WIN32
+        void Create(bool /*clone*/)
+        {
+            // devices and pipes
+            HANDLE target = ::CreateFileW(Utf8::ToWide(_target).c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (target != INVALID_HANDLE_VALUE)
+            {
+                const auto type = ::GetFileType(target);
+                ::CloseHandle(target);
+                if (type == FILE_TYPE_CHAR || type == FILE_TYPE_PIPE)
+                {
+                    _tempName = _target;
+                    _direct = true;
+                    return;
+                }
+            }
+
+            for (int attempt = 0; _tempName.empty(); ++attempt)
+            {
+                auto name = _target + RandomSuffix();
+                HANDLE file = ::CreateFileW(Utf8::ToWide(name).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (file != INVALID_HANDLE_VALUE)
+                {
+                    ::CloseHandle(file);
+                    _tempName = std::move(name);
+                }
+                else if (::GetLastError() != ERROR_FILE_EXISTS || attempt == 9)
+                {
+                    throw FileAccessException("Creating a temporary file next to '" + _target + "' failed: " + std::system_category().message(static_cast<int>(::GetLastError())));
+                }
+            }
+        }
+#else
+        void Create(bool clone)
+        {
+            // rename would replace the link itself
+            struct stat info {};
+            if (::lstat(_target.c_str(), &info) == 0 && S_ISLNK(info.st_mode))
+            {
+                std::error_code ec;
+                auto resolved = std::filesystem::canonical(_target, ec);
+                if (!ec) _target = resolved.string();
+            }
+
+            const bool exists = ::stat(_target.c_str(), &info) == 0;
+            if (!exists && errno != ENOENT) throw FileAccessException("Opening file '" + _target + "' failed: " + std::generic_category().message(errno));
+            if (exists && !S_ISREG(info.st_mode))
+            {
+                _tempName = _target;
+                _direct = true;
+                return;
+            }
+
+            int temp = -1;
+            for (int attempt = 0; temp < 0; ++attempt)
+            {
+                auto name = _target + RandomSuffix();
+                temp = ::open(name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, exists ? 0600 : 0666);
+                if (temp >= 0)
+                {
+                    _tempName = std::move(name);
+                }
+                else if (errno != EEXIST || attempt == 9)
+                {
+                    throw FileAccessException("Creating a temporary file next to '" + _target + "' failed: " + std::generic_category().message(errno));
+                }
+            }
+
+            if (exists)
+            {
+                // keep mode and (if permitted) owner of the original
+                if (::fchmod(temp, info.st_mode & 07777) != 0 || ::fchown(temp, info.st_uid, info.st_gid) != 0) {}
+#ifdef FICLONE
+                if (clone)
+                {
+                    const int source = ::open(_target.c_str(), O_RDONLY | O_CLOEXEC);
+                    _cloned = source >= 0 && ::ioctl(temp, FICLONE, source) == 0;
+                    if (source >= 0) ::close(source);
+                }
+#else
+                (void)clone;
+#endif
+            }
+            ::close(temp);
+        }
+#endif
+
+        std::string _target;
+        std::string _tempName;
+        bool _cloned{ false };
+        bool _direct{ false };
+        bool _committed{ false };
+    };
+
+    // Commits many pending files with one durability barrier for all of them
+    // instead of one per file: on Linux syncfs() flushes each file system the
+    // files are on once before and once after the renames. Elsewhere every
+    // file is flushed on its own, but directories only once.
+    class SyncBatch
+    {
+    public:
+        void Add(PendingFile file)
+        {
+            _files.emplace_back(std::move(file));
+        }
+
+        size_t Size() const noexcept { return _files.size(); }
+
+        // Returns an error message per file in the order they were added,
+        // empty for the ones that were replaced. If flushing fails, no file
+        // is replaced.
+        std::vector<std::string> Commit()
+        {
+            std::vector<std::string> errors(_files.size());
+            std::vector<std::string> directories;
+            for (auto const& file : _files)
+            {
+                auto directory = file.Directory();
+                if (std::find(directories.begin(), directories.end(), directory) == directories.end()) directories.push_back(std::move(directory));
+            }
+
+            auto failAll = [&](std::string const& message)
+            {
+                for (auto& error : errors) error = message;
+                _files.clear();
+                return errors;
+            };
+
+            try
+            {
+#ifdef RESLIB_PENDINGFILE_SYNCFS
+                SyncFileSystems(directories);
+#else
+                for (auto const& file : _files) file.Sync();
+#endif
+            }
+            catch (std::exception const& e)
+            {
+                return failAll(e.what());
+            }
+
+            for (size_t i = 0; i < _files.size(); ++i)
+            {
+                try
+                {
+                    _files[i].Rename();
+                }
+                catch (std::exception const& e)
+                {
+                    errors[i] = e.what();
+                }
+            }
+
+            try
+            {
+#ifdef RESLIB_PENDINGFILE_SYNCFS
+                SyncFileSystems(directories);
+#else
+                for (auto const& directory : directories) PendingFile::SyncDirectory(directory);
+#endif
+            }
+            catch (std::exception const& e)
+            {
+                for (auto& error : errors)
+                {
+                    if (error.empty()) error = e.what();
+                }
+            }
+            _files.clear();
+            return errors;
+        }
+
+    private:
+#ifdef RESLIB_PENDINGFILE_SYNCFS
+        // one syncfs per file system (device) the directories are on
+        static void SyncFileSystems(std::vector<std::string> const& directories)
+        {
+            std::vector<dev_t> synced;
+            for (auto const& directory : directories)
+            {
+                const int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                struct stat info {};
+                if (dir < 0 || ::fstat(dir, &info) != 0)
+                {
+                    const auto error = errno;
+                    if (dir >= 0) ::close(dir);
+                    throw FileAccessException("Opening directory '" + directory + "' failed: " + std::generic_category().message(error));
+                }
+                if (std::find(synced.begin(), synced.end(), info.st_dev) == synced.end())
+                {
+                    if (::syncfs(dir) != 0)
+                    {
+                        const auto error = errno;
+                        ::close(dir);
+                        throw FileAccessException("Flushing the file system of '" + directory + "' failed: " + std::generic_category().message(error));
+                    }
+                    synced.push_back(info.st_dev);
+                }
+                ::close(dir);
+            }
+        }
+#endif
+
+        std::vector<PendingFile> _files;
+    };
+
+    // An exclusive lock on a file (created if missing), held until the object
+    // is destroyed; the constructor waits while another process holds it.
+    // Advisory: only keeps out processes that take the lock as well.
+    class FileLock
+    {
+    public:
+        explicit FileLock(std::string const& fileName)
+        {
+#ifdef _WIN32
+            _file = ::CreateFileW(Utf8::ToWide(fileName).c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            OVERLAPPED overlapped{};
+            if (_file == INVALID_HANDLE_VALUE || !::LockFileEx(_file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped))
+            {
+                const auto error = ::GetLastError();
+                if (_file != INVALID_HANDLE_VALUE) ::CloseHandle(_file);
+                throw FileAccessException("Locking file '" + fileName + "' failed: " + std::system_category().message(static_cast<int>(error)));
+            }
+#else
+            _file = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            int result = _file < 0 ? -1 : 0;
+            while (_file >= 0 && (result = ::flock(_file, LOCK_EX)) != 0 && errno == EINTR) {}
+            if (result != 0)
+            {
+                const auto error = errno;
+                if (_file >= 0) ::close(_file);
+                throw FileAccessException("Locking file '" + fileName + "' failed: " + std::generic_category().message(error));
+            }
+#endif
+        }
+
+        ~FileLock()
+        {
+#ifdef _WIN32
+            ::CloseHandle(_file);
+#else
+            ::close(_file);
+#endif
+        }
+
+        FileLock(const FileLock&) = delete;
+        FileLock& operator=(const FileLock&) = delete;
+
+    private:
+#ifdef _WIN32
+        HANDLE _file;
+#else
+        int _file;
+#endif
+    };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "PeImage.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // Compiled resource scripts (.res, as written by rc.exe and windres): a
+    // sequence of RESOURCEHEADER records, each followed by its data. Type and
+    // name are either 0xFFFF plus a 16 bit id or a zero terminated UTF-16
+    // string; header and data are padded to a multiple of 4 bytes. The file
+    // starts with an empty record (type and name 0, no data).
+    namespace ResFile
+    {
+        static constexpr uint16_t DefaultMemoryFlags = 0x1030;  // MOVEABLE | PURE | DISCARDABLE, rc's default
+
+        struct Record
+        {
+            ResId type;
+            ResId name;
+            uint16_t lang{ 0 };
+            uint16_t memoryFlags{ DefaultMemoryFlags };
+            uint32_t dataVersion{ 0 };
+            uint32_t version{ 0 };
+            uint32_t characteristics{ 0 };
+            Pe::Bytes data;             // points into the .res file
+        };
+
+        static constexpr size_t AlignUp(size_t value) noexcept
+        {
+            return (value + 3) & ~size_t{ 3 };
+        }
+
+        // Reads a type or name field at offset and moves offset behind it.
+        static ResId ReadId(Pe::Bytes header, size_t& offset)
+        {
+            const auto first = Pe::Read<uint16_t>(header, offset);
+            if (first == 0xFFFF)
+            {
+                const auto id = Pe::Read<uint16_t>(header, offset + 2);
+                offset += 4;
+                return ResId(id);
+            }
+
+            std::u16string name;
+            for (auto c = first; c != 0; c = Pe::Read<uint16_t>(header, offset))
+            {
+                name.push_back(static_cast<char16_t>(c));
+                offset += 2;
+            }
+            offset += 2;
+            return ResId(std::move(name));
+        }
+
+        // Calls f(Record const&) for every record with data, in file order;
+        // f returns false to stop. The records aren't copied, so a mapped
+        // .res file of any size is read in one sequential pass.
+        template<typename F>
+        static void ForEach(Pe::Bytes file, F&& f)
+        {
+            for (size_t offset = 0; offset < file.size();)
+            {
+                if (file.size() - offset < 8) throw InvalidFileException("Truncated resource header at offset " + std::to_string(offset));
+                const auto dataSize = Pe::Read<uint32_t>(file, offset);
+                const auto headerSize = Pe::Read<uint32_t>(file, offset + 4);
+                if (headerSize < 24 || headerSize > file.size() - offset || dataSize > file.size() - offset - headerSize)
+                {
+                    throw InvalidFileException("Resource record at offset " + std::to_string(offset) + " is out of range");
+                }
+
+                const auto header = file.subspan(offset, headerSize);
+                Record record;
+                size_t field = 8;
+                record.type = ReadId(header, field);
+                record.name = ReadId(header, field);
+                field = AlignUp(field);
+                record.dataVersion = Pe::Read<uint32_t>(header, field);
+                record.memoryFlags = Pe::Read<uint16_t>(header, field + 4);
+                record.lang = Pe::Read<uint16_t>(header, field + 6);
+                record.version = Pe::Read<uint32_t>(header, field + 8);
+                record.characteristics = Pe::Read<uint32_t>(header, field + 12);
+                record.data = file.subspan(offset + headerSize, dataSize);
+
+                offset = std::min(file.size(), AlignUp(offset + headerSize + dataSize));
+                if (dataSize && !f(record)) break;
+            }
+        }
+
+        static void AppendId(std::vector<unsigned char>& out, ResId const& id)
+        {
+            auto append16 = [&](uint16_t value)
+            {
+                out.push_back(static_cast<unsigned char>(value & 0xFF));
+                out.push_back(static_cast<unsigned char>(value >> 8));
+            };
+            if (id.IsId())
+            {
+                append16(0xFFFF);
+                append16(id.id);
+                return;
+            }
+            for (auto c : id.name) append16(static_cast<uint16_t>(c));
+            append16(0);
+        }
+
+        static void Append(std::vector<unsigned char>& out, Record const& record)
+        {
+            const auto start = out.size();
+            out.resize(start + 8);
+            AppendId(out, record.type);
+            AppendId(out, record.name);
+            out.resize(AlignUp(out.size()) + 16, 0);
+            const auto headerSize = out.size() - start;
+            Pe::Write<uint32_t>(out, start, static_cast<uint32_t>(record.data.size()));
+            Pe::Write<uint32_t>(out, start + 4, static_cast<uint32_t>(headerSize));
+            Pe::Write<uint32_t>(out, out.size() - 16, record.dataVersion);
+            Pe::Write<uint16_t>(out, out.size() - 12, record.memoryFlags);
+            Pe::Write<uint16_t>(out, out.size() - 10, record.lang);
+            Pe::Write<uint32_t>(out, out.size() - 8, record.version);
+            Pe::Write<uint32_t>(out, out.size() - 4, record.characteristics);
+            out.insert(out.end(), record.data.begin(), record.data.end());
+            out.resize(AlignUp(out.size()), 0);
+        }
+
+        // All resources of an image as .res file, in directory order. The
+        // memory flags aren't stored in images, every record gets rc's default.
+        static std::vector<unsigned char> Export(ResourceDirectory const& resources)
+        {
+            std::vector<unsigned char> out;
+            Append(out, Record{ ResId(0), ResId(0), 0, 0, 0, 0, 0, Pe::Bytes() });
+            resources.ForEach([&](ResourceEntry const& entry)
+            {
+                Record record;
+                record.type = entry.type.ToResId();
+                record.name = entry.name.ToResId();
+                record.lang = entry.lang;
+                record.data = resources.GetData(entry);
+                Append(out, record);
+                return true;
+            });
+            return out;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "ResTypes.h"
+#include "../Utf8.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace ResLib
+{
+    // Resource type or name as stored in the resource directory: either a
+    // 16 bit integer id or a (UTF-16) string.
+    struct ResId
+    {
+        ResId() = default;
+        ResId(uint16_t id) noexcept : id{ id } {}
+        explicit ResId(std::u16string name) : name{ std::move(name) } {}
+
+        bool IsId() const noexcept { return name.empty(); }
+
+        std::string ToString() const
+        {
+            return IsId() ? std::to_string(id) : Utf8::FromUtf16(name);
+        }
+
+        // type names are printed the same way the command line accepts them
+        std::string ToTypeString() const
+        {
+            return IsId() ? Types::GetTypeName(id) : Utf8::FromUtf16(name);
+        }
+
+        // "123" is taken as a numeric id, anything else as a string name
+        static ResId Parse(const char* str)
+        {
+            if (!str) throw ArgumentNullException();
+            const auto end = str + std::strlen(str);
+            unsigned int value = 0;
+            auto result = std::from_chars(str, end, value);
+            if (str != end && result.ec == std::errc() && result.ptr == end && value <= 0xFFFF)
+            {
+                return ResId(static_cast<uint16_t>(value));
+            }
+            return ResId(Utf8::ToUtf16(str));
+        }
+
+        // predefined type names ("icon", "version", ...) map to their RT_* ids
+        static ResId ParseType(const char* str)
+        {
+            if (!str) throw ArgumentNullException();
+            auto const& iter = Types::ResNameToIdMap.find(str);
+            if (iter != Types::ResNameToIdMap.end()) return ResId(iter->second);
+            return Parse(str);
+        }
+
+#ifdef _WIN32
+        LPCWSTR AsWin32() const noexcept
+        {
+            static_assert(sizeof(wchar_t) == sizeof(char16_t), "only UTF-16 wide strings supported!");
+            return IsId() ? MAKEINTRESOURCEW(id) : reinterpret_cast<LPCWSTR>(name.c_str());
+        }
+#endif
+
+        // resource directories list named entries first, then ids, both ascending
+        friend bool operator<(ResId const& lhs, ResId const& rhs) noexcept
+        {
+            if (lhs.IsId() != rhs.IsId()) return !lhs.IsId();
+            return lhs.IsId() ? lhs.id < rhs.id : lhs.name < rhs.name;
+        }
+
+        friend bool operator==(ResId const& lhs, ResId const& rhs) noexcept
+        {
+            return lhs.id == rhs.id && lhs.name == rhs.name;
+        }
+
+        uint16_t id{ 0 };
+        std::u16string name;
+    };
+}
@@ -1,12 +1,36 @@
 #pragma once
 
+#include "Exceptions.hpp"
+#include "Hash.hpp"
+#include "IconFile.hpp"
+#include "ImageIntegrity.hpp"
+#include "MappedFile.hpp"
+#include "MessageTable.hpp"
+#include "ModuleCache.hpp"
+#include "NameList.hpp"
+#include "PeImage.hpp"
+#include "PendingFile.hpp"
+#include "ResFile.hpp"
+#include "ResPatch.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+#include "ResourceLayout.hpp"
+#include "ResourceReader.hpp"
+#include "ResourceSelector.hpp"
+#include "ResourceWriter.hpp"
+#include "ResTypes.h"
+#include "VersionInfo.hpp"
+#include "../Utf8.hpp"
+
+#ifdef _WIN32
 #include "Handle.hpp"
 #include "DataLibHandle.h"
-#include "ResTypes.h"
-#include "..\Utf8.hpp"
 
 #include <Windows.h>
 #include <WinUser.h>
+#endif
+#include <filesystem>
+#include <optional>
 #include <system_error>
 #include <sstream>
 #include <memory>
@@ -14,50 +38,32 @@
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <exception>
+#include <utility>
 #include <gsl/util>
 
+// The functions below modify or load images through the Windows API. The
+// native parts (MappedFile, Pe::Image, ResourceDirectory, VersionInfo,
+// MessageTable, ...) are platform independent.
+//
+// Nothing in ResLib keeps global mutable state, so all of it may be used from
+// several threads at once as long as each file is updated by one of them only.
+#ifdef _WIN32
 namespace ResLib
 {
-    struct ResLibException : public std::exception
-    {
-        ResLibException(std::string const& msg) 
-            : std::exception()
-            , _msg {msg}
-        {}
-
-        const char* what() const noexcept override { return _msg.c_str(); }
-
-    private:
-        std::string _msg;
-    };
-
-    struct InvalidArgsException : public std::exception {};
-    struct ArgumentNullException : public std::exception {};
-    struct InvalidDataException : public std::exception {};
-
-    struct InvalidFileException : public ResLibException
-    {
-        InvalidFileException(std::string const& msg) : ResLibException(msg) {}
-    };
-
-    struct UpdateResourceException : public ResLibException
-    {
-        UpdateResourceException(std::string const& msg) : ResLibException(msg) {}
-    };
-
-    struct InvalidResourceException : public ResLibException
-    {
-        InvalidResourceException(std::string const& msg) : ResLibException(msg) {}
-    };
-
-    static void Write(std::vector<unsigned char> const& data, const char* fileName, const char* resType, const char* resId/*, int langId*/);
+    static void Write(std::vector<unsigned char> const& data, const char* fileName, const char* resType, const char* resId/*, int langId*/, CommitOptions const& options = {});
     static std::vector<unsigned char> Read(const char* fileName, const char* resType, const char* resId/*, int langId*/);
     static void Copy(const char* fromFile, const char* resType, const char* fromIdStr/*, int fromLangId*/, const char* toFile, const char* toIdStr/*, int toLangId*/);
+    static NameList ListNames(const char* fileName, const char* resType);
+    static NameList ListTypes(const char* fileName);
     static std::vector<std::string> Enum(const char* fileName, const char* resType);
     static std::vector<std::string> EnumerateTypes(const char* fileName);
     static std::vector<int> EnumerateLanguages(const char* fileName, const char* resType);
+    static VersionInfo::Result SetVersion(const char* fileName, VersionInfo::Update const& update, CommitOptions const& options = {});
+    static Icons::ImportResult WriteIcon(std::vector<unsigned char> const& icoData, const char* fileName, const char* groupIdStr, WORD langId, CommitOptions const& options = {});
 
     static std::string GetError()
     {
@@ -71,63 +77,113 @@ namespace ResLib
     {
         return gsl::narrow_cast<WORD>(s) << 10 | gsl::narrow_cast<WORD>(p);
     }
+
+    // Collects any number of resource updates for one file and writes them
+    // with a single EndUpdateResource. Uncommitted changes are discarded.
+    // A signed file is refused when the session is opened or, to strip the
+    // signature, updated as a copy without the certificate that replaces
+    // the file on Commit, so a failed update leaves it signed. The checksum
+    // is recomputed after a successful commit.
+    class UpdateSession
+    {
+    public:
+        explicit UpdateSession(const char* fileName, CommitOptions const& options = {})
+            : _fileName{ fileName ? fileName : "" }
+            , _options{ options }
+            , _handle{ Begin(fileName) }
+        {
+            if (Handle::IsNull(_handle))
+            {
+                auto err = GetError();
+                std::stringstream msg;
+                msg << "Opening file '" << fileName << "' failed: " << err << std::endl;
+                throw FileAccessException(msg.str().c_str());
+            }
+        }
+
+        ~UpdateSession()
+        {
+            if (!Handle::IsNull(_handle)) ::EndUpdateResourceW(_handle, TRUE);
+        }
+
+        UpdateSession() = delete;
+        UpdateSession(const UpdateSession&) = delete;
+        UpdateSession(UpdateSession&&) = delete;
+        UpdateSession& operator=(const UpdateSession&) = delete;
+        UpdateSession& operator=(UpdateSession&&) = delete;
+
+        void Set(ResId const& type, ResId const& name, WORD lang, const void* data, DWORD size)
+        {
+            if (::UpdateResourceW(_handle, type.AsWin32(), name.AsWin32(), lang, const_cast<void*>(data), size) == 0)
+            {
+                auto err = GetError();
+                std::stringstream msg;
+                msg << "Updating resource in file '" << _fileName << "' failed: " << err << std::endl;
+                throw UpdateResourceException(msg.str().c_str());
+            }
+        }
+
+        void Remove(ResId const& type, ResId const& name, WORD lang)
+        {
+            Set(type, name, lang, nullptr, 0);
+        }
+
+        void Commit()
+        {
+            auto handle = std::exchange(_handle, nullptr);
+            if (::EndUpdateResourceW(handle, FALSE) == 0)
+            {
+                auto err = GetError();
+                std::stringstream msg;
+                msg << "Resource update of file '" << _fileName << "' could not be written: " << err << std::endl;
+                throw UpdateResourceException(msg.str().c_str());
+            }
+            if (_options.updateChecksum) Checksum::Update(_stripped ? _stripped->TempName().c_str() : _fileName.c_str());
+            if (_stripped) _stripped->Commit();
+        }
+
+    private:
+        HANDLE Begin(const char* fileName)
+        {
+            if (!fileName) throw ArgumentNullException();
+            bool strip = false;
+            {
+                MappedFile file(fileName);
+                strip = CheckSignature(Pe::Image(file.Data()), fileName, _options.signature);
+            }
+            if (!strip) return ::BeginUpdateResourceW(Utf8::ToWide(fileName).c_str(), FALSE);
+
+            _stripped.emplace(fileName, false);
+            std::filesystem::copy_file(PendingFile::ToPath(fileName), PendingFile::ToPath(_stripped->TempName()), std::filesystem::copy_options::overwrite_existing);
+            StripCertificate(_stripped->TempName().c_str());
+            return ::BeginUpdateResourceW(Utf8::ToWide(_stripped->TempName()).c_str(), FALSE);
+        }
+
+        std::string _fileName;
+        CommitOptions _options;
+        std::optional<PendingFile> _stripped;   // the unsigned copy being updated
+        HANDLE _handle;
+    };
 };
 
 // ------------------------------------------
 // function definitions
 // ------------------------------------------
 
-void ResLib::Write(std::vector<unsigned char> const& data, const char* fileName, const char* resTypeStr, const char* resIdStr/*, int langId*/)
+void ResLib::Write(std::vector<unsigned char> const& data, const char* fileName, const char* resTypeStr, const char* resIdStr/*, int langId*/, CommitOptions const& options)
 {
     if (data.empty()) throw InvalidDataException();
     if (!fileName || !resTypeStr || !resIdStr) throw ArgumentNullException();
 
-    auto targetFileHandle = ::BeginUpdateResourceA(fileName, FALSE);
-    if (Handle::IsNull(targetFileHandle))
-    {
-        auto err = GetError();
-        std::stringstream msg;
-        msg << "Opening file '" << fileName << "' failed: " << err << std::endl;
-        throw InvalidFileException(msg.str().c_str());
-    }
-
-    // align data to a multiple of 8
-    auto _data{ data };
-    while (_data.size() % 8)
-    {
-        _data.emplace_back(static_cast<unsigned char>(0x00));
-    }
-
-    std::wstring customType;
-    auto resType = Types::GetValue(resTypeStr, customType);
-    if (resType == Types::UNDEFINED_TYPE)
-    {
-        resType = customType.c_str();
-    }
-
-    std::wstring customId;
-    LPCWSTR resId = Types::ParseResIdString(resIdStr, customId);
-
-    if (::UpdateResourceW(
-        targetFileHandle,
-        resType,
-        resId,
+    // UpdateResource copies the data (and pads it), no need for a copy here
+    UpdateSession session(fileName, options);
+    session.Set(
+        ResId::ParseType(resTypeStr),
+        ResId::Parse(resIdStr),
         ResLib::MakeLangId(LANG_NEUTRAL, SUBLANG_NEUTRAL),
-        _data.data(),
-        static_cast<DWORD>(data.size())) == 0)
-    {
-        auto err = GetError();
-        std::stringstream msg;
-        msg << "Updating resource failed: " << err << std::endl;
-        throw UpdateResourceException(msg.str().c_str());
-    }
-    if (::EndUpdateResourceW(targetFileHandle, false) == 0)
-    {
-        auto err = GetError();
-        std::stringstream msg;
-        msg << "Resource update could not be written: " << err << std::endl;
-        throw UpdateResourceException(msg.str().c_str());
-    }
+        data.data(),
+        static_cast<DWORD>(data.size()));
+    session.Commit();
 }
 
 std::vector<unsigned char> ResLib::Read(const char* fileName, const char* resTypeStr, const char* resIdStr/*, int langId*/)
@@ -198,7 +254,7 @@ void ResLib::Copy(const char* fromFile, const char* resType, const char* fromIdS
     Write(data, toFile, resType, toIdStr);
 }
 
-std::vector<std::string> ResLib::Enum(const char* fileName, const char* resType)
+ResLib::NameList ResLib::ListNames(const char* fileName, const char* resType)
 {
     if (!fileName || !resType) throw ArgumentNullException();
 
@@ -217,30 +273,35 @@ std::vector<std::string> ResLib::Enum(const char* fileName, const char* resType)
         resTypeId = customType.c_str();
     }
 
-    std::vector<std::string> data;
-    
+    NameList names;
+
     [[gsl::suppress(bounds.1)]]
     ::EnumResourceNamesW(dll, resTypeId, 
         [](HMODULE /*hModule*/, LPCWSTR /*lpszType*/, LPWSTR lpszName, LONG_PTR lParam) -> BOOL
     {
         [[gsl::suppress(type.1)]]
-        auto data = reinterpret_cast<std::vector<std::string>*>(lParam);
+        auto names = reinterpret_cast<NameList*>(lParam);
         if (IS_INTRESOURCE(lpszName))
         {
-            data->emplace_back(std::to_string(reinterpret_cast<int>(lpszName)));
+            names->Add(static_cast<uint16_t>(reinterpret_cast<ULONG_PTR>(lpszName)));
         }
         else
         {
-            data->emplace_back(Utf8::FromWide(lpszName));
+            names->Add(std::u16string_view(reinterpret_cast<const char16_t*>(lpszName)));
         }
         return true;
     }, 
-        reinterpret_cast<LONG_PTR>(&data));
+        reinterpret_cast<LONG_PTR>(&names));
 
-    return data;
+    return names;
 }
 
-std::vector<std::string> ResLib::EnumerateTypes(const char* fileName)
+std::vector<std::string> ResLib::Enum(const char* fileName, const char* resType)
+{
+    return ListNames(fileName, resType).ToStrings();
+}
+
+ResLib::NameList ResLib::ListTypes(const char* fileName)
 {
     if (!fileName) throw ArgumentNullException();
 
@@ -252,14 +313,21 @@ std::vector<std::string> ResLib::EnumerateTypes(const char* fileName)
         throw InvalidFileException(msg.str().c_str());
     }
 
-    std::vector<std::string> types;
+    NameList types;
 
     [[gsl::suppress(bounds.1)]]
     ::EnumResourceTypesExW(dll, 
         [](HMODULE /*hModule*/, LPWSTR lpszType, LONG_PTR lParam) -> BOOL
         {
-            auto types = reinterpret_cast<std::vector<std::string>*>(lParam);
-            types->emplace_back(Types::GetName(lpszType));
+            auto types = reinterpret_cast<NameList*>(lParam);
+            if (IS_INTRESOURCE(lpszType))
+            {
+                types->Add(static_cast<uint16_t>(reinterpret_cast<ULONG_PTR>(lpszType)));
+            }
+            else
+            {
+                types->Add(std::u16string_view(reinterpret_cast<const char16_t*>(lpszType)));
+            }
             return true;
         },
             reinterpret_cast<LONG_PTR>(&types),
@@ -268,3 +336,203 @@ std::vector<std::string> ResLib::EnumerateTypes(const char* fileName)
 
     return types;
 }
+
+std::vector<std::string> ResLib::EnumerateTypes(const char* fileName)
+{
+    return ListTypes(fileName).ToTypeStrings();
+}
+
+ResLib::VersionInfo::Result ResLib::SetVersion(const char* fileName, VersionInfo::Update const& update, CommitOptions const& options)
+{
+    if (!fileName) throw ArgumentNullException();
+    if (update.Empty()) throw InvalidArgsException();
+
+    struct Rewrite
+    {
+        ResId name;
+        WORD lang;
+        std::vector<unsigned char> data;
+    };
+    std::vector<Rewrite> rewrites;
+
+    {
+        // patch everything that fits directly in the mapped file
+        MappedFile file(fileName, MappedFile::Access::ReadWrite);
+        Pe::Image image(file.Data());
+        ResourceDirectory resources(image);
+
+        // a signed file isn't touched here; all of it goes through UpdateSession, which strips on commit
+        const bool strip = CheckSignature(image, fileName, options.signature);
+
+        // old content of the patched blocks, for the incremental checksum update
+        std::vector<std::pair<size_t, std::vector<unsigned char>>> patched;
+
+        bool found = false;
+        resources.ForEachOfType(ResId::ParseType(Types::Strings::Version), [&](ResourceEntry const& entry)
+        {
+            found = true;
+            auto data = file.MutableData().subspan(entry.dataOffset, entry.size);
+            std::vector<unsigned char> before;
+            if (options.updateChecksum) before.assign(data.begin(), data.end());
+            auto root = VersionInfo::Parse(data);
+            if (!strip && VersionInfo::TryPatchInPlace(data, root, update))
+            {
+                if (options.updateChecksum) patched.emplace_back(entry.dataOffset, std::move(before));
+            }
+            else
+            {
+                VersionInfo::Apply(root, update);
+                rewrites.push_back({ entry.name.ToResId(), entry.lang, VersionInfo::Serialize(root) });
+            }
+            return true;
+        });
+
+        if (!found)
+        {
+            std::stringstream msg;
+            msg << "File '" << fileName << "' does not contain a version resource" << std::endl;
+            throw InvalidResourceException(msg.str().c_str());
+        }
+
+        // a rewrite recomputes the checksum of the whole file anyway
+        if (options.updateChecksum && rewrites.empty())
+        {
+            std::vector<Checksum::Change> changes;
+            for (auto const& [offset, before] : patched)
+            {
+                changes.push_back({ offset, before, file.Data().subspan(offset, before.size()) });
+            }
+            const auto checksum = Checksum::Update(image.CheckSum(), file.Size(), file.Size(), image.CheckSumOffset(), changes);
+            Pe::Write<uint32_t>(file.MutableData(), image.CheckSumOffset(), checksum ? *checksum : Checksum::Compute(image));
+        }
+        file.Flush();
+    }
+
+    if (rewrites.empty()) return VersionInfo::Result::PatchedInPlace;
+
+    // only the version resources that outgrew their blocks are serialized again
+    UpdateSession session(fileName, options);
+    for (auto const& rewrite : rewrites)
+    {
+        session.Set(ResId::ParseType(Types::Strings::Version), rewrite.name, rewrite.lang, rewrite.data.data(), static_cast<DWORD>(rewrite.data.size()));
+    }
+    session.Commit();
+    return VersionInfo::Result::Rewritten;
+}
+
+ResLib::Icons::ImportResult ResLib::WriteIcon(std::vector<unsigned char> const& icoData, const char* fileName, const char* groupIdStr, WORD langId, CommitOptions const& options)
+{
+    if (!fileName || !groupIdStr) throw ArgumentNullException();
+
+    const auto images = Icons::ParseIcoFile(icoData);
+    if (images.empty()) throw InvalidDataException();
+
+    const auto iconType = ResId::ParseType(Types::Strings::Icon);
+    const auto groupType = ResId::ParseType(Types::Strings::Groupicon);
+    const auto groupId = ResId::Parse(groupIdStr);
+
+    Icons::ImportResult result;
+    std::vector<Icons::GroupEntry> group(images.size());
+    std::vector<size_t> newImages;                      // indices into images that need a new RT_ICON
+    std::vector<std::pair<uint16_t, WORD>> orphans;     // RT_ICON id/lang only used by the replaced group
+
+    {
+        MappedFile file(fileName);
+        Pe::Image image(file.Data());
+        ResourceDirectory resources(image);
+
+        // only existing images with a matching size can be duplicates, hash just those
+        std::set<size_t> sizes;
+        for (auto const& img : images) sizes.insert(img.data.size());
+
+        std::unordered_multimap<uint64_t, ResourceEntry> existing;
+        std::map<uint16_t, std::vector<WORD>> iconLangs;
+        uint16_t maxId = 0;
+        resources.ForEachOfType(iconType, [&](ResourceEntry const& entry)
+        {
+            if (!entry.name.IsId()) return true;
+            maxId = std::max(maxId, entry.name.id);
+            iconLangs[entry.name.id].push_back(entry.lang);
+            if (sizes.count(entry.size)) existing.emplace(Hash::Fnv1a64(resources.GetData(entry)), entry);
+            return true;
+        });
+
+        std::set<uint16_t> referenced;
+        std::vector<uint16_t> replaced;
+        resources.ForEachOfType(groupType, [&](ResourceEntry const& entry)
+        {
+            const bool isReplaced = entry.name.Matches(groupId) && entry.lang == langId;
+            for (auto const& groupEntry : Icons::ParseGroup(resources.GetData(entry)))
+            {
+                if (isReplaced) replaced.push_back(groupEntry.id);
+                else referenced.insert(groupEntry.id);
+            }
+            return true;
+        });
+
+        std::unordered_multimap<uint64_t, size_t> added;
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            auto const& img = images[i];
+            auto& entry = group[i];
+            entry.width = img.width;
+            entry.height = img.height;
+            entry.colorCount = img.colorCount;
+            entry.planes = img.planes;
+            entry.bitCount = img.bitCount;
+            entry.bytesInRes = static_cast<uint32_t>(img.data.size());
+
+            const auto hash = Hash::Fnv1a64(img.data);
+            auto isSame = [&](Pe::Bytes other) { return std::equal(img.data.begin(), img.data.end(), other.begin(), other.end()); };
+
+            auto range = existing.equal_range(hash);
+            auto match = std::find_if(range.first, range.second, [&](auto const& candidate) { return isSame(resources.GetData(candidate.second)); });
+            if (match != range.second)
+            {
+                entry.id = match->second.name.id;
+                referenced.insert(entry.id);
+                ++result.reused;
+                continue;
+            }
+
+            auto addedRange = added.equal_range(hash);
+            auto addedMatch = std::find_if(addedRange.first, addedRange.second, [&](auto const& candidate) { return isSame(images[candidate.second].data); });
+            if (addedMatch != addedRange.second)
+            {
+                entry.id = group[addedMatch->second].id;
+                continue;
+            }
+
+            if (maxId == 0xFFFF) throw UpdateResourceException("No free RT_ICON id left");
+            entry.id = ++maxId;
+            added.emplace(hash, i);
+            newImages.push_back(i);
+        }
+
+        for (auto id : replaced)
+        {
+            if (referenced.count(id)) continue;
+            for (auto lang : iconLangs[id]) orphans.emplace_back(id, lang);
+            referenced.insert(id);
+        }
+    }
+
+    UpdateSession session(fileName, options);
+    for (auto i : newImages)
+    {
+        session.Set(iconType, group[i].id, langId, images[i].data.data(), static_cast<DWORD>(images[i].data.size()));
+    }
+    for (auto const& orphan : orphans)
+    {
+        session.Remove(iconType, orphan.first, orphan.second);
+    }
+    const auto groupData = Icons::BuildGroup(group);
+    session.Set(groupType, groupId, langId, groupData.data(), static_cast<DWORD>(groupData.size()));
+    session.Commit();
+
+    result.added = newImages.size();
+    result.removed = orphans.size();
+    return result;
+}
+
+#endif
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "Hash.hpp"
+#include "Lz.hpp"
+#include "MappedFile.hpp"
+#include "PeImage.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+#include "ResourceWriter.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // Resource patch bundles: the resource level difference between two
+    // builds of a binary, applied to other copies of the old build without
+    // the new one. A bundle is written front to back in one pass and read
+    // in place from a mapped file; all numbers are little endian.
+    //
+    //   header, 32 bytes:
+    //     char[8] "RESPATCH" | u32 version | u32 op count | u32 strings size
+    //     u32 reserved (0) | u64 FNV-1a of op table and strings
+    //   op table, 56 bytes per op:
+    //     u8 kind | u8 expect | u8 compression | u8 reserved | u16 lang | u16 reserved
+    //     u32 type | u32 name         id, or NameFlag | offset into the strings
+    //     u64 expected hash | u32 expected size     the resource the op replaces
+    //     u32 size | u64 hash         of the new data (0 for Remove)
+    //     u64 payload offset | u32 payload size     in the file, stored or compressed
+    //     u32 reserved
+    //   strings: u16 length plus UTF-16 code units each
+    //   payloads, in op order
+    //
+    // The preconditions compare size and FNV-1a hash of the resource in the
+    // target. That reliably tells builds apart, but it is not a signature:
+    // a bundle from an untrusted source has to be authenticated separately.
+    namespace ResPatch
+    {
+        static constexpr char Magic[8] = { 'R', 'E', 'S', 'P', 'A', 'T', 'C', 'H' };
+        static constexpr uint32_t Version = 1;
+        static constexpr size_t HeaderSize = 32;
+        static constexpr size_t OpSize = 56;
+        static constexpr uint32_t NameFlag = 0x80000000;   // as in the resource directory
+
+        enum class OpKind : uint8_t { Set = 1, Remove = 2 };
+        enum class Expect : uint8_t { Anything = 0, Absent = 1, Hash = 2 };
+        enum class Compression : uint8_t { None = 0, Lz = 1 };
+
+        struct Op
+        {
+            OpKind kind{ OpKind::Set };
+            ResId type;
+            ResId name;
+            uint16_t lang{ 0 };
+            Expect expect{ Expect::Anything };
+            uint64_t expectedHash{ 0 };
+            uint32_t expectedSize{ 0 };
+            uint32_t size{ 0 };
+            uint64_t hash{ 0 };
+            Compression compression{ Compression::None };
+            Pe::Bytes payload;          // the new data (MakePatch) or the payload in the bundle
+        };
+
+        static std::string PathOf(Op const& op)
+        {
+            return op.type.ToTypeString() + "/" + op.name.ToString() + "/" + std::to_string(op.lang);
+        }
+
+        // The ops turning `from` into `to`: Set for resources that are new or
+        // changed, Remove for the ones that are gone. Each op expects the
+        // resource as it is in `from`. Payloads point into `to`.
+        static std::vector<Op> MakePatch(ResourceDirectory const& from, ResourceDirectory const& to)
+        {
+            std::vector<Op> ops;
+            to.ForEach([&](ResourceEntry const& entry)
+            {
+                const auto data = to.GetData(entry);
+                Op op{ OpKind::Set, entry.type.ToResId(), entry.name.ToResId(), entry.lang, Expect::Absent, 0, 0,
+                    static_cast<uint32_t>(data.size()), Hash::Fnv1a64(data), Compression::None, data };
+                const auto old = from.Find(op.type, op.name, op.lang);
+                if (old)
+                {
+                    const auto oldData = from.GetData(*old);
+                    if (std::equal(oldData.begin(), oldData.end(), data.begin(), data.end())) return true;
+                    op.expect = Expect::Hash;
+                    op.expectedHash = Hash::Fnv1a64(oldData);
+                    op.expectedSize = old->size;
+                }
+                ops.push_back(std::move(op));
+                return true;
+            });
+            from.ForEach([&](ResourceEntry const& entry)
+            {
+                auto type = entry.type.ToResId();
+                auto name = entry.name.ToResId();
+                if (to.Find(type, name, entry.lang)) return true;
+                ops.push_back(Op{ OpKind::Remove, std::move(type), std::move(name), entry.lang, Expect::Hash,
+                    Hash::Fnv1a64(from.GetData(entry)), entry.size, 0, 0, Compression::None, Pe::Bytes() });
+                return true;
+            });
+            return ops;
+        }
+
+        // Writes the bundle for ops sequentially (so out may be a pipe).
+        // Payloads that LZ compresses to less are stored compressed. Returns
+        // the size of the bundle.
+        static uint64_t Write(std::ostream& out, std::vector<Op> const& ops)
+        {
+            std::vector<unsigned char> strings;
+            std::map<std::u16string, uint32_t> written;     // each name once
+            auto key = [&](ResId const& id)
+            {
+                if (id.IsId()) return uint32_t{ id.id };
+                if (id.name.size() > 0xFFFF) throw InvalidArgsException();
+                const auto known = written.find(id.name);
+                if (known != written.end()) return NameFlag | known->second;
+                const auto offset = static_cast<uint32_t>(strings.size());
+                written.emplace(id.name, offset);
+                strings.resize(strings.size() + 2 + 2 * id.name.size());
+                Pe::Write<uint16_t>(strings, offset, static_cast<uint16_t>(id.name.size()));
+                for (size_t i = 0; i < id.name.size(); ++i) Pe::Write<uint16_t>(strings, offset + 2 + 2 * i, static_cast<uint16_t>(id.name[i]));
+                return NameFlag | offset;
+            };
+
+            std::vector<std::vector<unsigned char>> compressed(ops.size());
+            std::vector<unsigned char> table(ops.size() * OpSize);
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                auto const& op = ops[i];
+                const auto pos = i * OpSize;
+                auto compression = Compression::None;
+                if (op.kind == OpKind::Set)
+                {
+                    if (op.payload.empty()) throw InvalidDataException();
+                    compressed[i] = Lz::Compress(op.payload);
+                    if (compressed[i].size() < op.payload.size()) compression = Compression::Lz;
+                    else compressed[i].clear();
+                }
+                table[pos] = static_cast<unsigned char>(op.kind);
+                table[pos + 1] = static_cast<unsigned char>(op.expect);
+                table[pos + 2] = static_cast<unsigned char>(compression);
+                Pe::Write<uint16_t>(table, pos + 4, op.lang);
+                Pe::Write<uint32_t>(table, pos + 8, key(op.type));
+                Pe::Write<uint32_t>(table, pos + 12, key(op.name));
+                Pe::Write<uint64_t>(table, pos + 16, op.expectedHash);
+                Pe::Write<uint32_t>(table, pos + 24, op.expectedSize);
+                if (op.kind != OpKind::Set) continue;
+                Pe::Write<uint32_t>(table, pos + 28, static_cast<uint32_t>(op.payload.size()));
+                Pe::Write<uint64_t>(table, pos + 32, Hash::Fnv1a64(op.payload));
+                Pe::Write<uint32_t>(table, pos + 48, static_cast<uint32_t>(compression == Compression::Lz ? compressed[i].size() : op.payload.size()));
+            }
+
+            uint64_t offset = HeaderSize + table.size() + strings.size();
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                if (ops[i].kind != OpKind::Set) continue;
+                Pe::Write<uint64_t>(table, i * OpSize + 40, offset);
+                offset += Pe::Read<uint32_t>(table, i * OpSize + 48);
+            }
+
+            std::vector<unsigned char> header(HeaderSize);
+            std::memcpy(header.data(), Magic, sizeof(Magic));
+            Pe::Write<uint32_t>(header, 8, Version);
+            Pe::Write<uint32_t>(header, 12, static_cast<uint32_t>(ops.size()));
+            Pe::Write<uint32_t>(header, 16, static_cast<uint32_t>(strings.size()));
+            Pe::Write<uint64_t>(header, 24, Hash::Fnv1a64(strings, Hash::Fnv1a64(table)));
+
+            auto write = [&](Pe::Bytes data) { out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())); };
+            write(header);
+            write(table);
+            write(strings);
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                if (ops[i].kind == OpKind::Set) write(compressed[i].empty() ? ops[i].payload : Pe::Bytes(compressed[i]));
+            }
+            if (!out) throw UpdateResourceException("Writing the patch bundle failed");
+            return offset;
+        }
+
+        // A bundle read in place, typically from a MappedFile. The header,
+        // op table and strings are checked when it is opened; payloads are
+        // checked against their hash when they are decoded.
+        class Bundle
+        {
+        public:
+            explicit Bundle(Pe::Bytes file) : _file{ file }
+            {
+                if (file.size() < HeaderSize || std::memcmp(file.data(), Magic, sizeof(Magic)) != 0) throw InvalidFileException("Not a resource patch bundle");
+                if (Pe::Read<uint32_t>(file, 8) != Version) throw InvalidFileException("Unsupported patch bundle version " + std::to_string(Pe::Read<uint32_t>(file, 8)));
+
+                const uint64_t opCount = Pe::Read<uint32_t>(file, 12);
+                const uint64_t stringsSize = Pe::Read<uint32_t>(file, 16);
+                if (opCount * OpSize + stringsSize > file.size() - HeaderSize) throw InvalidFileException("Patch bundle is truncated");
+                const auto table = file.subspan(HeaderSize, static_cast<size_t>(opCount * OpSize));
+                const auto strings = file.subspan(HeaderSize + table.size(), static_cast<size_t>(stringsSize));
+                if (Hash::Fnv1a64(strings, Hash::Fnv1a64(table)) != Pe::Read<uint64_t>(file, 24)) throw InvalidFileException("Patch bundle op table is corrupt");
+
+                _ops.reserve(static_cast<size_t>(opCount));
+                for (size_t pos = 0; pos < table.size(); pos += OpSize)
+                {
+                    Op op;
+                    op.kind = static_cast<OpKind>(table[pos]);
+                    op.expect = static_cast<Expect>(table[pos + 1]);
+                    op.compression = static_cast<Compression>(table[pos + 2]);
+                    op.lang = Pe::Read<uint16_t>(table, pos + 4);
+                    op.type = ReadKey(strings, Pe::Read<uint32_t>(table, pos + 8));
+                    op.name = ReadKey(strings, Pe::Read<uint32_t>(table, pos + 12));
+                    op.expectedHash = Pe::Read<uint64_t>(table, pos + 16);
+                    op.expectedSize = Pe::Read<uint32_t>(table, pos + 24);
+                    op.size = Pe::Read<uint32_t>(table, pos + 28);
+                    op.hash = Pe::Read<uint64_t>(table, pos + 32);
+                    const auto offset = Pe::Read<uint64_t>(table, pos + 40);
+                    const auto stored = Pe::Read<uint32_t>(table, pos + 48);
+
+                    const auto where = "Patch bundle op " + std::to_string(pos / OpSize) + " ";
+                    if (op.kind != OpKind::Set && op.kind != OpKind::Remove) throw InvalidFileException(where + "has an unknown kind");
+                    if (op.expect > Expect::Hash) throw InvalidFileException(where + "has an unknown precondition");
+                    if (op.kind == OpKind::Set)
+                    {
+                        const bool compressed = op.compression == Compression::Lz;
+                        if (!compressed && op.compression != Compression::None) throw InvalidFileException(where + "has an unknown compression");
+                        if (op.size == 0 || stored == 0 || (!compressed && stored != op.size)) throw InvalidFileException(where + "has an invalid payload size");
+                        if (offset < HeaderSize + table.size() + strings.size() || offset > file.size() || stored > file.size() - offset)
+                        {
+                            throw InvalidFileException(where + "payload is out of range");
+                        }
+                        op.payload = file.subspan(static_cast<size_t>(offset), stored);
+                    }
+                    _ops.push_back(std::move(op));
+                }
+            }
+
+            std::vector<Op> const& Ops() const noexcept { return _ops; }
+
+            // the new data of a Set op, decompressed and checked
+            std::vector<unsigned char> Data(Op const& op) const
+            {
+                std::vector<unsigned char> data(op.size);
+                if (op.compression == Compression::Lz) Lz::Decompress(op.payload, data);
+                else if (op.payload.size() == data.size()) std::copy(op.payload.begin(), op.payload.end(), data.begin());
+                else throw InvalidDataException();
+                if (Hash::Fnv1a64(data) != op.hash) throw InvalidFileException("Patch bundle payload of " + PathOf(op) + " is corrupt");
+                return data;
+            }
+
+        private:
+            static ResId ReadKey(Pe::Bytes strings, uint32_t key)
+            {
+                if (!(key & NameFlag))
+                {
+                    if (key > 0xFFFF) throw InvalidFileException("Patch bundle key out of range");
+                    return ResId(static_cast<uint16_t>(key));
+                }
+                const size_t offset = key & ~NameFlag;
+                if (offset > strings.size() || strings.size() - offset < 2) throw InvalidFileException("Patch bundle name out of range");
+                const size_t length = Pe::Read<uint16_t>(strings, offset);
+                if (length == 0 || length > (strings.size() - offset - 2) / 2) throw InvalidFileException("Patch bundle name out of range");
+                std::u16string name(length, u'\0');
+                for (size_t i = 0; i < length; ++i) name[i] = static_cast<char16_t>(Pe::Read<uint16_t>(strings, offset + 2 + 2 * i));
+                return ResId(std::move(name));
+            }
+
+            Pe::Bytes _file;
+            std::vector<Op> _ops;
+        };
+
+        enum class TargetState
+        {
+            Old,        // every precondition holds
+            Patched,    // the target already has the new resources, nothing to do
+            Mismatch,
+        };
+
+        // Compares the resources in the target with what the ops expect.
+        // Only the resources the ops touch are read, in place. For Mismatch,
+        // the first op that doesn't fit is described in `message`.
+        static TargetState Check(ResourceDirectory const& target, std::vector<Op> const& ops, std::string* message = nullptr)
+        {
+            bool old = true;
+            bool patched = true;
+            for (auto const& op : ops)
+            {
+                const auto entry = target.Find(op.type, op.name, op.lang);
+                std::string mismatch;
+                if (op.expect == Expect::Absent && entry) mismatch = "exists";
+                else if (op.expect == Expect::Hash && !entry) mismatch = "is missing";
+                else if (op.expect == Expect::Hash && (entry->size != op.expectedSize || Hash::Fnv1a64(target.GetData(*entry)) != op.expectedHash)) mismatch = "has different content";
+
+                const bool done = op.kind == OpKind::Remove
+                    ? !entry
+                    : entry && entry->size == op.size && Hash::Fnv1a64(target.GetData(*entry)) == op.hash;
+                if (!mismatch.empty() && message && old) *message = PathOf(op) + " " + mismatch;
+                old = old && mismatch.empty();
+                patched = patched && done;
+                if (!old && !patched) return TargetState::Mismatch;
+            }
+            return patched ? TargetState::Patched : TargetState::Old;
+        }
+
+        // Applies the ops to an update session; data[i] is the decoded new
+        // data of ops[i] (empty for Remove).
+        static void Apply(NativeUpdateSession& session, std::vector<Op> const& ops, std::vector<std::vector<unsigned char>> const& data)
+        {
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                auto const& op = ops[i];
+                if (op.kind == OpKind::Remove) session.Remove(op.type, op.name, op.lang);
+                else session.Set(op.type, op.name, op.lang, data[i].data(), static_cast<uint32_t>(data[i].size()));
+            }
+        }
+
+        // Decodes all payloads of a bundle once, to apply them to many targets.
+        static std::vector<std::vector<unsigned char>> DecodeAll(Bundle const& bundle)
+        {
+            std::vector<std::vector<unsigned char>> data;
+            data.reserve(bundle.Ops().size());
+            for (auto const& op : bundle.Ops()) data.push_back(op.kind == OpKind::Set ? bundle.Data(op) : std::vector<unsigned char>());
+            return data;
+        }
+
+        // Applies a bundle to one file with a single commit. A file that is
+        // already patched is left alone; one that isn't the expected old
+        // build throws UpdateResourceException and is left alone as well.
+        static TargetState ApplyPatch(const char* fileName, Bundle const& bundle, CommitOptions const& options = {})
+        {
+            if (!fileName) throw ArgumentNullException();
+            {
+                MappedFile file(fileName);
+                const Pe::Image image(file.Data());
+                std::string message;
+                const auto state = Check(ResourceDirectory(image), bundle.Ops(), &message);
+                if (state == TargetState::Patched) return state;
+                if (state == TargetState::Mismatch) throw UpdateResourceException(std::string(fileName) + ": " + message);
+            }
+            NativeUpdateSession session(fileName, options);
+            Apply(session, bundle.Ops(), DecodeAll(bundle));
+            session.Commit();
+            return TargetState::Old;
+        }
+    }
+}
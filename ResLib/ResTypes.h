@@ -2,18 +2,19 @@
 
 #include "../Utf8.hpp"
 
+#ifdef _WIN32
 #include <windows.h>
 #include <WinUser.h>
+#endif
 #include <string>
 #include <map>
+#include <cstdint>
 
 namespace ResLib
 {
 	namespace Types
 	{
 
-		static constexpr LPCWSTR UNDEFINED_TYPE = MAKEINTRESOURCE(0);
-
 		namespace Strings
 		{
 			static const char* const Accelerator = "accelerator"; // Accelerator table.
@@ -39,6 +40,43 @@ namespace ResLib
 			static const char* const Vxd = "vxd"; // VXD.
 		}
 
+		// numeric type ids as stored in the resource directory of a PE image
+		static const std::map<std::string, uint16_t> ResNameToIdMap = {
+			{ Strings::Accelerator, 9 },
+			{ Strings::Anicursor, 21 },
+			{ Strings::Aniicon, 22 },
+			{ Strings::Bitmap, 2 },
+			{ Strings::Cursor, 1 },
+			{ Strings::Dialog, 5 },
+			{ Strings::Dlginclude, 17 },
+			{ Strings::Font, 8 },
+			{ Strings::Fontdir, 7 },
+			{ Strings::Groupcursor, 12 },
+			{ Strings::Groupicon, 14 },
+			{ Strings::Html, 23 },
+			{ Strings::Icon, 3 },
+			{ Strings::Manifest, 24 },
+			{ Strings::Menu, 4 },
+			{ Strings::Messagetable, 11 },
+			{ Strings::Plugplay, 19 },
+			{ Strings::Rcdata, 10 },
+			{ Strings::String, 6 },
+			{ Strings::Version, 16 },
+			{ Strings::Vxd, 20 }
+		};
+
+		static std::string GetTypeName(uint16_t id)
+		{
+			for (auto const& entry : ResNameToIdMap)
+			{
+				if (entry.second == id) return entry.first;
+			}
+			return std::to_string(id);
+		}
+
+#ifdef _WIN32
+		static constexpr LPCWSTR UNDEFINED_TYPE = MAKEINTRESOURCE(0);
+
 		static const std::map<std::string, LPCWSTR> ResNameToValueMap = {
 			{ Strings::Accelerator, RT_ACCELERATOR }, // Accelerator table.
 			{ Strings::Anicursor, RT_ANICURSOR }, // Animated cursor.
@@ -125,5 +163,6 @@ namespace ResLib
 			customId = Utf8::ToWide(name);
 			return UNDEFINED_TYPE;
 		}
+#endif
 	}
 }
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "PeImage.hpp"
+#include "ResId.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+
+namespace ResLib
+{
+    // Type, name or language key of a resource directory entry. Names are not
+    // copied out of the image; they point at the UTF-16LE characters in place.
+    struct ResNameRef
+    {
+        uint16_t id{ 0 };
+        bool isName{ false };
+        Pe::Bytes name;     // UTF-16LE characters (no length prefix, no terminator)
+
+        bool IsId() const noexcept { return !isName; }
+        size_t Length() const noexcept { return name.size() / 2; }
+        char16_t CharAt(size_t index) const noexcept
+        {
+            return static_cast<char16_t>(name[2 * index] | (name[2 * index + 1] << 8));
+        }
+
+        std::u16string ToU16String() const
+        {
+            std::u16string result(Length(), u'\0');
+            for (size_t i = 0; i < result.size(); ++i) result[i] = CharAt(i);
+            return result;
+        }
+
+        ResId ToResId() const { return IsId() ? ResId(id) : ResId(ToU16String()); }
+        std::string ToString() const { return IsId() ? std::to_string(id) : Utf8::FromUtf16(ToU16String()); }
+        std::string ToTypeString() const { return IsId() ? Types::GetTypeName(id) : ToString(); }
+
+        // string names are compared case insensitive (for ASCII), like FindResource does
+        bool Matches(ResId const& other) const noexcept
+        {
+            if (IsId() != other.IsId()) return false;
+            if (IsId()) return id == other.id;
+            if (Length() != other.name.size()) return false;
+            for (size_t i = 0; i < Length(); ++i)
+            {
+                if (ToUpper(CharAt(i)) != ToUpper(other.name[i])) return false;
+            }
+            return true;
+        }
+
+        static char16_t ToUpper(char16_t c) noexcept
+        {
+            return c >= u'a' && c <= u'z' ? static_cast<char16_t>(c - u'a' + u'A') : c;
+        }
+    };
+
+    struct ResourceEntry
+    {
+        ResNameRef type;
+        ResNameRef name;
+        uint16_t lang{ 0 };
+        uint32_t dataRva{ 0 };
+        uint32_t size{ 0 };
+        uint32_t codePage{ 0 };
+        size_t dataEntryOffset{ 0 };    // file offset of the IMAGE_RESOURCE_DATA_ENTRY
+        size_t dataOffset{ 0 };         // file offset of the resource data
+    };
+
+    // Walks the three level (type/name/language) resource directory of a PE image
+    // directly in memory, without going through the Windows loader.
+    class ResourceDirectory
+    {
+    public:
+        static constexpr uint32_t SubdirectoryFlag = 0x80000000;
+        static constexpr size_t DirectoryHeaderSize = 16;
+        static constexpr size_t DirectoryEntrySize = 8;
+        static constexpr size_t DataEntrySize = 16;
+
+        // Selects the resources Entries() yields; unset keys match everything.
+        struct Filter
+        {
+            std::optional<ResId> type;
+            std::optional<ResId> name;
+            std::optional<uint16_t> lang;
+        };
+
+        // The keys of one directory level a selection can match: named
+        // entries or not, and a range of ids.
+        struct KeyBounds
+        {
+            bool names{ true };
+            uint16_t firstId{ 0 };
+            uint16_t lastId{ 0xFFFF };
+        };
+
+        class Iterator;
+        class Range;
+
+        explicit ResourceDirectory(Pe::Image const& image) : _image{ image }
+        {
+            const auto dir = image.GetDataDirectory(Pe::ResourceDirectory);
+            if (dir.virtualAddress == 0 || dir.size == 0) return;
+
+            const auto offset = image.RvaToOffset(dir.virtualAddress, static_cast<uint32_t>(DirectoryHeaderSize));
+            if (!offset) throw InvalidFileException("Resource directory is not backed by file data");
+            _rootOffset = *offset;
+            _rootRva = dir.virtualAddress;
+            _maxEntries = (image.Data().size() - _rootOffset) / DirectoryEntrySize;
+        }
+
+        bool Empty() const noexcept { return _rootRva == 0; }
+        Pe::Image const& Image() const noexcept { return _image; }
+        size_t RootOffset() const noexcept { return _rootOffset; }
+        uint32_t RootRva() const noexcept { return _rootRva; }
+
+        // Calls f(ResourceEntry const&) for every resource in directory order.
+        // f returns false to stop the walk; ForEach then returns false as well.
+        // Like all walks it throws InvalidResourceException if it reads more
+        // entries than the directory can hold (see Budget).
+        template<typename F>
+        bool ForEach(F&& f) const
+        {
+            if (Empty()) return true;
+            Budget budget(_maxEntries);
+            return ForEachEntry(0, budget, [&](DirEntry const& type)
+            {
+                return !type.isDirectory || ForEachEntry(type.offset, budget, [&](DirEntry const& name)
+                {
+                    return !name.isDirectory || ForEachEntry(name.offset, budget, [&](DirEntry const& lang)
+                    {
+                        return lang.isDirectory || f(MakeEntry(type.name, name.name, lang));
+                    });
+                });
+            });
+        }
+
+        // same as ForEach, but only visits the resources of the given type
+        template<typename F>
+        bool ForEachOfType(ResId const& type, F&& f) const
+        {
+            auto typeEntry = FindEntry(0, type);
+            if (!typeEntry || !typeEntry->isDirectory) return true;
+            Budget budget(_maxEntries);
+            return ForEachEntry(typeEntry->offset, budget, [&](DirEntry const& name)
+            {
+                return !name.isDirectory || ForEachEntry(name.offset, budget, [&](DirEntry const& lang)
+                {
+                    return lang.isDirectory || f(MakeEntry(typeEntry->name, name.name, lang));
+                });
+            });
+        }
+
+        // Calls f(ResourceEntry const&) for the resources a selector (such as
+        // ResourceSelector) matches, in directory order. The selector provides
+        // TypeBounds/NameBounds/LangBounds (KeyBounds) and MatchesType/
+        // MatchesName (ResNameRef), MatchesLang and MatchesSize (uint32_t).
+        // Keys are checked as they are in the image, before anything is
+        // converted; since the ids of a directory table are sorted, the ones
+        // within bounds are found by binary search and the rest is skipped.
+        template<typename Selector, typename F>
+        bool ForEachSelected(Selector const& selector, F&& f) const
+        {
+            if (Empty()) return true;
+            const KeyBounds typeBounds = selector.TypeBounds();
+            const KeyBounds nameBounds = selector.NameBounds();
+            const KeyBounds langBounds = selector.LangBounds();
+            const auto data = _image.Data();
+            Budget budget(_maxEntries);
+            return ForEachEntryIn(0, budget, typeBounds, [&](DirEntry const& type)
+            {
+                return !type.isDirectory || !selector.MatchesType(type.name) || ForEachEntryIn(type.offset, budget, nameBounds, [&](DirEntry const& name)
+                {
+                    return !name.isDirectory || !selector.MatchesName(name.name) || ForEachEntryIn(name.offset, budget, langBounds, [&](DirEntry const& lang)
+                    {
+                        if (lang.isDirectory || lang.name.isName || !selector.MatchesLang(lang.name.id)) return true;
+                        if (!selector.MatchesSize(Pe::Read<uint32_t>(data, _rootOffset + lang.offset + 4))) return true;
+                        return f(MakeEntry(type.name, name.name, lang));
+                    });
+                });
+            });
+        }
+
+        // Lazy alternative to ForEach: the directory is read as the iterator
+        // advances, a filtered key skips the other subtrees of its level and
+        // leaving the loop early leaves the rest of the tree untouched.
+        Range Entries(Filter filter = {}) const;
+
+        bool Contains(Filter filter) const;
+
+        // Looks up a single resource. Without a language the first one listed is returned.
+        std::optional<ResourceEntry> Find(ResId const& type, ResId const& name, std::optional<uint16_t> lang = std::nullopt) const
+        {
+            if (Empty()) return std::nullopt;
+            auto typeEntry = FindEntry(0, type);
+            if (!typeEntry || !typeEntry->isDirectory) return std::nullopt;
+            auto nameEntry = FindEntry(typeEntry->offset, name);
+            if (!nameEntry || !nameEntry->isDirectory) return std::nullopt;
+
+            std::optional<ResourceEntry> result;
+            Budget budget(_maxEntries);
+            ForEachEntry(nameEntry->offset, budget, [&](DirEntry const& langEntry)
+            {
+                if (langEntry.isDirectory || (lang && langEntry.name.id != *lang)) return true;
+                result = MakeEntry(typeEntry->name, nameEntry->name, langEntry);
+                return false;
+            });
+            return result;
+        }
+
+        Pe::Bytes GetData(ResourceEntry const& entry) const
+        {
+            return _image.Data().subspan(entry.dataOffset, entry.size);
+        }
+
+    private:
+        // The entries one walk may read. Distinct tables can't hold more than
+        // fit into the file behind the root table, so a walk that reads more
+        // goes through tables that several entries point at, again and again:
+        // a file of a few MB could make 65535^3 callbacks otherwise.
+        class Budget
+        {
+        public:
+            explicit Budget(size_t entries) noexcept : _left{ entries } {}
+
+            void Take(size_t count)
+            {
+                if (count > _left) throw InvalidResourceException("Resource directory tables are referenced more than once");
+                _left -= count;
+            }
+
+        private:
+            size_t _left;
+        };
+
+        struct DirEntry
+        {
+            ResNameRef name;
+            bool isDirectory{ false };
+            uint32_t offset{ 0 };   // relative to the root directory
+        };
+
+        size_t EntryCount(uint32_t dirOffset) const
+        {
+            const auto data = _image.Data();
+            return size_t{ Pe::Read<uint16_t>(data, _rootOffset + dirOffset + 12) } + Pe::Read<uint16_t>(data, _rootOffset + dirOffset + 14);
+        }
+
+        DirEntry ReadEntry(uint32_t dirOffset, size_t index) const
+        {
+            const auto data = _image.Data();
+            const size_t offset = _rootOffset + dirOffset + DirectoryHeaderSize + index * DirectoryEntrySize;
+            const auto nameField = Pe::Read<uint32_t>(data, offset);
+            const auto dataField = Pe::Read<uint32_t>(data, offset + 4);
+
+            DirEntry entry;
+            if (nameField & SubdirectoryFlag)
+            {
+                const size_t nameOffset = _rootOffset + (nameField & ~SubdirectoryFlag);
+                const size_t length = Pe::Read<uint16_t>(data, nameOffset);
+                if (nameOffset + 2 + 2 * length > data.size()) throw InvalidFileException("Resource name at offset " + std::to_string(nameOffset) + " is out of range");
+                entry.name.isName = true;
+                entry.name.name = data.subspan(nameOffset + 2, 2 * length);
+            }
+            else
+            {
+                entry.name.id = static_cast<uint16_t>(nameField);
+            }
+            entry.isDirectory = (dataField & SubdirectoryFlag) != 0;
+            entry.offset = dataField & ~SubdirectoryFlag;
+            return entry;
+        }
+
+        template<typename F>
+        bool ForEachEntry(uint32_t dirOffset, Budget& budget, F&& f) const
+        {
+            const auto count = EntryCount(dirOffset);
+            budget.Take(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!f(ReadEntry(dirOffset, i))) return false;
+            }
+            return true;
+        }
+
+        // the named entries (if bounds.names) and the ids within bounds
+        template<typename F>
+        bool ForEachEntryIn(uint32_t dirOffset, Budget& budget, KeyBounds const& bounds, F&& f) const
+        {
+            const auto data = _image.Data();
+            const size_t named = Pe::Read<uint16_t>(data, _rootOffset + dirOffset + 12);
+            const size_t count = named + Pe::Read<uint16_t>(data, _rootOffset + dirOffset + 14);
+            budget.Take(count);
+            if (bounds.names)
+            {
+                for (size_t i = 0; i < named; ++i)
+                {
+                    if (!f(ReadEntry(dirOffset, i))) return false;
+                }
+            }
+
+            auto idAt = [&](size_t index)
+            {
+                return Pe::Read<uint16_t>(data, _rootOffset + dirOffset + DirectoryHeaderSize + index * DirectoryEntrySize);
+            };
+            size_t first = named;
+            for (size_t last = count; first < last;)
+            {
+                const auto middle = first + (last - first) / 2;
+                if (idAt(middle) < bounds.firstId) first = middle + 1;
+                else last = middle;
+            }
+            for (size_t i = first; i < count; ++i)
+            {
+                const auto entry = ReadEntry(dirOffset, i);
+                if (!entry.name.isName && entry.name.id > bounds.lastId) break;
+                if (!f(entry)) return false;
+            }
+            return true;
+        }
+
+        std::optional<DirEntry> FindEntry(uint32_t dirOffset, ResId const& key) const
+        {
+            std::optional<DirEntry> result;
+            Budget budget(_maxEntries);
+            ForEachEntry(dirOffset, budget, [&](DirEntry const& entry)
+            {
+                if (!entry.name.Matches(key)) return true;
+                result = entry;
+                return false;
+            });
+            return result;
+        }
+
+        ResourceEntry MakeEntry(ResNameRef const& type, ResNameRef const& name, DirEntry const& lang) const
+        {
+            const auto data = _image.Data();
+            ResourceEntry entry;
+            entry.type = type;
+            entry.name = name;
+            entry.lang = lang.name.id;
+            entry.dataEntryOffset = _rootOffset + lang.offset;
+            entry.dataRva = Pe::Read<uint32_t>(data, entry.dataEntryOffset);
+            entry.size = Pe::Read<uint32_t>(data, entry.dataEntryOffset + 4);
+            entry.codePage = Pe::Read<uint32_t>(data, entry.dataEntryOffset + 8);
+
+            const auto offset = _image.RvaToOffset(entry.dataRva, entry.size);
+            if (!offset)
+            {
+                throw InvalidResourceException("Data of resource " + type.ToTypeString() + "/" + name.ToString() + " is not backed by file data");
+            }
+            entry.dataOffset = *offset;
+            return entry;
+        }
+
+        Pe::Image const& _image;
+        size_t _rootOffset{ 0 };
+        uint32_t _rootRva{ 0 };
+        size_t _maxEntries{ 0 };    // see Budget
+    };
+
+    // Input iterator over the resources of a ResourceDirectory in directory
+    // order (see Entries). Keeps one cursor per directory level.
+    class ResourceDirectory::Iterator
+    {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = ResourceEntry;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        Iterator(ResourceDirectory const& directory, Filter filter) : _directory{ &directory }, _filter{ std::move(filter) }, _budget{ directory._maxEntries }
+        {
+            if (directory.Empty())
+            {
+                _directory = nullptr;
+                return;
+            }
+            _levels[0].count = directory.EntryCount(0);
+            _budget.Take(_levels[0].count);
+            Advance();
+        }
+
+        ResourceEntry const& operator*() const noexcept { return _entry; }
+        const ResourceEntry* operator->() const noexcept { return &_entry; }
+
+        Iterator& operator++()
+        {
+            Advance();
+            return *this;
+        }
+
+        void operator++(int) { Advance(); }
+
+        bool operator==(std::default_sentinel_t) const noexcept { return !_directory; }
+
+    private:
+        struct Level
+        {
+            uint32_t offset{ 0 };   // directory, relative to the root
+            size_t index{ 0 };      // next entry to read
+            size_t count{ 0 };
+            ResNameRef key;         // entry currently descended into
+        };
+
+        bool Matches(size_t depth, ResNameRef const& key) const noexcept
+        {
+            switch (depth)
+            {
+            case 0: return !_filter.type || key.Matches(*_filter.type);
+            case 1: return !_filter.name || key.Matches(*_filter.name);
+            default: return !_filter.lang || (key.IsId() && key.id == *_filter.lang);
+            }
+        }
+
+        bool Filtered(size_t depth) const noexcept
+        {
+            return depth == 0 ? _filter.type.has_value() : depth == 1 ? _filter.name.has_value() : _filter.lang.has_value();
+        }
+
+        void Advance()
+        {
+            for (;;)
+            {
+                auto& level = _levels[_depth];
+                if (level.index == level.count)
+                {
+                    if (_depth == 0) break;
+                    --_depth;
+                    continue;
+                }
+
+                const auto entry = _directory->ReadEntry(level.offset, level.index++);
+                if (!Matches(_depth, entry.name)) continue;
+                // keys are unique within a directory: after a filtered match the level is done
+                if (Filtered(_depth)) level.index = level.count;
+
+                if (_depth < 2)
+                {
+                    if (!entry.isDirectory) continue;
+                    level.key = entry.name;
+                    _levels[++_depth] = Level{ entry.offset, 0, _directory->EntryCount(entry.offset), {} };
+                    _budget.Take(_levels[_depth].count);
+                    continue;
+                }
+                if (entry.isDirectory) continue;
+                _entry = _directory->MakeEntry(_levels[0].key, _levels[1].key, entry);
+                return;
+            }
+            _directory = nullptr;
+        }
+
+        const ResourceDirectory* _directory{ nullptr };
+        Filter _filter;
+        Level _levels[3];
+        size_t _depth{ 0 };
+        ResourceDirectory::Budget _budget{ 0 };
+        ResourceEntry _entry;
+    };
+
+    class ResourceDirectory::Range
+    {
+    public:
+        explicit Range(Iterator begin) : _begin{ std::move(begin) } {}
+
+        // single pass: begin() hands out the current position
+        Iterator begin() const { return _begin; }
+        std::default_sentinel_t end() const noexcept { return std::default_sentinel; }
+        bool empty() const noexcept { return _begin == std::default_sentinel; }
+
+    private:
+        Iterator _begin;
+    };
+
+    inline ResourceDirectory::Range ResourceDirectory::Entries(Filter filter) const
+    {
+        return Range(Iterator(*this, std::move(filter)));
+    }
+
+    inline bool ResourceDirectory::Contains(Filter filter) const
+    {
+        return !Entries(std::move(filter)).empty();
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "PeImage.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace ResLib
+{
+    // How the native writer arranges the resource data behind the directory.
+    // By default it follows the directory order, like the linker. With
+    // locality, the resources read at startup (manifest, version, group icons
+    // and cursors) come first, right behind the directory, then the other
+    // small resources, and every other resource of at least alignFrom bytes
+    // starts on a page of its own (by RVA, and by file offset where the writer can
+    // place the section on a page boundary), so it can be mapped directly
+    // and touches as few pages as its size allows.
+    struct SectionLayout
+    {
+        bool locality{ false };
+        uint32_t pageSize{ 0x1000 };
+        uint32_t alignFrom{ 0x1000 };
+
+        // resource types the loader and shell read when a module is loaded or shown
+        static bool IsStartupType(ResId const& type) noexcept
+        {
+            return type.IsId() && (type.id == 24 || type.id == 16 || type.id == 14 || type.id == 12);   // manifest, version, group icon, group cursor
+        }
+
+        static bool IsStartupType(ResNameRef const& type) noexcept
+        {
+            return type.IsId() && IsStartupType(ResId(type.id));
+        }
+    };
+
+    // Pages of the resource section (by RVA, i.e. as mapped by the loader)
+    // that a layout makes the readers touch.
+    struct SectionPages
+    {
+        uint32_t section{ 0 };          // pages of the section
+        uint32_t startup{ 0 };          // pages holding the directory and the startup resources
+        uint32_t large{ 0 };            // pages spanned by the resources of at least a page
+        uint32_t largeMinimum{ 0 };     // pages those need at the least
+    };
+
+    static SectionPages CountPages(ResourceDirectory const& resources, uint32_t pageSize = 0x1000)
+    {
+        SectionPages pages;
+        if (resources.Empty()) return pages;
+
+        auto const& image = resources.Image();
+        const auto base = image.Data().data();
+        const auto rootRva = resources.RootRva();
+        auto toRva = [&](size_t fileOffset) { return static_cast<uint64_t>(rootRva) + fileOffset - resources.RootOffset(); };
+        auto addRange = [&](std::vector<uint64_t>& to, uint64_t rva, uint64_t size)
+        {
+            if (!size) return;
+            for (auto page = rva / pageSize; page <= (rva + size - 1) / pageSize; ++page) to.push_back(page);
+        };
+
+        // directory tables, data entries and names: everything from the root to the last of them
+        uint64_t directoryEnd = rootRva;
+        std::vector<uint64_t> startup;
+        resources.ForEach([&](ResourceEntry const& entry)
+        {
+            directoryEnd = std::max(directoryEnd, toRva(entry.dataEntryOffset) + ResourceDirectory::DataEntrySize);
+            for (auto const* key : { &entry.type, &entry.name })
+            {
+                if (key->isName) directoryEnd = std::max(directoryEnd, toRva(static_cast<size_t>(key->name.data() - base)) + key->name.size());
+            }
+            if (SectionLayout::IsStartupType(entry.type)) addRange(startup, entry.dataRva, entry.size);
+            if (entry.size >= pageSize)
+            {
+                pages.large += static_cast<uint32_t>((uint64_t{ entry.dataRva } + entry.size - 1) / pageSize - entry.dataRva / pageSize + 1);
+                pages.largeMinimum += static_cast<uint32_t>((uint64_t{ entry.size } + pageSize - 1) / pageSize);
+            }
+            return true;
+        });
+        addRange(startup, rootRva, directoryEnd - rootRva);
+        std::sort(startup.begin(), startup.end());
+        pages.startup = static_cast<uint32_t>(std::unique(startup.begin(), startup.end()) - startup.begin());
+
+        if (const auto section = image.FindSection(rootRva))
+        {
+            const uint64_t size = std::max(section->virtualSize, section->sizeOfRawData);
+            pages.section = static_cast<uint32_t>((section->virtualAddress % pageSize + size + pageSize - 1) / pageSize);
+        }
+        return pages;
+    }
+}
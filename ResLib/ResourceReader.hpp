@@ -0,0 +1,274 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "MappedFile.hpp"
+#include "PeImage.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+#include "ResourceSelector.hpp"
+
+#ifdef _WIN32
+#define VC_EXTRALEAN  // Exclude rarely-used stuff from Windows headers
+#include <Windows.h>
+#include "../Utf8.hpp"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace ResLib
+{
+    // Reads many resources of one file in file order. The directory order
+    // of resources has little to do with where their data is, so reading
+    // them one by one seeks back and forth; on disks and network mounts
+    // that costs far more than the bytes. ResourceReader resolves all
+    // requested resources through the mapped directory first, sorts them by
+    // file offset and coalesces neighbours into extents (reading the small
+    // gaps between them rather than seeking), then reads the extents front
+    // to back with large reads. The file is opened for sequential access and
+    // the next extents are announced to the kernel (posix_fadvise WILLNEED)
+    // while the current one is read and handed out.
+    class ResourceReader
+    {
+    public:
+        struct Options
+        {
+            uint32_t maxGap{ 64 * 1024 };           // neighbours closer than this are read together
+            uint32_t maxExtent{ 8 * 1024 * 1024 };  // bytes per read; a larger resource gets a read of its own
+            size_t readAhead{ 4 };                  // extents announced ahead of the one being read
+        };
+
+        // what to read: resource `index` (in the order added) at [offset, offset + size)
+        struct Range
+        {
+            uint64_t offset{ 0 };
+            uint32_t size{ 0 };
+            size_t index{ 0 };
+        };
+
+        // a read covering ranges [first, first + count) of the sorted ranges
+        struct Extent
+        {
+            uint64_t offset{ 0 };
+            uint64_t size{ 0 };
+            size_t first{ 0 };
+            size_t count{ 0 };
+        };
+
+        struct Result
+        {
+            size_t resources{ 0 };
+            size_t extents{ 0 };
+            uint64_t bytesRead{ 0 };    // including the gaps read along
+        };
+
+        explicit ResourceReader(const char* fileName)
+            : ResourceReader(fileName, Options())
+        {}
+
+        ResourceReader(const char* fileName, Options const& options)
+            : _map{ fileName }
+            , _image{ _map.Data() }
+            , _resources{ _image }
+            , _options{ options }
+        {
+            if (!_options.maxExtent) _options.maxExtent = 1;
+        }
+
+        ~ResourceReader() { Close(); }
+
+        ResourceReader(const ResourceReader&) = delete;
+        ResourceReader& operator=(const ResourceReader&) = delete;
+
+        ResourceDirectory const& Resources() const noexcept { return _resources; }
+        std::vector<ResourceEntry> const& Entries() const noexcept { return _entries; }
+
+        void Add(ResourceEntry const& entry)
+        {
+            if (entry.dataOffset > _map.Size() || entry.size > _map.Size() - entry.dataOffset)
+            {
+                throw InvalidFileException("Resource data at offset " + std::to_string(entry.dataOffset) + " is out of range");
+            }
+            _entries.push_back(entry);
+        }
+
+        // false if there is no such resource; without a language the first one listed is taken
+        bool Add(ResId const& type, ResId const& name, std::optional<uint16_t> lang = std::nullopt)
+        {
+            const auto entry = _resources.Find(type, name, lang);
+            if (entry) Add(*entry);
+            return entry.has_value();
+        }
+
+        // adds every resource the selector matches, returns their number
+        size_t Add(ResourceSelector const& selector)
+        {
+            const auto count = _entries.size();
+            _resources.ForEachSelected(selector, [&](ResourceEntry const& entry)
+            {
+                Add(entry);
+                return true;
+            });
+            return _entries.size() - count;
+        }
+
+        // Sorts the ranges by offset and groups them into extents.
+        static std::vector<Extent> Coalesce(std::vector<Range>& ranges, Options const& options)
+        {
+            std::stable_sort(ranges.begin(), ranges.end(), [](Range const& lhs, Range const& rhs) { return lhs.offset < rhs.offset; });
+            std::vector<Extent> extents;
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                auto const& range = ranges[i];
+                const auto end = range.offset + range.size;
+                if (!extents.empty())
+                {
+                    auto& last = extents.back();
+                    const auto lastEnd = last.offset + last.size;
+                    const auto newEnd = std::max(lastEnd, end);
+                    if (range.offset <= lastEnd + options.maxGap && newEnd - last.offset <= options.maxExtent)
+                    {
+                        last.size = newEnd - last.offset;
+                        ++last.count;
+                        continue;
+                    }
+                }
+                extents.push_back({ range.offset, range.size, i, 1 });
+            }
+            return extents;
+        }
+
+        // Calls f(size_t index, ResourceEntry const&, Pe::Bytes data) for every
+        // added resource in file order; index is its position in Entries().
+        // data is only valid during the call. f returns false to stop.
+        template<typename F>
+        Result Read(F&& f)
+        {
+            std::vector<Range> ranges;
+            ranges.reserve(_entries.size());
+            for (size_t i = 0; i < _entries.size(); ++i) ranges.push_back({ _entries[i].dataOffset, _entries[i].size, i });
+            const auto extents = Coalesce(ranges, _options);
+
+            Open();
+            Result result;
+            std::vector<unsigned char> buffer;
+            size_t announced = 0;
+            for (size_t e = 0; e < extents.size(); ++e)
+            {
+                for (; announced < extents.size() && announced <= e + _options.readAhead; ++announced) WillNeed(extents[announced]);
+
+                auto const& extent = extents[e];
+                buffer.resize(static_cast<size_t>(extent.size));
+                ReadAt(extent.offset, buffer);
+                ++result.extents;
+                result.bytesRead += extent.size;
+                for (size_t r = extent.first; r < extent.first + extent.count; ++r)
+                {
+                    auto const& range = ranges[r];
+                    const Pe::Bytes data(buffer.data() + (range.offset - extent.offset), range.size);
+                    ++result.resources;
+                    if (!f(range.index, _entries[range.index], data))
+                    {
+                        Close();
+                        return result;
+                    }
+                }
+            }
+            Close();
+            return result;
+        }
+
+    private:
+        [[noreturn]] void Fail(const char* what, std::error_code const& err)
+        {
+            Close();
+            throw FileAccessException(std::string(what) + " '" + _map.FileName() + "' failed: " + err.message());
+        }
+
+#ifdef _WIN32
+        void Open()
+        {
+            if (_file != INVALID_HANDLE_VALUE) return;
+            // sequential scan makes the cache manager read ahead aggressively
+            _file = ::CreateFileW(Utf8::ToWide(_map.FileName()).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (_file == INVALID_HANDLE_VALUE) Fail("Opening file", std::error_code(::GetLastError(), std::system_category()));
+        }
+
+        void Close() noexcept
+        {
+            if (_file != INVALID_HANDLE_VALUE) ::CloseHandle(_file);
+            _file = INVALID_HANDLE_VALUE;
+        }
+
+        void WillNeed(Extent const&) noexcept {}
+
+        void ReadAt(uint64_t offset, std::vector<unsigned char>& buffer)
+        {
+            for (size_t done = 0; done < buffer.size();)
+            {
+                OVERLAPPED position{};
+                position.Offset = static_cast<DWORD>(offset + done);
+                position.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+                DWORD bytesRead = 0;
+                const auto chunk = static_cast<DWORD>(std::min<size_t>(buffer.size() - done, 0x40000000));
+                if (!::ReadFile(_file, buffer.data() + done, chunk, &bytesRead, &position)) Fail("Reading file", std::error_code(::GetLastError(), std::system_category()));
+                if (bytesRead == 0) Fail("Reading file", std::make_error_code(std::errc::io_error));
+                done += bytesRead;
+            }
+        }
+
+        HANDLE _file{ INVALID_HANDLE_VALUE };
+#else
+        void Open()
+        {
+            if (_fd >= 0) return;
+            _fd = ::open(_map.FileName().c_str(), O_RDONLY | O_CLOEXEC);
+            if (_fd < 0) Fail("Opening file", std::error_code(errno, std::generic_category()));
+#ifdef POSIX_FADV_SEQUENTIAL
+            ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        }
+
+        void Close() noexcept
+        {
+            if (_fd >= 0) ::close(_fd);
+            _fd = -1;
+        }
+
+        void WillNeed([[maybe_unused]] Extent const& extent) noexcept
+        {
+#ifdef POSIX_FADV_WILLNEED
+            ::posix_fadvise(_fd, static_cast<off_t>(extent.offset), static_cast<off_t>(extent.size), POSIX_FADV_WILLNEED);
+#endif
+        }
+
+        void ReadAt(uint64_t offset, std::vector<unsigned char>& buffer)
+        {
+            for (size_t done = 0; done < buffer.size();)
+            {
+                const auto result = ::pread(_fd, buffer.data() + done, std::min<size_t>(buffer.size() - done, 0x40000000), static_cast<off_t>(offset + done));
+                if (result < 0 && errno == EINTR) continue;
+                if (result < 0) Fail("Reading file", std::error_code(errno, std::generic_category()));
+                if (result == 0) Fail("Reading file", std::make_error_code(std::errc::io_error));   // truncated since it was mapped
+                done += static_cast<size_t>(result);
+            }
+        }
+
+        int _fd{ -1 };
+#endif
+
+        MappedFile _map;
+        Pe::Image _image;
+        ResourceDirectory _resources;
+        Options _options;
+        std::vector<ResourceEntry> _entries;
+    };
+}
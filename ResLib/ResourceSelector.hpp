@@ -0,0 +1,282 @@
+#pragma once
+
+#include "Exceptions.hpp"
+#include "NameList.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ResLib
+{
+    // A type or name pattern. Without wildcards it is a key as ResId::Parse
+    // (or ParseType) takes it; with '*' and '?' it is a glob matched against
+    // string names and against the decimal number of ids. Like FindResource,
+    // string names are compared case insensitive (for ASCII).
+    class NamePattern
+    {
+    public:
+        static NamePattern Parse(std::string const& pattern)
+        {
+            return NamePattern(pattern, false);
+        }
+
+        static NamePattern ParseType(std::string const& pattern)
+        {
+            return NamePattern(pattern, true);
+        }
+
+        bool IsGlob() const noexcept { return _isGlob; }
+        ResId const& Key() const noexcept { return _key; }
+
+        // false for globs that can only match names, like "DEBUG_*"
+        bool CanMatchIds() const noexcept
+        {
+            if (!_isGlob) return _key.IsId();
+            return !_glob.empty() && (_glob[0] == u'*' || _glob[0] == u'?' || (_glob[0] >= u'0' && _glob[0] <= u'9'));
+        }
+
+        // works on keys read in place (ResNameRef) as well as on ResIds, without converting them
+        bool Matches(ResNameRef const& key) const noexcept
+        {
+            if (!_isGlob) return key.Matches(_key);
+            return key.IsId() ? MatchesId(key.id) : Glob(key.Length(), [&](size_t i) { return key.CharAt(i); });
+        }
+
+        bool Matches(ResId const& key) const noexcept
+        {
+            if (!_isGlob) return key.IsId() == _key.IsId() && (key.IsId() ? key.id == _key.id : Glob(key.name.size(), [&](size_t i) { return key.name[i]; }));
+            return key.IsId() ? MatchesId(key.id) : Glob(key.name.size(), [&](size_t i) { return key.name[i]; });
+        }
+
+    private:
+        NamePattern(std::string const& pattern, bool isType)
+            : _isGlob{ pattern.find_first_of("*?") != std::string::npos }
+        {
+            if (_isGlob)
+            {
+                _glob = Utf8::ToUtf16(pattern);
+            }
+            else
+            {
+                _key = isType ? ResId::ParseType(pattern.c_str()) : ResId::Parse(pattern.c_str());
+                _glob = _key.name;
+            }
+            for (auto& c : _glob) c = ResNameRef::ToUpper(c);
+        }
+
+        bool MatchesId(uint16_t id) const noexcept
+        {
+            char digits[8];
+            const auto end = std::to_chars(digits, digits + sizeof(digits), id).ptr;
+            return Glob(static_cast<size_t>(end - digits), [&](size_t i) { return static_cast<char16_t>(digits[i]); });
+        }
+
+        // '*' matches any run of characters, '?' a single one. Only the last
+        // '*' is ever backtracked to, so this takes at most length times
+        // pattern length steps.
+        template<typename CharAt>
+        bool Glob(size_t length, CharAt charAt) const noexcept
+        {
+            size_t p = 0;
+            size_t i = 0;
+            size_t star = std::u16string::npos;
+            size_t resume = 0;
+            while (i < length)
+            {
+                if (p < _glob.size() && _glob[p] == u'*')
+                {
+                    star = p++;
+                    resume = i;
+                }
+                else if (p < _glob.size() && (_glob[p] == u'?' || _glob[p] == ResNameRef::ToUpper(charAt(i))))
+                {
+                    ++p;
+                    ++i;
+                }
+                else if (star != std::u16string::npos)
+                {
+                    p = star + 1;
+                    i = ++resume;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            while (p < _glob.size() && _glob[p] == u'*') ++p;
+            return p == _glob.size();
+        }
+
+        bool _isGlob{ false };
+        ResId _key;
+        std::u16string _glob;   // upper case
+    };
+
+    // Selects resources by type, name, language and size. A resource is
+    // selected if its type matches one of the type patterns, its name one
+    // of the name patterns or id ranges, its language is one of langs and
+    // none of exceptLangs and its size is within [minSize, maxSize]; an
+    // empty list doesn't restrict anything.
+    //
+    // ResourceDirectory::ForEachSelected evaluates a selector on the keys
+    // in place and, through the *Bounds functions, skips the directory
+    // entries that can't match without reading them.
+    struct ResourceSelector
+    {
+        struct IdRange
+        {
+            uint16_t first{ 0 };
+            uint16_t last{ 0xFFFF };
+        };
+
+        std::vector<NamePattern> types;
+        std::vector<NamePattern> names;
+        std::vector<IdRange> ids;
+        std::vector<uint16_t> langs;
+        std::vector<uint16_t> exceptLangs;
+        uint32_t minSize{ 0 };
+        uint32_t maxSize{ 0xFFFFFFFF };
+
+        // "100-199" is an id range, anything else a NamePattern
+        void AddName(std::string const& pattern)
+        {
+            const auto dash = pattern.find('-');
+            uint16_t first = 0;
+            uint16_t last = 0;
+            if (dash != std::string::npos && ParseId(pattern.substr(0, dash), first) && ParseId(pattern.substr(dash + 1), last))
+            {
+                if (first > last) throw InvalidArgsException();
+                ids.push_back({ first, last });
+                return;
+            }
+            names.push_back(NamePattern::Parse(pattern));
+        }
+
+        // false if the types can match only one type: a single key, no glob
+        bool CanMatchTypes() const noexcept
+        {
+            return types.size() != 1 || types[0].IsGlob();
+        }
+
+        template<typename Key>
+        bool MatchesType(Key const& type) const noexcept
+        {
+            return types.empty() || std::any_of(types.begin(), types.end(), [&](NamePattern const& pattern) { return pattern.Matches(type); });
+        }
+
+        template<typename Key>
+        bool MatchesName(Key const& name) const noexcept
+        {
+            if (names.empty() && ids.empty()) return true;
+            return std::any_of(names.begin(), names.end(), [&](NamePattern const& pattern) { return pattern.Matches(name); })
+                || (name.IsId() && std::any_of(ids.begin(), ids.end(), [&](IdRange const& range) { return name.id >= range.first && name.id <= range.last; }));
+        }
+
+        bool MatchesLang(uint16_t lang) const noexcept
+        {
+            return (langs.empty() || std::find(langs.begin(), langs.end(), lang) != langs.end())
+                && std::find(exceptLangs.begin(), exceptLangs.end(), lang) == exceptLangs.end();
+        }
+
+        bool MatchesSize(uint64_t size) const noexcept
+        {
+            return size >= minSize && size <= maxSize;
+        }
+
+        bool Matches(ResourceEntry const& entry) const noexcept
+        {
+            return MatchesType(entry.type) && MatchesName(entry.name) && MatchesLang(entry.lang) && MatchesSize(entry.size);
+        }
+
+        ResourceDirectory::KeyBounds TypeBounds() const noexcept { return Bounds(types, {}); }
+        ResourceDirectory::KeyBounds NameBounds() const noexcept { return Bounds(names, ids); }
+
+        ResourceDirectory::KeyBounds LangBounds() const noexcept
+        {
+            ResourceDirectory::KeyBounds bounds{ false };
+            if (langs.empty()) return bounds;
+            bounds.firstId = *std::min_element(langs.begin(), langs.end());
+            bounds.lastId = *std::max_element(langs.begin(), langs.end());
+            return bounds;
+        }
+
+    private:
+        static bool ParseId(std::string const& text, uint16_t& id) noexcept
+        {
+            const auto end = text.data() + text.size();
+            return !text.empty() && std::from_chars(text.data(), end, id).ptr == end;
+        }
+
+        // Globs starting with a letter only match names, other globs may
+        // match names and ids (by their digits) alike; exact keys and id
+        // ranges narrow the ids down.
+        static ResourceDirectory::KeyBounds Bounds(std::vector<NamePattern> const& patterns, std::vector<IdRange> const& ranges) noexcept
+        {
+            ResourceDirectory::KeyBounds bounds;
+            if (patterns.empty() && ranges.empty()) return bounds;
+            bounds = { false, 0xFFFF, 0 };
+            auto addIds = [&](uint16_t first, uint16_t last)
+            {
+                bounds.firstId = std::min(bounds.firstId, first);
+                bounds.lastId = std::max(bounds.lastId, last);
+            };
+            for (auto const& pattern : patterns)
+            {
+                if (pattern.IsGlob() && pattern.CanMatchIds()) return {};
+                if (pattern.CanMatchIds()) addIds(pattern.Key().id, pattern.Key().id);
+                else bounds.names = true;
+            }
+            for (auto const& range : ranges) addIds(range.first, range.last);
+            return bounds;
+        }
+    };
+
+    // Calls f(ResNameRef const& type, ResNameRef const& name) once for each
+    // type and name with selected resources, in directory order. The keys
+    // point into the image; nothing is converted.
+    template<typename F>
+    static void ForEachSelectedName(ResourceDirectory const& resources, ResourceSelector const& selector, F&& f)
+    {
+        ResNameRef lastType;
+        ResNameRef lastName;
+        bool first = true;
+        auto same = [](ResNameRef const& lhs, ResNameRef const& rhs)
+        {
+            return lhs.isName == rhs.isName && lhs.id == rhs.id && lhs.name.data() == rhs.name.data();
+        };
+        resources.ForEachSelected(selector, [&](ResourceEntry const& entry)
+        {
+            if (!first && same(entry.type, lastType) && same(entry.name, lastName)) return true;
+            first = false;
+            lastType = entry.type;
+            lastName = entry.name;
+            f(entry.type, entry.name);
+            return true;
+        });
+    }
+
+    // The distinct names of the selected resources (each name once per
+    // type, in directory order). Only the selected names are converted.
+    static NameList ListNames(ResourceDirectory const& resources, ResourceSelector const& selector)
+    {
+        NameList names;
+        std::u16string buffer;
+        ForEachSelectedName(resources, selector, [&](ResNameRef const&, ResNameRef const& name)
+        {
+            if (name.IsId())
+            {
+                names.Add(name.id);
+                return;
+            }
+            buffer.resize(name.Length());
+            for (size_t i = 0; i < buffer.size(); ++i) buffer[i] = name.CharAt(i);
+            if (!buffer.empty()) names.Add(std::u16string_view(buffer));
+        });
+        return names;
+    }
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "PeImage.hpp"
+#include "ResourceDirectory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ResLib
+{
+    // A structural problem of a resource section.
+    struct ResourceDefect
+    {
+        size_t offset{ 0 };     // file offset of the offending structure
+        std::string path;       // type/name/lang of the entry as far as known, empty for the root
+        std::string message;
+    };
+
+    // Checks the resource section of an image the way a strict loader would
+    // read it and reports every defect instead of failing on the first one:
+    // tables, entries, names and data entries outside the resource directory,
+    // data not backed by the file, wrong nesting (data at the type or name
+    // level, tables at the language level), named/id counts that don't match
+    // the entries, unsorted or duplicate keys, invalid UTF-16 names, tables or
+    // data entries referenced more than once (which includes cycles) and
+    // resource data overlapping other resource data.
+    //
+    // All reads are checked against the resource directory (as declared by
+    // the data directory and clamped to the file), every table is visited at
+    // most once, so the work is linear in the size of the section whatever
+    // the content.
+    class ResourceValidator
+    {
+    public:
+        explicit ResourceValidator(Pe::Image const& image, size_t maxDefects = 100)
+            : _image{ image }
+            , _maxDefects{ maxDefects }
+        {}
+
+        // may only be called once
+        std::vector<ResourceDefect> Run()
+        {
+            if (_image.NumberOfDataDirectories() <= Pe::ResourceDirectory) return {};
+            const auto dir = _image.GetDataDirectory(Pe::ResourceDirectory);
+            if (dir.virtualAddress == 0 && dir.size == 0) return {};
+
+            const auto dirEntry = _image.DataDirectoryOffset(Pe::ResourceDirectory);
+            if (dir.virtualAddress == 0 || dir.size < ResourceDirectory::DirectoryHeaderSize)
+            {
+                Add(dirEntry, "resource data directory has RVA " + Hex(dir.virtualAddress) + " and size " + Hex(dir.size));
+                return std::move(_defects);
+            }
+
+            auto offset = _image.RvaToOffset(dir.virtualAddress, dir.size);
+            uint32_t size = dir.size;
+            if (!offset)
+            {
+                offset = _image.RvaToOffset(dir.virtualAddress, static_cast<uint32_t>(ResourceDirectory::DirectoryHeaderSize));
+                if (!offset)
+                {
+                    Add(dirEntry, "resource directory at RVA " + Hex(dir.virtualAddress) + " is not backed by file data");
+                    return std::move(_defects);
+                }
+                // check what there is
+                const auto section = _image.FindSection(dir.virtualAddress);
+                size_t available = _image.Data().size() - *offset;
+                if (section) available = std::min<size_t>(available, size_t{ section->sizeOfRawData } - (dir.virtualAddress - section->virtualAddress));
+                size = static_cast<uint32_t>(std::min<size_t>(available, size));
+                Add(dirEntry, "resource directory size " + Hex(dir.size) + " exceeds the file data of its section (" + Hex(size) + " bytes)");
+            }
+            _rootOffset = *offset;
+            _directory = _image.Data().subspan(*offset, size);
+
+            Walk(0, 0);
+            CheckOverlaps();
+            if (_defects.size() > _maxDefects)
+            {
+                _defects.resize(_maxDefects);
+                _defects.push_back({ _rootOffset, {}, "too many defects, stopped" });
+            }
+            return std::move(_defects);
+        }
+
+    private:
+        struct DataRange
+        {
+            size_t offset{ 0 };     // file offset of the data
+            size_t size{ 0 };
+            size_t entryOffset{ 0 };
+            ResNameRef keys[3];     // the path is only formatted for a defect
+        };
+
+        static std::string Hex(uint64_t value)
+        {
+            char text[24];
+            std::snprintf(text, sizeof(text), "0x%llX", static_cast<unsigned long long>(value));
+            return text;
+        }
+
+        bool Full() const noexcept { return _defects.size() > _maxDefects; }
+
+        void Add(size_t offset, std::string message)
+        {
+            _defects.push_back({ offset, Path(), std::move(message) });
+        }
+
+        // reads within the resource directory, relative to its start
+        bool Fits(uint64_t offset, uint64_t size) const noexcept
+        {
+            return offset <= _directory.size() && _directory.size() - offset >= size;
+        }
+
+        uint32_t Read32(size_t offset) const noexcept
+        {
+            return uint32_t{ _directory[offset] } | uint32_t{ _directory[offset + 1] } << 8 | uint32_t{ _directory[offset + 2] } << 16 | uint32_t{ _directory[offset + 3] } << 24;
+        }
+
+        uint16_t Read16(size_t offset) const noexcept
+        {
+            return static_cast<uint16_t>(_directory[offset] | _directory[offset + 1] << 8);
+        }
+
+        static std::string Path(ResNameRef const* keys, size_t depth)
+        {
+            std::string path;
+            for (size_t i = 0; i < depth; ++i)
+            {
+                if (i) path += '/';
+                path += i == 0 ? keys[i].ToTypeString() : keys[i].ToString();
+            }
+            return path;
+        }
+
+        std::string Path() const { return Path(_keys, _depth); }
+
+        // true for well-formed UTF-16 (no unpaired surrogates)
+        static bool IsValidUtf16(ResNameRef const& name) noexcept
+        {
+            for (size_t i = 0; i < name.Length(); ++i)
+            {
+                const auto c = name.CharAt(i);
+                if (c >= 0xD800 && c <= 0xDBFF)
+                {
+                    if (i + 1 == name.Length()) return false;
+                    const auto next = name.CharAt(++i);
+                    if (next < 0xDC00 || next > 0xDFFF) return false;
+                }
+                else if (c >= 0xDC00 && c <= 0xDFFF)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // compares code units, as the keys are sorted (names are stored upper case)
+        static int Compare(ResNameRef const& lhs, ResNameRef const& rhs) noexcept
+        {
+            if (lhs.IsId() != rhs.IsId()) return lhs.IsId() ? 1 : -1;
+            if (lhs.IsId()) return lhs.id < rhs.id ? -1 : lhs.id > rhs.id ? 1 : 0;
+            const auto length = std::min(lhs.Length(), rhs.Length());
+            for (size_t i = 0; i < length; ++i)
+            {
+                if (lhs.CharAt(i) != rhs.CharAt(i)) return lhs.CharAt(i) < rhs.CharAt(i) ? -1 : 1;
+            }
+            return lhs.Length() < rhs.Length() ? -1 : lhs.Length() > rhs.Length() ? 1 : 0;
+        }
+
+        std::optional<ResNameRef> ReadName(uint32_t field, size_t entryOffset)
+        {
+            ResNameRef name;
+            const auto offset = field & ~ResourceDirectory::SubdirectoryFlag;
+            if (!Fits(offset, 2))
+            {
+                Add(_rootOffset + entryOffset, "name at +" + Hex(offset) + " is outside the resource directory");
+                return std::nullopt;
+            }
+            const auto length = Read16(offset);
+            if (length == 0)
+            {
+                Add(_rootOffset + offset, "empty name");
+                return std::nullopt;
+            }
+            if (!Fits(size_t{ offset } + 2, size_t{ 2 } * length))
+            {
+                Add(_rootOffset + offset, "name of " + std::to_string(length) + " characters runs past the end of the resource directory");
+                return std::nullopt;
+            }
+            name.isName = true;
+            name.name = _directory.subspan(size_t{ offset } + 2, size_t{ 2 } * length);
+            if (!IsValidUtf16(name))
+            {
+                Add(_rootOffset + offset, "name is not valid UTF-16");
+                return std::nullopt;
+            }
+            return name;
+        }
+
+        void Walk(uint32_t tableOffset, size_t depth)
+        {
+            if (Full()) return;
+            if (!Fits(tableOffset, ResourceDirectory::DirectoryHeaderSize))
+            {
+                Add(_rootOffset, "directory table at +" + Hex(tableOffset) + " is outside the resource directory");
+                return;
+            }
+            if (!_tables.insert(tableOffset).second)
+            {
+                const bool cycle = std::find(_ancestors, _ancestors + depth, tableOffset) != _ancestors + depth;
+                Add(_rootOffset + tableOffset, cycle ? "directory tables form a cycle" : "directory table is referenced more than once");
+                return;
+            }
+            _ancestors[depth] = tableOffset;
+
+            const size_t named = Read16(tableOffset + 12);
+            const size_t ids = Read16(tableOffset + 14);
+            size_t count = named + ids;
+            const size_t entries = tableOffset + ResourceDirectory::DirectoryHeaderSize;
+            if (!Fits(entries, count * ResourceDirectory::DirectoryEntrySize))
+            {
+                count = (_directory.size() - entries) / ResourceDirectory::DirectoryEntrySize;
+                Add(_rootOffset + tableOffset, std::to_string(named + ids) + " entries don't fit into the resource directory, only " + std::to_string(count) + " do");
+            }
+
+            std::optional<ResNameRef> previous;
+            for (size_t i = 0; i < count && !Full(); ++i)
+            {
+                const size_t entry = entries + i * ResourceDirectory::DirectoryEntrySize;
+                const auto nameField = Read32(entry);
+                const auto dataField = Read32(entry + 4);
+
+                std::optional<ResNameRef> key;
+                const bool isName = (nameField & ResourceDirectory::SubdirectoryFlag) != 0;
+                if (isName != (i < named))
+                {
+                    Add(_rootOffset + entry, isName ? "named entry after the " + std::to_string(named) + " named entries the table declares" : "id entry among the " + std::to_string(named) + " named entries the table declares");
+                }
+                if (isName)
+                {
+                    key = ReadName(nameField, entry);
+                }
+                else
+                {
+                    key = ResNameRef{};
+                    key->id = static_cast<uint16_t>(nameField);
+                    if (nameField > 0xFFFF) Add(_rootOffset + entry, "id " + Hex(nameField) + " has more than 16 bits");
+                }
+                if (!key) continue;
+
+                if (previous)
+                {
+                    const auto order = Compare(*previous, *key);
+                    if (order == 0) Add(_rootOffset + entry, "duplicate key " + (key->IsId() ? std::to_string(key->id) : key->ToString()));
+                    else if (order > 0) Add(_rootOffset + entry, "key " + (key->IsId() ? std::to_string(key->id) : key->ToString()) + " is out of order");
+                }
+                previous = key;
+
+                _keys[depth] = *key;
+                _depth = depth + 1;
+                const bool isDirectory = (dataField & ResourceDirectory::SubdirectoryFlag) != 0;
+                const auto target = dataField & ~ResourceDirectory::SubdirectoryFlag;
+                if (depth == 2 && isName) Add(_rootOffset + entry, "language entry has a name");
+                if (depth < 2 && !isDirectory) Add(_rootOffset + entry, std::string(depth == 0 ? "type" : "name") + " entry points to data instead of a directory table");
+                else if (depth == 2 && isDirectory) Add(_rootOffset + entry, "language entry points to a directory table instead of data");
+                else if (isDirectory) Walk(target, depth + 1);
+                else CheckDataEntry(target, entry);
+                _depth = depth;
+            }
+        }
+
+        void CheckDataEntry(uint32_t offset, size_t entry)
+        {
+            if (!Fits(offset, ResourceDirectory::DataEntrySize))
+            {
+                Add(_rootOffset + entry, "data entry at +" + Hex(offset) + " is outside the resource directory");
+                return;
+            }
+            const auto rva = Read32(offset);
+            const auto size = Read32(offset + 4);
+            const auto data = _image.RvaToOffset(rva, size);
+            if (!data)
+            {
+                Add(_rootOffset + offset, "data at RVA " + Hex(rva) + " with size " + Hex(size) + " is not backed by file data");
+                return;
+            }
+            // a data entry referenced more than once shows up as overlap with itself
+            if (size) _data.push_back({ *data, size, _rootOffset + offset, { _keys[0], _keys[1], _keys[2] } });
+        }
+
+        void CheckOverlaps()
+        {
+            std::sort(_data.begin(), _data.end(), [](DataRange const& lhs, DataRange const& rhs) { return lhs.offset < rhs.offset; });
+            size_t last = 0;    // the range reaching furthest so far
+            for (size_t i = 1; i < _data.size() && !Full(); ++i)
+            {
+                if (_data[i].offset < _data[last].offset + _data[last].size)
+                {
+                    const bool shared = _data[i].entryOffset == _data[last].entryOffset;
+                    _defects.push_back({ _data[i].entryOffset, Path(_data[i].keys, 3), (shared ? "data entry is shared with " : "data overlaps the data of ") + Path(_data[last].keys, 3) });
+                }
+                if (_data[i].offset + _data[i].size > _data[last].offset + _data[last].size) last = i;
+            }
+        }
+
+        Pe::Image const& _image;
+        size_t _maxDefects;
+        size_t _rootOffset{ 0 };
+        Pe::Bytes _directory;
+        std::vector<ResourceDefect> _defects;
+        std::unordered_set<uint32_t> _tables;
+        std::vector<DataRange> _data;
+        uint32_t _ancestors[3]{};
+        ResNameRef _keys[3];
+        size_t _depth{ 0 };
+    };
+}
@@ -0,0 +1,984 @@
+#pragma once
+
+#include "ImageIntegrity.hpp"
+#include "MappedFile.hpp"
+#include "PendingFile.hpp"
+#include "PeImage.hpp"
+#include "ResId.hpp"
+#include "ResourceDirectory.hpp"
+#include "ResourceSelector.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace ResLib
+{
+    // All resources of an image as an editable table. Build() serializes them
+    // into a complete resource section, laid out the way the linker does it:
+    // directory tables, data entries, name strings, then the data itself
+    // (in directory order, or as SectionLayout says).
+    //
+    // The table is a hash map, so Set/Remove/Find don't depend on its size.
+    // Build() orders the entries with radix sorts (string names by UTF-16
+    // code units, as the PE format requires, then type/name/lang) and writes
+    // the section in one pass over flat arrays, which keeps it linear in the
+    // number of entries even for hundreds of thousands of them.
+    class ResourceTable
+    {
+    public:
+        struct Key
+        {
+            ResId type;
+            ResId name;
+            uint16_t lang{ 0 };
+
+            friend bool operator<(Key const& lhs, Key const& rhs) noexcept
+            {
+                return std::tie(lhs.type, lhs.name, lhs.lang) < std::tie(rhs.type, rhs.name, rhs.lang);
+            }
+
+            friend bool operator==(Key const& lhs, Key const& rhs) noexcept
+            {
+                return lhs.lang == rhs.lang && lhs.type == rhs.type && lhs.name == rhs.name;
+            }
+        };
+
+        struct Item
+        {
+            std::vector<unsigned char> data;
+            uint32_t codePage{ 0 };
+        };
+
+        struct Entry
+        {
+            Key const* key{ nullptr };
+            Item const* item{ nullptr };
+        };
+
+        ResourceTable() = default;
+
+        explicit ResourceTable(ResourceDirectory const& resources)
+        {
+            resources.ForEach([&](ResourceEntry const& entry)
+            {
+                Set(entry.type.ToResId(), entry.name.ToResId(), entry.lang, resources.GetData(entry), entry.codePage);
+                return true;
+            });
+        }
+
+        void Set(ResId const& type, ResId const& name, uint16_t lang, Pe::Bytes data, uint32_t codePage = 0)
+        {
+            auto& item = _items[{ Normalize(type), Normalize(name), lang }];
+            item.data.assign(data.begin(), data.end());
+            item.codePage = codePage;
+        }
+
+        bool Remove(ResId const& type, ResId const& name, uint16_t lang)
+        {
+            return _items.erase({ Normalize(type), Normalize(name), lang }) != 0;
+        }
+
+        // removes every entry for which f(Key const&, Item const&) is true and returns their number
+        template<typename F>
+        size_t RemoveIf(F&& f)
+        {
+            return std::erase_if(_items, [&](auto const& item) { return f(item.first, item.second); });
+        }
+
+        Item const* Find(ResId const& type, ResId const& name, uint16_t lang) const
+        {
+            auto iter = _items.find({ Normalize(type), Normalize(name), lang });
+            return iter != _items.end() ? &iter->second : nullptr;
+        }
+
+        size_t Size() const noexcept { return _items.size(); }
+        bool Empty() const noexcept { return _items.empty(); }
+
+        // all entries in resource directory order
+        std::vector<Entry> Sorted() const
+        {
+            return Sort().entries;
+        }
+
+        // Serializes the table for a section starting at sectionRva.
+        std::vector<unsigned char> Build(uint32_t sectionRva, SectionLayout const& layout = {}) const
+        {
+            const auto sorted = Sort();
+            auto const& entries = sorted.entries;
+
+            // directory sizes: root -> one table per type -> one table per type/name
+            struct Count
+            {
+                size_t named{ 0 };
+                size_t total{ 0 };
+            };
+            Count types;
+            std::vector<Count> namesPerType;
+            std::vector<size_t> langsPerName;
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                auto const& key = *entries[i].key;
+                const bool newType = i == 0 || sorted.typeRanks[i] != sorted.typeRanks[i - 1];
+                if (newType)
+                {
+                    ++types.total;
+                    types.named += key.type.IsId() ? 0 : 1;
+                    namesPerType.emplace_back();
+                }
+                if (newType || sorted.nameRanks[i] != sorted.nameRanks[i - 1])
+                {
+                    ++namesPerType.back().total;
+                    namesPerType.back().named += key.name.IsId() ? 0 : 1;
+                    langsPerName.push_back(0);
+                }
+                ++langsPerName.back();
+            }
+
+            // offsets, relative to the section start
+            constexpr uint64_t header = ResourceDirectory::DirectoryHeaderSize;
+            constexpr uint64_t entrySize = ResourceDirectory::DirectoryEntrySize;
+            const uint64_t typeTables = header + types.total * entrySize;
+            const uint64_t nameTables = typeTables + types.total * header + langsPerName.size() * entrySize;
+            const uint64_t dataEntries = nameTables + langsPerName.size() * header + entries.size() * entrySize;
+            uint64_t offset = dataEntries + entries.size() * ResourceDirectory::DataEntrySize;
+
+            // every distinct name once, in order of first use
+            std::vector<uint32_t> stringOffsets(sorted.strings.size(), 0);
+            auto placeString = [&](ResId const& id, uint32_t rank)
+            {
+                if (id.IsId() || stringOffsets[rank]) return;
+                stringOffsets[rank] = CheckOffset(offset);
+                offset += 2 + 2 * uint64_t{ id.name.size() };
+            };
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                placeString(entries[i].key->type, sorted.typeRanks[i]);
+                placeString(entries[i].key->name, sorted.nameRanks[i]);
+            }
+            std::vector<uint32_t> dataOffsets(entries.size());
+            for (auto i : DataOrder(entries, layout))
+            {
+                const auto size = entries[i].item->data.size();
+                const bool pageAligned = layout.locality && size >= layout.alignFrom && !SectionLayout::IsStartupType(entries[i].key->type);
+                const uint64_t alignment = pageAligned ? layout.pageSize : DataAlignment;
+                offset = (sectionRva + offset + alignment - 1) / alignment * alignment - sectionRva;
+                dataOffsets[i] = CheckOffset(offset);
+                offset += size;
+            }
+            CheckOffset(offset);
+
+            std::vector<unsigned char> section(static_cast<size_t>(offset));
+            auto writeHeader = [&](uint64_t table, Count const& count)
+            {
+                CheckEntryCount(count.named);
+                CheckEntryCount(count.total - count.named);
+                Pe::Write<uint16_t>(section, static_cast<size_t>(table + 12), static_cast<uint16_t>(count.named));
+                Pe::Write<uint16_t>(section, static_cast<size_t>(table + 14), static_cast<uint16_t>(count.total - count.named));
+            };
+            auto writeEntry = [&](uint64_t entry, ResId const& id, uint32_t rank, uint64_t table)
+            {
+                Pe::Write<uint32_t>(section, static_cast<size_t>(entry), id.IsId() ? id.id : ResourceDirectory::SubdirectoryFlag | stringOffsets[rank]);
+                Pe::Write<uint32_t>(section, static_cast<size_t>(entry + 4), ResourceDirectory::SubdirectoryFlag | static_cast<uint32_t>(table));
+            };
+
+            // a single pass writes all tables; each level has a cursor to its current table and entry
+            writeHeader(0, types);
+            uint64_t rootEntry = header;
+            uint64_t typeTable = typeTables;
+            uint64_t typeEntry = 0;
+            uint64_t nameTable = nameTables;
+            uint64_t nameEntry = 0;
+            size_t typeIndex = 0;
+            size_t nameIndex = 0;
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                auto const& key = *entries[i].key;
+                const bool newType = i == 0 || sorted.typeRanks[i] != sorted.typeRanks[i - 1];
+                if (newType)
+                {
+                    if (i) typeTable += header + namesPerType[typeIndex++].total * entrySize;
+                    writeEntry(rootEntry, key.type, sorted.typeRanks[i], typeTable);
+                    writeHeader(typeTable, namesPerType[typeIndex]);
+                    rootEntry += entrySize;
+                    typeEntry = typeTable + header;
+                }
+                if (newType || sorted.nameRanks[i] != sorted.nameRanks[i - 1])
+                {
+                    if (i) nameTable += header + langsPerName[nameIndex++] * entrySize;
+                    writeEntry(typeEntry, key.name, sorted.nameRanks[i], nameTable);
+                    writeHeader(nameTable, { 0, langsPerName[nameIndex] });
+                    typeEntry += entrySize;
+                    nameEntry = nameTable + header;
+                }
+
+                const auto dataEntry = dataEntries + i * ResourceDirectory::DataEntrySize;
+                Pe::Write<uint32_t>(section, static_cast<size_t>(nameEntry), key.lang);
+                Pe::Write<uint32_t>(section, static_cast<size_t>(nameEntry + 4), static_cast<uint32_t>(dataEntry));
+                nameEntry += entrySize;
+
+                auto const& item = *entries[i].item;
+                Pe::Write<uint32_t>(section, static_cast<size_t>(dataEntry), sectionRva + dataOffsets[i]);
+                Pe::Write<uint32_t>(section, static_cast<size_t>(dataEntry + 4), static_cast<uint32_t>(item.data.size()));
+                Pe::Write<uint32_t>(section, static_cast<size_t>(dataEntry + 8), item.codePage);
+                std::copy(item.data.begin(), item.data.end(), section.begin() + dataOffsets[i]);
+            }
+
+            for (size_t rank = 0; rank < sorted.strings.size(); ++rank)
+            {
+                auto const& name = sorted.strings[rank];
+                const size_t stringOffset = stringOffsets[rank];
+                Pe::Write<uint16_t>(section, stringOffset, static_cast<uint16_t>(name.size()));
+                for (size_t c = 0; c < name.size(); ++c) Pe::Write<uint16_t>(section, stringOffset + 2 + 2 * c, name[c]);
+            }
+            return section;
+        }
+
+        // Moves a section built by Build to another RVA: only the data entries
+        // hold RVAs, everything else is relative to the section start.
+        static void Rebase(std::vector<unsigned char>& section, uint32_t delta)
+        {
+            auto forEachEntry = [&](uint32_t table, auto&& f)
+            {
+                const size_t count = size_t{ Pe::Read<uint16_t>(section, table + 12) } + Pe::Read<uint16_t>(section, table + 14);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    f(Pe::Read<uint32_t>(section, table + ResourceDirectory::DirectoryHeaderSize + i * ResourceDirectory::DirectoryEntrySize + 4) & ~ResourceDirectory::SubdirectoryFlag);
+                }
+            };
+            forEachEntry(0, [&](uint32_t typeTable)
+            {
+                forEachEntry(typeTable, [&](uint32_t nameTable)
+                {
+                    forEachEntry(nameTable, [&](uint32_t dataEntry)
+                    {
+                        Pe::Write<uint32_t>(section, dataEntry, Pe::Read<uint32_t>(section, dataEntry) + delta);
+                    });
+                });
+            });
+        }
+
+        // UpdateResource stores string names upper case; doing the same keeps
+        // lookups (which are case insensitive) and the sort order consistent.
+        static ResId Normalize(ResId id)
+        {
+            for (auto& c : id.name) c = ResNameRef::ToUpper(c);
+            return id;
+        }
+
+    private:
+        static constexpr uint32_t DataAlignment = 8;
+
+        struct KeyHash
+        {
+            size_t operator()(Key const& key) const noexcept
+            {
+                const std::hash<std::u16string> hash;
+                size_t result = key.type.IsId() ? key.type.id : hash(key.type.name);
+                result = result * 0x9E3779B97F4A7C15ull + (key.name.IsId() ? key.name.id : hash(key.name.name));
+                return result * 0x9E3779B97F4A7C15ull + key.lang;
+            }
+        };
+
+        // Entries in directory order. A rank orders types (or names) the way
+        // the directory lists them: string names by their index in strings,
+        // then ids, so equal ranks mean equal keys.
+        struct SortResult
+        {
+            std::vector<Entry> entries;
+            std::vector<uint32_t> typeRanks;
+            std::vector<uint32_t> nameRanks;
+            std::vector<std::u16string_view> strings;   // distinct string names, sorted
+        };
+
+        SortResult Sort() const
+        {
+            // every string name occurrence; sorting them also finds the distinct ones
+            constexpr uint32_t NoString = 0xFFFFFFFF;
+            std::vector<std::u16string_view> occurrences;
+            std::vector<std::pair<uint32_t, uint32_t>> itemStrings;     // type, name occurrence
+            itemStrings.reserve(_items.size());
+            for (auto const& [key, item] : _items)
+            {
+                auto add = [&](ResId const& id)
+                {
+                    if (id.IsId()) return NoString;
+                    occurrences.push_back(id.name);
+                    return static_cast<uint32_t>(occurrences.size() - 1);
+                };
+                const auto type = add(key.type);
+                itemStrings.emplace_back(type, add(key.name));
+            }
+            const auto order = SortStrings(occurrences);
+
+            SortResult result;
+            std::vector<uint32_t> occurrenceRank(occurrences.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                auto const& string = occurrences[order[i]];
+                if (i == 0 || string != result.strings.back()) result.strings.push_back(string);
+                occurrenceRank[order[i]] = static_cast<uint32_t>(result.strings.size() - 1);
+            }
+
+            // sort key: type rank, name rank, lang
+            const uint64_t idBase = result.strings.size();
+            struct Ranked
+            {
+                uint64_t type;
+                uint64_t name;
+                uint16_t lang;
+                Entry entry;
+            };
+            std::vector<Ranked> ranked;
+            ranked.reserve(_items.size());
+            size_t index = 0;
+            for (auto const& [key, item] : _items)
+            {
+                auto const& [typeString, nameString] = itemStrings[index++];
+                ranked.push_back({
+                    typeString == NoString ? idBase + key.type.id : occurrenceRank[typeString],
+                    nameString == NoString ? idBase + key.name.id : occurrenceRank[nameString],
+                    key.lang,
+                    { &key, &item } });
+            }
+            const auto bits = BitWidth(idBase + 0xFFFF);
+            RadixSort(ranked, [](Ranked const& r) { return uint64_t{ r.lang }; }, 16);
+            RadixSort(ranked, [](Ranked const& r) { return r.name; }, bits);
+            RadixSort(ranked, [](Ranked const& r) { return r.type; }, bits);
+
+            result.entries.reserve(ranked.size());
+            result.typeRanks.reserve(ranked.size());
+            result.nameRanks.reserve(ranked.size());
+            for (auto const& r : ranked)
+            {
+                result.entries.push_back(r.entry);
+                result.typeRanks.push_back(static_cast<uint32_t>(r.type));
+                result.nameRanks.push_back(static_cast<uint32_t>(r.name));
+            }
+            return result;
+        }
+
+        // The order the data is placed in: directory order, or for locality
+        // the startup resources, the other small ones and then the large ones.
+        static std::vector<size_t> DataOrder(std::vector<Entry> const& entries, SectionLayout const& layout)
+        {
+            std::vector<size_t> order(entries.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            if (!layout.locality) return order;
+            auto group = [&](size_t i)
+            {
+                if (SectionLayout::IsStartupType(entries[i].key->type)) return 0;
+                return entries[i].item->data.size() < layout.alignFrom ? 1 : 2;
+            };
+            std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return group(lhs) < group(rhs); });
+            return order;
+        }
+
+        static unsigned BitWidth(uint64_t value) noexcept
+        {
+            unsigned bits = 0;
+            while (value >> bits) ++bits;
+            return bits;
+        }
+
+        // Stable LSD radix sort by the low `bits` bits of key(item), 11 bits
+        // per pass. Passes over a digit that is the same for all are skipped.
+        template<typename T, typename K>
+        static void RadixSort(std::vector<T>& items, K key, unsigned bits)
+        {
+            constexpr unsigned DigitBits = 11;
+            constexpr size_t Buckets = size_t{ 1 } << DigitBits;
+            if (items.size() < 2) return;
+            std::vector<T> buffer(items.size());
+            std::vector<size_t> counts(Buckets + 1);
+            for (unsigned shift = 0; shift < bits; shift += DigitBits)
+            {
+                std::fill(counts.begin(), counts.end(), 0);
+                for (auto const& item : items) ++counts[((key(item) >> shift) & (Buckets - 1)) + 1];
+                if (std::find(counts.begin(), counts.end(), items.size()) != counts.end()) continue;
+                for (size_t b = 1; b <= Buckets; ++b) counts[b] += counts[b - 1];
+                for (auto& item : items) buffer[counts[(key(item) >> shift) & (Buckets - 1)]++] = std::move(item);
+                items.swap(buffer);
+            }
+        }
+
+        // Returns the string indices ordered by UTF-16 code units (ordinal).
+        // MSD radix sort: the next three code units of every string in a range
+        // are packed into one integer (unit + 1, 0 past the end), the range is
+        // radix sorted by it and runs of equal prefixes that continue are
+        // sorted by the following units. Small ranges go to std::sort.
+        static std::vector<uint32_t> SortStrings(std::vector<std::u16string_view> const& strings)
+        {
+            constexpr size_t UnitsPerKey = 3;
+            constexpr size_t SmallRange = 32;
+            struct Range
+            {
+                size_t first;
+                size_t count;
+                size_t depth;   // code units already equal within the range
+            };
+            struct Prefix
+            {
+                uint64_t key;
+                uint32_t index;
+            };
+
+            std::vector<uint32_t> order(strings.size());
+            for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::vector<Prefix> prefixes;
+            std::vector<Range> work{ { 0, order.size(), 0 } };
+            while (!work.empty())
+            {
+                const auto range = work.back();
+                work.pop_back();
+                const auto first = order.begin() + static_cast<std::ptrdiff_t>(range.first);
+                if (range.count <= SmallRange)
+                {
+                    std::sort(first, first + static_cast<std::ptrdiff_t>(range.count), [&](uint32_t a, uint32_t b)
+                    {
+                        return strings[a].substr(std::min(range.depth, strings[a].size())) < strings[b].substr(std::min(range.depth, strings[b].size()));
+                    });
+                    continue;
+                }
+
+                prefixes.resize(range.count);
+                for (size_t i = 0; i < range.count; ++i)
+                {
+                    auto const& string = strings[first[i]];
+                    uint64_t key = 0;
+                    for (size_t unit = range.depth; unit < range.depth + UnitsPerKey; ++unit)
+                    {
+                        key = key << 17 | (unit < string.size() ? uint64_t{ string[unit] } + 1 : 0);
+                    }
+                    prefixes[i] = { key, first[i] };
+                }
+                RadixSort(prefixes, [](Prefix const& p) { return p.key; }, 17 * UnitsPerKey);
+
+                for (size_t i = 0, run = 0; i <= range.count; ++i)
+                {
+                    if (i < range.count)
+                    {
+                        first[i] = prefixes[i].index;
+                        if (prefixes[i].key == prefixes[run].key) continue;
+                    }
+                    // equal prefix that doesn't end within it: compare the next units
+                    if (i - run > 1 && (prefixes[run].key & 0x1FFFF) != 0) work.push_back({ range.first + run, i - run, range.depth + UnitsPerKey });
+                    run = i;
+                }
+            }
+            return order;
+        }
+
+        // a directory table counts its named and its id entries in 16 bits each
+        static void CheckEntryCount(size_t count)
+        {
+            if (count > 0xFFFF) throw UpdateResourceException("Too many entries in one resource directory: " + std::to_string(count));
+        }
+
+        static uint32_t CheckOffset(uint64_t offset)
+        {
+            if (offset > 0xFFFFFFFFull) throw UpdateResourceException("Resource section exceeds 4 GB");
+            return static_cast<uint32_t>(offset);
+        }
+
+        std::unordered_map<Key, Item, KeyHash> _items;
+    };
+
+    // The changes to a file when its resource section is replaced. Only the
+    // headers and the file from tailOffset on are affected: if the resource
+    // section is the last section it is rebuilt (grown or shrunk) in place;
+    // a section further in front is rewritten in place if the new resources
+    // fit into it, otherwise a new .rsrc section is appended and the old one
+    // keeps its addresses but no file data. The raw data given back moves
+    // the sections behind it down (their RVAs stay), unless debug data is
+    // addressed by file offset there. Overlay data (anything behind the last
+    // section) moves behind the new section data.
+    struct ResourceSectionUpdate
+    {
+        std::vector<unsigned char> headers;     // patched copy of the first SizeOfHeaders bytes
+        size_t tailOffset{ 0 };                 // everything before is kept, except for the headers
+        std::vector<unsigned char> section;     // written at tailOffset: the sections behind an abandoned one, alignment padding and resource data
+        size_t overlayOffset{ 0 };              // where the data moved as a whole behind section is now: the overlay, behind a reused section also the sections in between
+        size_t overlaySize{ 0 };
+        size_t removedCertificateOffset{ 0 };   // certificate table cut off from the overlay end
+        size_t removedCertificateSize{ 0 };
+
+        size_t NewOverlayOffset() const noexcept { return tailOffset + section.size(); }
+        size_t NewSize() const noexcept { return NewOverlayOffset() + overlaySize; }
+    };
+
+    // True if the raw data behind the section can move towards the start of
+    // the file: it doesn't overlap with other sections and no debug data is
+    // addressed by its file offset at or behind it.
+    static bool CanMoveDataBehind(Pe::Image const& image, Pe::Section const& section)
+    {
+        const size_t start = section.pointerToRawData;
+        const size_t end = start + section.sizeOfRawData;
+        for (auto const& other : image.Sections())
+        {
+            if (&other == &section || !other.sizeOfRawData) continue;
+            if (other.pointerToRawData < end && size_t{ other.pointerToRawData } + other.sizeOfRawData > start) return false;
+        }
+
+        const auto debug = image.GetDataDirectory(Pe::DebugDirectory);
+        if (!debug.virtualAddress || !debug.size) return true;
+        const auto directory = image.RvaToOffset(debug.virtualAddress, debug.size);
+        if (!directory) return false;
+        constexpr size_t DebugEntrySize = 28;
+        for (size_t entry = *directory; entry + DebugEntrySize <= *directory + debug.size; entry += DebugEntrySize)
+        {
+            const auto pointerToRawData = Pe::Read<uint32_t>(image.Data(), entry + 24);
+            if (pointerToRawData >= start) return false;
+        }
+        return true;
+    }
+
+    // Plans the replacement of the resources by the given table. With
+    // stripCertificate the security directory is cleared as well and a
+    // certificate table at the end of the file dropped. With a locality
+    // layout, a section that is appended or rebuilt at the end of the file
+    // starts on a page boundary, so that the page aligned RVAs of large
+    // resources are page aligned file offsets as well.
+    static ResourceSectionUpdate PlanResourceSection(Pe::Bytes file, ResourceTable const& table, bool stripCertificate = false, SectionLayout const& layout = {})
+    {
+        const Pe::Image image(file);
+        if (image.NumberOfDataDirectories() <= Pe::ResourceDirectory) throw InvalidFileException("Image has no resource data directory");
+
+        auto const& sections = image.Sections();
+        const auto oldDir = image.GetDataDirectory(Pe::ResourceDirectory);
+        const auto oldEnd = std::min<size_t>(std::max<size_t>(image.EndOfSectionData(), image.SizeOfHeaders()), file.size());
+
+        uint32_t endOfImage = image.SizeOfHeaders();    // the headers are mapped at RVA 0
+        for (auto const& section : sections)
+        {
+            endOfImage = std::max(endOfImage, section.virtualAddress + std::max(section.virtualSize, section.sizeOfRawData));
+        }
+
+        const Pe::Section* rsrc = oldDir.virtualAddress ? image.FindSection(oldDir.virtualAddress) : nullptr;
+        const bool atSectionStart = rsrc
+            && rsrc->virtualAddress == oldDir.virtualAddress
+            && size_t{ rsrc->pointerToRawData } + rsrc->sizeOfRawData <= oldEnd;
+        const bool inPlace = atSectionStart
+            && rsrc->virtualAddress + std::max(rsrc->virtualSize, rsrc->sizeOfRawData) == endOfImage
+            && size_t{ rsrc->pointerToRawData } + rsrc->sizeOfRawData == oldEnd;
+
+        // a power of two up to 64 KiB per the PE format; anything else would pad the section absurdly
+        const auto fileAlignment = image.FileAlignment();
+        if (fileAlignment > 0x10000 || (fileAlignment & (fileAlignment - 1)) != 0) throw InvalidFileException("Invalid file alignment");
+
+        // A section in the middle of the image is reused if the new table
+        // fits into its raw data and its address range; the sections behind
+        // it stay where they are. Otherwise a new section is appended.
+        const auto appendedRva = Pe::AlignUp(endOfImage, image.SectionAlignment());
+        auto data = table.Build(atSectionStart ? rsrc->virtualAddress : appendedRva, layout);
+        bool inSlot = false;
+        if (atSectionStart && !inPlace)
+        {
+            uint64_t slot = rsrc->sizeOfRawData;
+            for (auto const& section : sections)
+            {
+                if (section.virtualAddress > rsrc->virtualAddress) slot = std::min<uint64_t>(slot, section.virtualAddress - rsrc->virtualAddress);
+            }
+            inSlot = data.size() <= slot;
+            if (!inSlot) ResourceTable::Rebase(data, appendedRva - rsrc->virtualAddress);
+        }
+
+        const auto rawAlignment = layout.locality ? std::max(fileAlignment, layout.pageSize) : fileAlignment;
+        const auto rawSize = Pe::AlignUp(static_cast<uint32_t>(data.size()), fileAlignment);
+
+        // raw data of a section in front given back: everything behind it moves down by that
+        uint32_t released = 0;
+        if (atSectionStart && !inPlace && rsrc->sizeOfRawData >= (inSlot ? rawSize : 0) && CanMoveDataBehind(image, *rsrc))
+        {
+            released = rsrc->sizeOfRawData - (inSlot ? rawSize : 0);
+            if (released % fileAlignment) released = 0;
+        }
+        const size_t rsrcEnd = atSectionStart ? size_t{ rsrc->pointerToRawData } + rsrc->sizeOfRawData : oldEnd;
+
+        size_t headerOffset = 0;
+        uint32_t rva = 0;
+        uint32_t rawPointer = 0;
+        uint32_t oldRawSize = 0;
+        if (inPlace || inSlot)
+        {
+            headerOffset = rsrc->headerOffset;
+            rva = rsrc->virtualAddress;
+            rawPointer = inPlace ? Pe::AlignUp(rsrc->pointerToRawData, rawAlignment) : rsrc->pointerToRawData;
+            oldRawSize = rsrc->sizeOfRawData;
+        }
+        else
+        {
+            // the new section header has to fit between the section table and the first section
+            headerOffset = image.SectionTableOffset() + sections.size() * Pe::SectionHeaderSize;
+            size_t firstRawData = image.SizeOfHeaders();
+            for (auto const& section : sections)
+            {
+                if (section.sizeOfRawData) firstRawData = std::min<size_t>(firstRawData, section.pointerToRawData);
+            }
+            if (headerOffset + Pe::SectionHeaderSize > firstRawData
+                || std::any_of(file.begin() + headerOffset, file.begin() + headerOffset + Pe::SectionHeaderSize, [](unsigned char b) { return b != 0; }))
+            {
+                throw InvalidFileException("No room for another section header");
+            }
+            rva = appendedRva;
+            rawPointer = Pe::AlignUp(static_cast<uint32_t>(oldEnd - released), rawAlignment);
+            if (released) oldRawSize = rsrc->sizeOfRawData;
+        }
+
+        // A reused section is followed by the unchanged sections behind it,
+        // which only move if it shrinks; they are moved like an overlay. The
+        // ones behind an abandoned section are written in front of the new one.
+        ResourceSectionUpdate update;
+        update.tailOffset = inPlace || inSlot || released ? rsrc->pointerToRawData : oldEnd;
+        update.overlayOffset = inSlot ? rsrcEnd : oldEnd;
+        update.overlaySize = file.size() - update.overlayOffset;
+
+        const auto sectionSize = inSlot && !released ? oldRawSize : rawSize;
+        if (!inSlot && released) update.section.assign(file.begin() + rsrcEnd, file.begin() + oldEnd);
+        update.section.resize(rawPointer - update.tailOffset, 0);
+        update.section.insert(update.section.end(), data.begin(), data.end());
+        update.section.resize(size_t{ rawPointer } + sectionSize - update.tailOffset, 0);
+
+        // new file offset of what was at offset before
+        auto moved = [&](size_t offset)
+        {
+            if (offset < rsrcEnd) return offset;
+            if (offset < update.overlayOffset) return offset - released;
+            return offset - update.overlayOffset + update.NewOverlayOffset();
+        };
+
+        const size_t headersSize = std::min<size_t>(image.SizeOfHeaders(), update.tailOffset);
+        if (headerOffset + Pe::SectionHeaderSize > headersSize) throw InvalidFileException("Section table is not within the headers");
+        update.headers.assign(file.begin(), file.begin() + headersSize);
+
+        Pe::MutableBytes out(update.headers);
+        if (!inPlace && !inSlot)
+        {
+            Pe::Write<uint16_t>(out, image.NumberOfSectionsOffset(), static_cast<uint16_t>(sections.size() + 1));
+            const char name[8] = { '.', 'r', 's', 'r', 'c', 0, 0, 0 };
+            std::copy(name, name + 8, update.headers.begin() + headerOffset);
+            Pe::Write<uint32_t>(out, headerOffset + 36, 0x40000040);  // initialized data, readable
+        }
+        // a reused section keeps its address range, the sections behind it have fixed RVAs
+        const auto oldVirtualSize = atSectionStart ? (rsrc->virtualSize ? rsrc->virtualSize : rsrc->sizeOfRawData) : 0;
+        Pe::Write<uint32_t>(out, headerOffset + 8, inSlot ? std::max(static_cast<uint32_t>(data.size()), oldVirtualSize) : static_cast<uint32_t>(data.size()));
+        Pe::Write<uint32_t>(out, headerOffset + 12, rva);
+        Pe::Write<uint32_t>(out, headerOffset + 16, sectionSize);
+        Pe::Write<uint32_t>(out, headerOffset + 20, rawPointer);
+        if (released)
+        {
+            if (!inSlot)
+            {
+                // the abandoned section stays as zero filled address range
+                Pe::Write<uint32_t>(out, rsrc->headerOffset + 8, oldVirtualSize);
+                Pe::Write<uint32_t>(out, rsrc->headerOffset + 16, 0);
+                Pe::Write<uint32_t>(out, rsrc->headerOffset + 20, 0);
+            }
+            for (auto const& section : sections)
+            {
+                if (section.sizeOfRawData && section.pointerToRawData >= rsrcEnd) Pe::Write<uint32_t>(out, section.headerOffset + 20, static_cast<uint32_t>(moved(section.pointerToRawData)));
+            }
+        }
+        const auto symbolTableOffset = image.NtHeaderOffset() + 12;
+        const auto symbolTable = Pe::Read<uint32_t>(file, symbolTableOffset);
+        if (symbolTable >= rsrcEnd) Pe::Write<uint32_t>(out, symbolTableOffset, static_cast<uint32_t>(moved(symbolTable)));
+
+        const auto dirOffset = image.DataDirectoryOffset(Pe::ResourceDirectory);
+        Pe::Write<uint32_t>(out, dirOffset, rva);
+        Pe::Write<uint32_t>(out, dirOffset + 4, static_cast<uint32_t>(data.size()));
+
+        const auto sizeOfImage = Pe::AlignUp(rva + static_cast<uint32_t>(data.size()), image.SectionAlignment());
+        Pe::Write<uint32_t>(out, image.SizeOfImageOffset(), inPlace ? sizeOfImage : std::max(sizeOfImage, image.SizeOfImage()));
+        const auto initializedData = Pe::Read<uint32_t>(file, image.SizeOfInitializedDataOffset());
+        Pe::Write<uint32_t>(out, image.SizeOfInitializedDataOffset(), initializedData - oldRawSize + sectionSize);
+
+        // the certificate table is addressed by file offset and moves with the overlay
+        if (image.NumberOfDataDirectories() > Pe::SecurityDirectory)
+        {
+            const auto securityOffset = image.DataDirectoryOffset(Pe::SecurityDirectory);
+            const auto security = image.GetDataDirectory(Pe::SecurityDirectory);
+            if (stripCertificate)
+            {
+                Pe::Write<uint32_t>(out, securityOffset, 0);
+                Pe::Write<uint32_t>(out, securityOffset + 4, 0);
+                if (security.size && security.virtualAddress >= oldEnd && size_t{ security.virtualAddress } + security.size >= file.size())
+                {
+                    update.removedCertificateOffset = security.virtualAddress;
+                    update.removedCertificateSize = file.size() - security.virtualAddress;
+                    update.overlaySize = security.virtualAddress - update.overlayOffset;
+                }
+            }
+            else if (security.virtualAddress >= oldEnd && security.size)
+            {
+                Pe::Write<uint32_t>(out, securityOffset, static_cast<uint32_t>(moved(security.virtualAddress)));
+            }
+        }
+        return update;
+    }
+
+    // Returns a copy of the image with its resources replaced by the given table.
+    static std::vector<unsigned char> ReplaceResourceSection(Pe::Bytes file, ResourceTable const& table, SectionLayout const& layout = {})
+    {
+        const auto update = PlanResourceSection(file, table, false, layout);
+        std::vector<unsigned char> result;
+        result.reserve(update.NewSize());
+        result.assign(update.headers.begin(), update.headers.end());
+        result.insert(result.end(), file.begin() + update.headers.size(), file.begin() + update.tailOffset);
+        result.insert(result.end(), update.section.begin(), update.section.end());
+        result.insert(result.end(), file.begin() + update.overlayOffset, file.begin() + update.overlayOffset + update.overlaySize);
+        return result;
+    }
+
+    struct ImageOptions
+    {
+        uint16_t machine{ Pe::MachineAmd64 };   // I386 gives a PE32 image, AMD64 and ARM64 PE32+
+        uint32_t timeDateStamp{ 0 };            // 0 keeps the output reproducible
+        SectionLayout layout;
+    };
+
+    // Creates a resource-only DLL (like link /NOENTRY /DLL of a .res file):
+    // headers and a single .rsrc section with the resources of the table,
+    // checksum set. No template image or toolchain needed.
+    static std::vector<unsigned char> CreateResourceImage(ResourceTable const& table, ImageOptions const& options = {})
+    {
+        if (options.machine != Pe::MachineI386 && options.machine != Pe::MachineAmd64 && options.machine != Pe::MachineArm64)
+        {
+            throw InvalidArgsException();
+        }
+        const bool pe32Plus = options.machine != Pe::MachineI386;
+        constexpr size_t ntHeader = 0x40;      // no DOS stub
+        constexpr uint32_t sectionAlignment = 0x1000;
+        constexpr uint32_t fileAlignment = 0x200;
+        const uint16_t optionalHeaderSize = pe32Plus ? 240 : 224;
+        const size_t optionalHeader = ntHeader + 24;
+
+        // headers without sections, ReplaceResourceSection adds .rsrc
+        std::vector<unsigned char> headers(fileAlignment);
+        Pe::Write<uint16_t>(headers, 0, Pe::DosSignature);
+        Pe::Write<uint32_t>(headers, 0x3C, static_cast<uint32_t>(ntHeader));
+        Pe::Write<uint32_t>(headers, ntHeader, Pe::NtSignature);
+        Pe::Write<uint16_t>(headers, ntHeader + 4, options.machine);
+        Pe::Write<uint32_t>(headers, ntHeader + 8, options.timeDateStamp);
+        Pe::Write<uint16_t>(headers, ntHeader + 20, optionalHeaderSize);
+        // executable, DLL and either 32 bit machine or large address aware
+        Pe::Write<uint16_t>(headers, ntHeader + 22, pe32Plus ? 0x2022 : 0x2102);
+
+        Pe::Write<uint16_t>(headers, optionalHeader, pe32Plus ? Pe::Pe32PlusMagic : Pe::Pe32Magic);
+        headers[optionalHeader + 2] = 14;       // linker version
+        Pe::Write<uint32_t>(headers, optionalHeader + 20, sectionAlignment);       // BaseOfCode
+        if (pe32Plus)
+        {
+            Pe::Write<uint64_t>(headers, optionalHeader + 24, 0x180000000ull);     // ImageBase
+        }
+        else
+        {
+            Pe::Write<uint32_t>(headers, optionalHeader + 24, sectionAlignment);   // BaseOfData
+            Pe::Write<uint32_t>(headers, optionalHeader + 28, 0x10000000);         // ImageBase
+        }
+        Pe::Write<uint32_t>(headers, optionalHeader + 32, sectionAlignment);
+        Pe::Write<uint32_t>(headers, optionalHeader + 36, fileAlignment);
+        Pe::Write<uint16_t>(headers, optionalHeader + 40, 6);                      // OS version 6.0
+        Pe::Write<uint16_t>(headers, optionalHeader + 48, 6);                      // subsystem version 6.0
+        Pe::Write<uint32_t>(headers, optionalHeader + 56, sectionAlignment);       // SizeOfImage, headers only
+        Pe::Write<uint32_t>(headers, optionalHeader + 60, fileAlignment);          // SizeOfHeaders
+        Pe::Write<uint16_t>(headers, optionalHeader + 68, 2);                      // Windows GUI
+        Pe::Write<uint16_t>(headers, optionalHeader + 70, pe32Plus ? 0x0160 : 0x0140);    // (high entropy VA,) dynamic base, NX
+        const size_t stackAndHeap = optionalHeader + 72;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            const uint64_t value = i % 2 ? 0x1000 : 0x100000;   // reserve, commit
+            if (pe32Plus) Pe::Write<uint64_t>(headers, stackAndHeap + 8 * i, value);
+            else Pe::Write<uint32_t>(headers, stackAndHeap + 4 * i, static_cast<uint32_t>(value));
+        }
+        Pe::Write<uint32_t>(headers, optionalHeader + (pe32Plus ? 108 : 92), 16);  // NumberOfRvaAndSizes
+
+        auto image = ReplaceResourceSection(headers, table, options.layout);
+        Checksum::Update(image);
+        return image;
+    }
+
+    // Checksum of the file after the update, derived from the stored one and
+    // the changed ranges only. nullopt if that isn't possible.
+    static std::optional<uint32_t> UpdatedChecksum(Pe::Bytes file, ResourceSectionUpdate const& update)
+    {
+        const Pe::Image image(file);
+        const auto offset = image.CheckSumOffset();
+        // the moved overlay keeps its sum only if it moved by an even number of bytes
+        if (offset + 4 > update.headers.size() || (update.NewOverlayOffset() - update.overlayOffset) % 2) return std::nullopt;
+
+        const Pe::Bytes headers(update.headers);
+        std::vector<Checksum::Change> changes{
+            { 0, file.first(offset), headers.first(offset) },
+            { offset + 4, file.subspan(offset + 4, headers.size() - offset - 4), headers.subspan(offset + 4) },
+            { update.tailOffset, file.subspan(update.tailOffset, update.overlayOffset - update.tailOffset), update.section },
+        };
+        if (update.removedCertificateSize)
+        {
+            changes.push_back({ update.removedCertificateOffset, file.subspan(update.removedCertificateOffset, update.removedCertificateSize), {} });
+        }
+        return Checksum::Update(image.CheckSum(), file.size(), update.NewSize(), offset, changes);
+    }
+
+    // Resource update without the Windows API: loads the resources of the
+    // file, applies Set/Remove in memory and on Commit writes the updated
+    // file next to the original and renames it over it (PendingFile), so an
+    // interrupted commit never leaves a damaged file. Where the temporary can
+    // be a reflink clone only the headers and the file from the resource
+    // section on are written, and unless .rsrc has to move behind the last
+    // section the cost of an update depends on the size of the resources (and
+    // of an overlay), not on the size of the image.
+    class NativeUpdateSession
+    {
+    public:
+        explicit NativeUpdateSession(const char* fileName, CommitOptions const& options = {})
+            : _fileName{ fileName ? fileName : "" }
+            , _options{ options }
+        {
+            if (!fileName) throw ArgumentNullException();
+            MappedFile file(fileName);
+            const Pe::Image image(file.Data());
+            _stripCertificate = CheckSignature(image, _fileName, _options.signature);
+            _table = ResourceTable(ResourceDirectory(image));
+        }
+
+        NativeUpdateSession(const NativeUpdateSession&) = delete;
+        NativeUpdateSession& operator=(const NativeUpdateSession&) = delete;
+
+        void Set(ResId const& type, ResId const& name, uint16_t lang, const void* data, uint32_t size)
+        {
+            if (!data || size == 0)
+            {
+                Remove(type, name, lang);
+                return;
+            }
+            _table.Set(type, name, lang, Pe::Bytes(static_cast<const unsigned char*>(data), size));
+        }
+
+        void Remove(ResId const& type, ResId const& name, uint16_t lang)
+        {
+            _table.Remove(type, name, lang);
+        }
+
+        // removes all resources the selector matches and returns their number
+        size_t Remove(ResourceSelector const& selector)
+        {
+            return _table.RemoveIf([&](ResourceTable::Key const& key, ResourceTable::Item const& item)
+            {
+                return selector.MatchesType(key.type) && selector.MatchesName(key.name) && selector.MatchesLang(key.lang) && selector.MatchesSize(item.data.size());
+            });
+        }
+
+        ResourceTable const& Table() const noexcept { return _table; }
+
+        // Writes the updated file next to the original (see PendingFile) and
+        // returns it without flushing or renaming it, for a SyncBatch.
+        PendingFile Prepare()
+        {
+            ResourceSectionUpdate update;
+            std::optional<uint32_t> checksum;
+            PendingFile pending(_fileName);
+            {
+                MappedFile file(_fileName.c_str());
+                update = PlanResourceSection(file.Data(), _table, _stripCertificate, _options.layout);
+                if (_options.updateChecksum)
+                {
+                    checksum = UpdatedChecksum(file.Data(), update);
+                    if (checksum) Pe::Write<uint32_t>(update.headers, Pe::Image(file.Data()).CheckSumOffset(), *checksum);
+                }
+                if (pending.Cloned()) WriteInPlace(pending.TempName(), update);
+                else WriteCopy(pending.TempName(), file.Data(), update);
+            }
+            if (_options.updateChecksum && !checksum) Checksum::Update(pending.TempName().c_str());
+            return pending;
+        }
+
+        // Replaces the file by the updated one, durably.
+        void Commit()
+        {
+            Prepare().Commit();
+        }
+
+    private:
+        // applies the update to a copy of the file: only the headers and the
+        // tail are written
+        void WriteInPlace(std::string const& fileName, ResourceSectionUpdate const& update) const
+        {
+            const auto path = PendingFile::ToPath(fileName);
+            {
+                std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+                if (!file) throw FileAccessException("Opening file '" + fileName + "' for writing failed");
+
+                // the overlay first: it may be in the way of the new section data
+                if (update.overlaySize && update.NewOverlayOffset() != update.overlayOffset)
+                {
+                    MoveRange(file, update.overlayOffset, update.NewOverlayOffset(), update.overlaySize);
+                }
+                file.seekp(static_cast<std::streamoff>(update.tailOffset));
+                file.write(reinterpret_cast<const char*>(update.section.data()), static_cast<std::streamsize>(update.section.size()));
+                file.seekp(0);
+                file.write(reinterpret_cast<const char*>(update.headers.data()), static_cast<std::streamsize>(update.headers.size()));
+                file.close();
+                if (!file) throw UpdateResourceException("Resource update of file '" + _fileName + "' could not be written");
+            }
+            if (std::filesystem::file_size(path) > update.NewSize()) std::filesystem::resize_file(path, update.NewSize());
+        }
+
+        // writes the whole updated file from the mapped original
+        void WriteCopy(std::string const& fileName, Pe::Bytes original, ResourceSectionUpdate const& update) const
+        {
+            std::ofstream file(PendingFile::ToPath(fileName), std::ios::binary | std::ios::trunc);
+            if (!file) throw FileAccessException("Opening file '" + fileName + "' for writing failed");
+            auto write = [&](Pe::Bytes data) { file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())); };
+            write(update.headers);
+            write(original.subspan(update.headers.size(), update.tailOffset - update.headers.size()));
+            write(update.section);
+            write(original.subspan(update.overlayOffset, update.overlaySize));
+            file.close();
+            if (!file) throw UpdateResourceException("Resource update of file '" + _fileName + "' could not be written");
+        }
+
+        // memmove within the file, in chunks
+        static void MoveRange(std::fstream& file, size_t from, size_t to, size_t size)
+        {
+            std::vector<char> buffer(std::min<size_t>(size, size_t{ 1 } << 20));
+            for (size_t done = 0; done < size;)
+            {
+                const auto chunk = std::min(buffer.size(), size - done);
+                const auto pos = to > from ? size - done - chunk : done;    // back to front when moving up
+                file.seekg(static_cast<std::streamoff>(from + pos));
+                file.read(buffer.data(), static_cast<std::streamsize>(chunk));
+                file.seekp(static_cast<std::streamoff>(to + pos));
+                file.write(buffer.data(), static_cast<std::streamsize>(chunk));
+                done += chunk;
+            }
+        }
+
+        std::string _fileName;
+        CommitOptions _options;
+        bool _stripCertificate{ false };
+        ResourceTable _table;
+    };
+
+    // Removes all resources the selector matches with a single rebuild of the
+    // resource section and returns their number. The file is only rewritten
+    // if there are any.
+    static size_t RemoveResources(const char* fileName, ResourceSelector const& selector, CommitOptions const& options = {})
+    {
+        NativeUpdateSession session(fileName, options);
+        const auto removed = session.Remove(selector);
+        if (removed) session.Commit();
+        return removed;
+    }
+
+#ifndef _WIN32
+    // without BeginUpdateResource/EndUpdateResource all updates go through the native writer
+    using UpdateSession = NativeUpdateSession;
+#endif
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+#include "PeImage.hpp"
+#include "../Utf8.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ResLib
+{
+    // Parser and serializer for VS_VERSIONINFO (RT_VERSION) resources.
+    namespace VersionInfo
+    {
+        static constexpr uint32_t FixedFileInfoSignature = 0xFEEF04BD;
+        static constexpr size_t FixedFileInfoSize = 13 * sizeof(uint32_t);
+        static constexpr uint16_t BinaryType = 0;
+        static constexpr uint16_t TextType = 1;
+
+        static constexpr const char16_t* RootKey = u"VS_VERSION_INFO";
+        static constexpr const char16_t* StringFileInfoKey = u"StringFileInfo";
+        static constexpr const char16_t* DefaultStringTableKey = u"040904B0";
+
+        // indices of the version DWORDs inside VS_FIXEDFILEINFO
+        static constexpr size_t FileVersionIndex = 2;
+        static constexpr size_t ProductVersionIndex = 4;
+
+        using Version = std::array<uint16_t, 4>;
+
+        // One block of the version resource (VS_VERSIONINFO, StringFileInfo,
+        // StringTable, String, VarFileInfo or Var).
+        struct Node
+        {
+            std::u16string key;
+            uint16_t type{ BinaryType };
+            std::vector<unsigned char> value;   // text values include the terminating null
+            std::vector<Node> children;
+
+            // location inside the parsed resource, used for in-place patching
+            size_t offset{ 0 };
+            size_t length{ 0 };
+            size_t valueOffset{ 0 };
+
+            Node* FindChild(std::u16string const& childKey)
+            {
+                for (auto& child : children)
+                {
+                    if (child.key == childKey) return &child;
+                }
+                return nullptr;
+            }
+        };
+
+        struct Update
+        {
+            std::optional<Version> fileVersion;
+            std::optional<Version> productVersion;
+            std::vector<std::pair<std::string, std::string>> strings;   // StringFileInfo key/value pairs
+
+            bool Empty() const noexcept { return !fileVersion && !productVersion && strings.empty(); }
+        };
+
+        enum class Result { PatchedInPlace, Rewritten };
+
+        namespace _internal
+        {
+            static constexpr size_t Align4(size_t value) noexcept { return (value + 3) & ~size_t{ 3 }; }
+
+            static Node ParseNode(Pe::Bytes data, size_t offset, size_t end)
+            {
+                Node node;
+                node.offset = offset;
+                node.length = Pe::Read<uint16_t>(data, offset);
+                const auto valueLength = Pe::Read<uint16_t>(data, offset + 2);
+                node.type = Pe::Read<uint16_t>(data, offset + 4);
+                if (node.length < 6 || offset + node.length > end)
+                {
+                    throw InvalidResourceException("Malformed version block at offset " + std::to_string(offset));
+                }
+                const auto nodeEnd = offset + node.length;
+
+                size_t pos = offset + 6;
+                for (char16_t c = Pe::Read<char16_t>(data, pos); c != u'\0' && pos + 2 < nodeEnd; c = Pe::Read<char16_t>(data, pos))
+                {
+                    node.key.push_back(c);
+                    pos += 2;
+                }
+                pos = std::min(Align4(pos + 2), nodeEnd);
+
+                node.valueOffset = pos;
+                const size_t valueBytes = std::min<size_t>(node.type == TextType ? valueLength * size_t{ 2 } : valueLength, nodeEnd - pos);
+                node.value.assign(data.begin() + pos, data.begin() + pos + valueBytes);
+                pos = Align4(pos + valueBytes);
+
+                // some tools leave zero padding inside a block, treat it as its end
+                while (pos + 6 <= nodeEnd && Pe::Read<uint16_t>(data, pos) != 0)
+                {
+                    auto child = ParseNode(data, pos, nodeEnd);
+                    pos = Align4(pos + child.length);
+                    node.children.emplace_back(std::move(child));
+                }
+                return node;
+            }
+
+            static void Put16(std::vector<unsigned char>& out, uint16_t value)
+            {
+                out.push_back(static_cast<unsigned char>(value));
+                out.push_back(static_cast<unsigned char>(value >> 8));
+            }
+
+            static void Pad4(std::vector<unsigned char>& out)
+            {
+                while (out.size() % 4) out.push_back(0);
+            }
+
+            static void SerializeNode(std::vector<unsigned char>& out, Node const& node)
+            {
+                Pad4(out);
+                const auto start = out.size();
+                Put16(out, 0);
+                Put16(out, static_cast<uint16_t>(node.type == TextType ? node.value.size() / 2 : node.value.size()));
+                Put16(out, node.type);
+                for (auto c : node.key) Put16(out, static_cast<uint16_t>(c));
+                Put16(out, 0);
+                Pad4(out);
+                out.insert(out.end(), node.value.begin(), node.value.end());
+                for (auto const& child : node.children) SerializeNode(out, child);
+
+                const auto length = out.size() - start;
+                if (length > 0xFFFF) throw InvalidDataException();
+                out[start] = static_cast<unsigned char>(length);
+                out[start + 1] = static_cast<unsigned char>(length >> 8);
+            }
+
+            static std::vector<unsigned char> TextValue(std::string const& utf8)
+            {
+                std::vector<unsigned char> value;
+                for (auto c : Utf8::ToUtf16(utf8)) Put16(value, static_cast<uint16_t>(c));
+                Put16(value, 0);
+                return value;
+            }
+
+            // explicitly requested strings are added if missing, implied ones
+            // (FileVersion/ProductVersion) are only updated where present
+            struct StringUpdate
+            {
+                std::u16string key;
+                std::vector<unsigned char> value;
+                bool addIfMissing;
+            };
+
+            static std::vector<StringUpdate> GetStringUpdates(Update const& update);
+
+            template<typename F>
+            static void ForEachStringTable(Node& root, F&& f)
+            {
+                for (auto& child : root.children)
+                {
+                    if (child.key != StringFileInfoKey) continue;
+                    for (auto& table : child.children) f(table);
+                }
+            }
+        }
+
+        static Node Parse(Pe::Bytes data)
+        {
+            auto root = _internal::ParseNode(data, 0, data.size());
+            if (root.key != RootKey) throw InvalidResourceException("Version resource does not start with VS_VERSION_INFO");
+            return root;
+        }
+
+        static std::vector<unsigned char> Serialize(Node const& root)
+        {
+            std::vector<unsigned char> out;
+            _internal::SerializeNode(out, root);
+            return out;
+        }
+
+        // "1.2.3.4" -> { 1, 2, 3, 4 }, missing parts are 0
+        static Version ParseVersion(std::string const& str)
+        {
+            Version version{};
+            size_t part = 0;
+            size_t pos = 0;
+            while (pos <= str.size())
+            {
+                if (part == version.size()) throw InvalidArgsException();
+                const auto next = std::min(str.find('.', pos), str.size());
+                const auto token = str.substr(pos, next - pos);
+                if (token.empty() || token.size() > 5 || token.find_first_not_of("0123456789") != std::string::npos) throw InvalidArgsException();
+                const auto value = std::stoul(token);
+                if (value > 0xFFFF) throw InvalidArgsException();
+                version[part++] = static_cast<uint16_t>(value);
+                pos = next + 1;
+            }
+            return version;
+        }
+
+        static std::string ToString(Version const& version)
+        {
+            return std::to_string(version[0]) + "." + std::to_string(version[1]) + "." + std::to_string(version[2]) + "." + std::to_string(version[3]);
+        }
+
+        static std::optional<Version> GetVersion(Node const& root, size_t index)
+        {
+            if (root.value.size() < FixedFileInfoSize) return std::nullopt;
+            const auto ms = Pe::Read<uint32_t>(root.value, index * 4);
+            const auto ls = Pe::Read<uint32_t>(root.value, (index + 1) * 4);
+            return Version{ static_cast<uint16_t>(ms >> 16), static_cast<uint16_t>(ms), static_cast<uint16_t>(ls >> 16), static_cast<uint16_t>(ls) };
+        }
+
+        static void SetVersion(Pe::MutableBytes fixedFileInfo, size_t index, Version const& version)
+        {
+            Pe::Write<uint32_t>(fixedFileInfo, index * 4, uint32_t{ version[0] } << 16 | version[1]);
+            Pe::Write<uint32_t>(fixedFileInfo, (index + 1) * 4, uint32_t{ version[2] } << 16 | version[3]);
+        }
+
+        // Applies the update to a parsed version tree; the result has to be
+        // serialized again.
+        static void Apply(Node& root, Update const& update)
+        {
+            if ((update.fileVersion || update.productVersion) && root.value.size() < FixedFileInfoSize)
+            {
+                root.value.assign(FixedFileInfoSize, 0);
+                Pe::Write<uint32_t>(root.value, 0, FixedFileInfoSignature);
+                Pe::Write<uint32_t>(root.value, 4, 0x00010000);
+            }
+            if (update.fileVersion) SetVersion(root.value, FileVersionIndex, *update.fileVersion);
+            if (update.productVersion) SetVersion(root.value, ProductVersionIndex, *update.productVersion);
+
+            const auto strings = _internal::GetStringUpdates(update);
+            if (strings.empty()) return;
+
+            auto stringFileInfo = root.FindChild(StringFileInfoKey);
+            if (!stringFileInfo)
+            {
+                // keep StringFileInfo in front of VarFileInfo, as rc.exe does
+                Node node;
+                node.key = StringFileInfoKey;
+                node.type = TextType;
+                root.children.insert(root.children.begin(), std::move(node));
+                stringFileInfo = &root.children.front();
+            }
+            if (stringFileInfo->children.empty())
+            {
+                Node table;
+                table.key = DefaultStringTableKey;
+                table.type = TextType;
+                stringFileInfo->children.emplace_back(std::move(table));
+            }
+
+            for (auto& table : stringFileInfo->children)
+            {
+                for (auto const& str : strings)
+                {
+                    if (auto node = table.FindChild(str.key))
+                    {
+                        node->value = str.value;
+                        node->type = TextType;
+                    }
+                    else if (str.addIfMissing)
+                    {
+                        Node node;
+                        node.key = str.key;
+                        node.type = TextType;
+                        node.value = str.value;
+                        table.children.emplace_back(std::move(node));
+                    }
+                }
+            }
+        }
+
+        // Patches the serialized resource directly if every change fits into the
+        // space the existing blocks already occupy. Nothing is modified otherwise.
+        static bool TryPatchInPlace(Pe::MutableBytes data, Node& root, Update const& update)
+        {
+            if ((update.fileVersion || update.productVersion)
+                && (root.value.size() < FixedFileInfoSize || Pe::Read<uint32_t>(root.value, 0) != FixedFileInfoSignature))
+            {
+                return false;
+            }
+
+            struct Patch { Node const* node; std::vector<unsigned char> const* value; };
+            std::vector<Patch> patches;
+            bool fits = true;
+            const auto strings = _internal::GetStringUpdates(update);
+            for (auto const& str : strings)
+            {
+                bool found = false;
+                _internal::ForEachStringTable(root, [&](Node& table)
+                {
+                    auto node = table.FindChild(str.key);
+                    if (!node) return;
+                    found = true;
+                    fits = fits && node->value.size() >= str.value.size();
+                    patches.push_back({ node, &str.value });
+                });
+                fits = fits && (found || !str.addIfMissing);
+                if (!fits) return false;
+            }
+
+            auto fixedFileInfo = data.subspan(root.valueOffset, root.value.size());
+            if (update.fileVersion) SetVersion(fixedFileInfo, FileVersionIndex, *update.fileVersion);
+            if (update.productVersion) SetVersion(fixedFileInfo, ProductVersionIndex, *update.productVersion);
+
+            for (auto const& patch : patches)
+            {
+                // Shorter values are null padded. wLength and wValueLength are left
+                // alone so the layout of the block stays exactly the same.
+                const auto value = data.subspan(patch.node->valueOffset, patch.node->value.size());
+                std::fill(std::copy(patch.value->begin(), patch.value->end(), value.begin()), value.end(), static_cast<unsigned char>(0));
+            }
+            return true;
+        }
+
+        std::vector<_internal::StringUpdate> _internal::GetStringUpdates(Update const& update)
+        {
+            std::vector<StringUpdate> result;
+            for (auto const& str : update.strings)
+            {
+                result.push_back({ Utf8::ToUtf16(str.first), TextValue(str.second), true });
+            }
+
+            auto addImplied = [&](const char16_t* key, std::optional<Version> const& version)
+            {
+                if (!version) return;
+                for (auto const& str : result) if (str.key == key) return;
+                result.push_back({ key, TextValue(ToString(*version)), false });
+            };
+            addImplied(u"FileVersion", update.fileVersion);
+            addImplied(u"ProductVersion", update.productVersion);
+            return result;
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// Applies a resource patch bundle (ResLib/ResPatch.hpp) to many files. The
+// bundle is mapped and its payloads are decoded once; every target is then
+// checked against the preconditions in place and, if it is the expected
+// old build, updated with one rebuild of its resource section. Like
+// ResRemove, up to `threads` targets are prepared at the same time and the
+// updated copies are renamed over the targets in batches of `batchSize`
+// with one SyncBatch. Targets that don't match are left untouched.
+//
+// Output, one line per file, in input order:
+//   file: N op(s) applied, <old size> -> <new size> bytes
+//   file: already patched
+//   file: rejected: <resource> exists|is missing|has different content   (on err)
+
+#include "BatchCommit.hpp"
+#include "ResLib/ResLib.hpp"
+#include "ResUtil.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResPatcher
+{
+public:
+	struct Options
+	{
+		size_t threads{ 0 };        // 0: one per core
+		size_t batchSize{ 256 };    // files per sync batch
+		ResLib::CommitOptions commit;
+	};
+
+	struct Result
+	{
+		size_t files{ 0 };
+		size_t patched{ 0 };
+		size_t upToDate{ 0 };
+		size_t rejected{ 0 };       // not the build the bundle was made for
+		size_t errors{ 0 };
+	};
+
+	ResPatcher(const char* bundleFile, Options const& options)
+		: _file{ bundleFile }
+		, _bundle{ _file.Data() }
+		, _data{ ResLib::ResPatch::DecodeAll(_bundle) }
+		, _options{ options }
+	{
+		if (!_options.threads) _options.threads = std::max(1u, std::thread::hardware_concurrency());
+		if (!_options.batchSize) _options.batchSize = 1;
+	}
+
+	ResPatcher(const ResPatcher&) = delete;
+	ResPatcher& operator=(const ResPatcher&) = delete;
+
+	ResLib::ResPatch::Bundle const& Bundle() const noexcept { return _bundle; }
+
+	// A file listed more than once is patched once.
+	Result Run(std::vector<std::string> const& files, std::ostream& out, std::ostream& err)
+	{
+		const auto unique = BatchCommit::Unique(files);
+		Result result;
+		BatchCommit::Run<Slot>(unique, _options.threads, _options.batchSize, out,
+			[&](std::string const& file, Slot& slot) { Prepare(file, slot); },
+			[&](std::string const& file, Slot const& slot)
+		{
+			if (!slot.error.empty())
+			{
+				err << file << ": error: " << slot.error << "\n";
+				++result.errors;
+			}
+			else if (slot.state == ResLib::ResPatch::TargetState::Mismatch)
+			{
+				err << file << ": rejected: " << slot.mismatch << "\n";
+				++result.rejected;
+			}
+			else if (slot.state == ResLib::ResPatch::TargetState::Patched)
+			{
+				out << file << ": already patched\n";
+				++result.upToDate;
+			}
+			else
+			{
+				out << file << ": " << _bundle.Ops().size() << " op(s) applied, " << slot.oldSize << " -> " << slot.newSize << " bytes\n";
+				++result.patched;
+			}
+		});
+
+		result.files = unique.size();
+		return result;
+	}
+
+private:
+	struct Slot : BatchCommit::Slot
+	{
+		ResLib::ResPatch::TargetState state{ ResLib::ResPatch::TargetState::Old };
+		std::string mismatch;
+		uint64_t oldSize{ 0 };
+		uint64_t newSize{ 0 };
+	};
+
+	void Prepare(std::string const& file, Slot& slot) const
+	{
+		{
+			ResLib::MappedFile target(file.c_str());
+			const ResLib::Pe::Image image(target.Data());
+			slot.state = ResLib::ResPatch::Check(ResLib::ResourceDirectory(image), _bundle.Ops(), &slot.mismatch);
+			slot.oldSize = target.Size();
+		}
+		if (slot.state != ResLib::ResPatch::TargetState::Old) return;
+
+		ResLib::NativeUpdateSession session(file.c_str(), _options.commit);
+		ResLib::ResPatch::Apply(session, _bundle.Ops(), _data);
+		slot.pending.emplace(session.Prepare());
+		slot.newSize = std::filesystem::file_size(ResLib::PendingFile::ToPath(slot.pending->TempName()));
+	}
+
+	ResLib::MappedFile _file;
+	ResLib::ResPatch::Bundle _bundle;
+	std::vector<std::vector<unsigned char>> _data;
+	Options _options;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+// Removes the resources a ResLib::ResourceSelector matches from many files.
+// Each file is loaded once, all its matches are removed from the table in
+// one pass and the resource section is rebuilt once, shrinking the section
+// (and the file, if .rsrc is the last section). Up to `threads` files are
+// prepared at the same time; like ResFanOut the updated copies are renamed
+// over the targets in batches of `batchSize` with one SyncBatch. Files
+// without matches are left untouched.
+//
+// Output, one line per file, in input order:
+//   file: N resource(s) removed, <old size> -> <new size> bytes
+//   file: nothing to remove
+
+#include "BatchCommit.hpp"
+#include "ResLib/ResLib.hpp"
+#include "ResUtil.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResRemove
+{
+public:
+	struct Options
+	{
+		size_t threads{ 0 };        // 0: one per core
+		size_t batchSize{ 256 };    // files per sync batch
+		ResLib::CommitOptions commit;
+	};
+
+	struct Result
+	{
+		size_t files{ 0 };
+		size_t changed{ 0 };        // files with at least one resource removed
+		size_t removed{ 0 };        // resources removed from all files
+		uint64_t bytesSaved{ 0 };
+		size_t errors{ 0 };
+	};
+
+	ResRemove(ResLib::ResourceSelector selector, Options const& options)
+		: _selector{ std::move(selector) }
+		, _options{ options }
+	{
+		if (!_options.threads) _options.threads = std::max(1u, std::thread::hardware_concurrency());
+		if (!_options.batchSize) _options.batchSize = 1;
+	}
+
+	// A file listed more than once is updated once.
+	Result Run(std::vector<std::string> const& files, std::ostream& out, std::ostream& err)
+	{
+		const auto unique = BatchCommit::Unique(files);
+		Result result;
+		BatchCommit::Run<Slot>(unique, _options.threads, _options.batchSize, out,
+			[&](std::string const& file, Slot& slot) { Prepare(file, slot); },
+			[&](std::string const& file, Slot const& slot)
+		{
+			if (!slot.error.empty())
+			{
+				err << file << ": error: " << slot.error << "\n";
+				++result.errors;
+			}
+			else if (!slot.removed)
+			{
+				out << file << ": nothing to remove\n";
+			}
+			else
+			{
+				out << file << ": " << slot.removed << " resource(s) removed, " << slot.oldSize << " -> " << slot.newSize << " bytes\n";
+				++result.changed;
+				result.removed += slot.removed;
+				if (slot.newSize < slot.oldSize) result.bytesSaved += slot.oldSize - slot.newSize;
+			}
+		});
+
+		result.files = unique.size();
+		return result;
+	}
+
+private:
+	struct Slot : BatchCommit::Slot
+	{
+		size_t removed{ 0 };
+		uint64_t oldSize{ 0 };
+		uint64_t newSize{ 0 };
+	};
+
+	void Prepare(std::string const& file, Slot& slot) const
+	{
+		ResLib::NativeUpdateSession session(file.c_str(), _options.commit);
+		slot.removed = session.Remove(_selector);
+		if (!slot.removed) return;
+
+		slot.oldSize = std::filesystem::file_size(ResLib::PendingFile::ToPath(file));
+		slot.pending.emplace(session.Prepare());
+		slot.newSize = std::filesystem::file_size(ResLib::PendingFile::ToPath(slot.pending->TempName()));
+	}
+
+	ResLib::ResourceSelector _selector;
+	Options _options;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+// Searches the resource data of many files for byte patterns. Files are
+// mapped and scanned in place (ResLib::ByteSearch), one file per worker
+// thread at a time; results are printed in input order.
+//
+// Output, one line per match:  file<TAB>type<TAB>name<TAB>lang<TAB>offset<TAB>pattern
+// where offset is relative to the start of the resource data.
+
+#include "Parallel.hpp"
+#include "ResLib/ByteSearch.hpp"
+#include "ResLib/MappedFile.hpp"
+#include "ResLib/PeImage.hpp"
+#include "ResLib/ResId.hpp"
+#include "ResLib/ResourceDirectory.hpp"
+#include "ResUtil.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResSearch
+{
+public:
+	struct Pattern
+	{
+		std::string label;      // printed with each match: hex, utf8, utf16
+		ResLib::ByteSearch search;
+	};
+
+	struct Result
+	{
+		size_t files{ 0 };
+		size_t matches{ 0 };
+		size_t errors{ 0 };
+	};
+
+	// "4D 5A 90" or "4d5a90"
+	static std::vector<unsigned char> ParseHex(std::string const& hex)
+	{
+		std::vector<unsigned char> bytes;
+		int high = -1;
+		for (auto c : hex)
+		{
+			if (c == ' ') continue;
+			const int value = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+			if (value < 0) throw ResUtil::IoException(("Invalid hex pattern: " + hex).c_str());
+			if (high < 0)
+			{
+				high = value;
+			}
+			else
+			{
+				bytes.push_back(static_cast<unsigned char>(high << 4 | value));
+				high = -1;
+			}
+		}
+		if (high >= 0 || bytes.empty()) throw ResUtil::IoException(("Invalid hex pattern: " + hex).c_str());
+		return bytes;
+	}
+
+	static std::vector<unsigned char> Utf16Bytes(std::string const& text)
+	{
+		std::vector<unsigned char> bytes;
+		for (auto c : Utf8::ToUtf16(text))
+		{
+			bytes.push_back(static_cast<unsigned char>(c & 0xFF));
+			bytes.push_back(static_cast<unsigned char>(c >> 8));
+		}
+		return bytes;
+	}
+
+	// Files are taken as they are, directories are searched recursively.
+	static std::vector<std::string> CollectFiles(std::vector<std::string> const& inputs)
+	{
+		std::vector<std::string> files;
+		for (auto const& input : inputs)
+		{
+			if (!std::filesystem::is_directory(input))
+			{
+				files.push_back(input);
+				continue;
+			}
+			std::vector<std::string> found;
+			for (auto const& entry : std::filesystem::recursive_directory_iterator(input, std::filesystem::directory_options::skip_permission_denied))
+			{
+				if (entry.is_regular_file()) found.push_back(entry.path().string());
+			}
+			std::sort(found.begin(), found.end());
+			files.insert(files.end(), found.begin(), found.end());
+		}
+		return files;
+	}
+
+	ResSearch(std::vector<Pattern> patterns, std::optional<ResLib::ResId> type, size_t threads)
+		: _patterns{ std::move(patterns) }
+		, _type{ std::move(type) }
+		, _threads{ threads ? threads : std::max(1u, std::thread::hardware_concurrency()) }
+	{}
+
+	// Files that aren't PE images are skipped, files that can't be read are
+	// reported on err.
+	Result Run(std::vector<std::string> const& files, std::ostream& out, std::ostream& err)
+	{
+		struct Slot
+		{
+			std::string output;
+			std::string error;
+			size_t matches{ 0 };
+		};
+		Result result;
+		Parallel::ForEachOrdered(files.size(), _threads, [&](size_t index)
+		{
+			Slot slot;
+			try
+			{
+				std::ostringstream lines;
+				slot.matches = SearchFile(files[index], lines);
+				slot.output = lines.str();
+			}
+			catch (std::exception const& e)
+			{
+				slot.error = files[index] + ": error: " + e.what() + "\n";
+			}
+			return slot;
+		},
+		[&](size_t, Slot const& slot)
+		{
+			out << slot.output;
+			err << slot.error;
+			result.matches += slot.matches;
+			result.errors += slot.error.empty() ? 0 : 1;
+		});
+
+		out.flush();
+		result.files = files.size();
+		return result;
+	}
+
+	// false for files that aren't PE images (as found in directory trees)
+	static bool IsImage(ResLib::Pe::Bytes data)
+	{
+		try
+		{
+			ResLib::Pe::Image image(data);
+			return true;
+		}
+		catch (ResLib::InvalidFileException const&)
+		{
+			return false;
+		}
+	}
+
+	// Writes the matches of one file and returns their number.
+	size_t SearchFile(std::string const& fileName, std::ostream& out) const
+	{
+		std::error_code ec;
+		if (std::filesystem::file_size(fileName, ec) == 0 && !ec) return 0;    // can't be mapped
+		ResLib::MappedFile file(fileName.c_str());
+		if (!IsImage(file.Data())) return 0;
+		ResLib::Pe::Image image(file.Data());
+		ResLib::ResourceDirectory resources(image);
+
+		size_t matches = 0;
+		auto search = [&](ResLib::ResourceEntry const& entry)
+		{
+			const auto data = resources.GetData(entry);
+			for (auto const& pattern : _patterns)
+			{
+				pattern.search.ForEach(data, [&](size_t offset)
+				{
+					out << fileName << '\t' << entry.type.ToTypeString() << '\t' << entry.name.ToString() << '\t' << entry.lang << '\t' << offset << '\t' << pattern.label << '\n';
+					++matches;
+					return true;
+				});
+			}
+			return true;
+		};
+		if (_type) resources.ForEachOfType(*_type, search);
+		else resources.ForEach(search);
+		return matches;
+	}
+
+private:
+	std::vector<Pattern> _patterns;
+	std::optional<ResLib::ResId> _type;
+	size_t _threads;
+};
@@ -0,0 +1,433 @@
+#pragma once
+
+// Resource query daemon: answers read/enum/hash requests on a Unix domain
+// socket, keeping recently used modules mapped and indexed (ResLib::ModuleCache).
+//
+// Protocol (all integers little endian):
+//   request:  u32 length | u8 op | fields...        (length counts op + fields)
+//   response: u32 length | u8 status | payload...   (length counts status + payload)
+//   strings are encoded as u16 byte count + UTF-8, lang 0xFFFF means "any"
+//
+//   op 1 read: file, type, name, u16 lang  -> resource data
+//   op 2 enum: file, type                  -> "name<TAB>lang<TAB>size" lines, or the type names if type is empty
+//   op 3 hash: file, type, name, u16 lang  -> u64 FNV-1a hash | u32 size
+//
+//   status 0 ok, 1 not found, 2 bad request, 3 error (payload is the message)
+//
+// A connection may carry any number of requests. Idle connections are
+// watched by the accepting thread with poll(); a worker only takes a
+// connection when a request has arrived, answers it and hands the
+// connection back, so idle keep-alive clients don't hold workers. Resource
+// data is sent straight from the mapping (gathered write, no intermediate
+// buffer).
+
+#ifndef _WIN32
+
+#include "ResLib/Hash.hpp"
+#include "ResLib/ModuleCache.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+class ResServer
+{
+public:
+	enum class Op : uint8_t { Read = 1, Enum = 2, Hash = 3 };
+	enum class Status : uint8_t { Ok = 0, NotFound = 1, BadRequest = 2, Error = 3 };
+
+	static constexpr uint32_t MaxRequestSize = 64 * 1024;
+	static constexpr uint16_t AnyLang = 0xFFFF;
+	static constexpr int IdleTimeoutSeconds = 30;   // connections without requests are closed
+	static constexpr int FrameTimeoutSeconds = 5;   // for the rest of a request once it has started
+	static constexpr int SendTimeoutSeconds = 5;    // a response the client doesn't read on for this long is dropped
+
+	struct Options
+	{
+		std::string socketPath;
+		size_t threads{ 0 };        // 0: one per core
+		size_t cacheSize{ 256 };    // number of modules kept mapped
+	};
+
+	explicit ResServer(Options options)
+		: _options{ std::move(options) }
+		, _cache{ _options.cacheSize }
+	{
+		if (_options.threads == 0) _options.threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	ResServer(const ResServer&) = delete;
+	ResServer& operator=(const ResServer&) = delete;
+
+	~ResServer()
+	{
+		for (auto fd : _wakeFds)
+		{
+			if (fd >= 0) ::close(fd);
+		}
+		if (_listener >= 0)
+		{
+			::close(_listener);
+			::unlink(_options.socketPath.c_str());
+		}
+	}
+
+	// Serves until Stop() is called (e.g. from a signal handler).
+	void Run()
+	{
+		Listen();
+		if (::pipe2(_wakeFds, O_CLOEXEC | O_NONBLOCK) != 0) throw std::system_error(errno, std::generic_category(), "Creating pipe failed");
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < _options.threads; ++i) workers.emplace_back([this] { Work(); });
+
+		struct Idle
+		{
+			int fd{ -1 };
+			std::chrono::steady_clock::time_point deadline;
+		};
+		std::vector<Idle> idle;
+		std::vector<pollfd> pfds;
+		while (!_stop)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (auto client : _returned) idle.push_back({ client, now + std::chrono::seconds(IdleTimeoutSeconds) });
+				_returned.clear();
+			}
+
+			pfds.assign({ { _listener, POLLIN, 0 }, { _wakeFds[0], POLLIN, 0 } });
+			for (auto const& connection : idle) pfds.push_back({ connection.fd, POLLIN, 0 });
+			if (::poll(pfds.data(), pfds.size(), 250) < 0) continue;
+
+			if (pfds[1].revents)
+			{
+				char buffer[64];
+				while (::read(_wakeFds[0], buffer, sizeof(buffer)) > 0) {}
+			}
+
+			// ready connections go to the workers, the others stay until their deadline
+			std::vector<int> ready;
+			size_t kept = 0;
+			for (size_t i = 0; i < idle.size(); ++i)
+			{
+				if (pfds[i + 2].revents) ready.push_back(idle[i].fd);
+				else if (idle[i].deadline < now) ::close(idle[i].fd);
+				else idle[kept++] = idle[i];
+			}
+			idle.resize(kept);
+
+			if (pfds[0].revents & POLLIN)
+			{
+				const int client = ::accept4(_listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if (client >= 0)
+				{
+					timeval timeout{ FrameTimeoutSeconds, 0 };
+					::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+					timeval sendTimeout{ SendTimeoutSeconds, 0 };
+					::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+					idle.push_back({ client, now + std::chrono::seconds(IdleTimeoutSeconds) });
+				}
+			}
+
+			if (ready.empty()) continue;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_clients.insert(_clients.end(), ready.begin(), ready.end());
+			}
+			if (ready.size() == 1) _wakeup.notify_one();
+			else _wakeup.notify_all();
+		}
+
+		{
+			// wake up workers waiting for the rest of a request
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto client : _active) ::shutdown(client, SHUT_RDWR);
+		}
+		_wakeup.notify_all();
+		for (auto& worker : workers) worker.join();
+		for (auto client : _clients) ::close(client);
+		for (auto client : _returned) ::close(client);
+		for (auto const& connection : idle) ::close(connection.fd);
+		_clients.clear();
+		_returned.clear();
+	}
+
+	void Stop() noexcept { _stop = true; }
+
+	size_t Requests() const noexcept { return _requests; }
+	ResLib::ModuleCache const& Cache() const noexcept { return _cache; }
+
+private:
+	// reads length prefixed frames from a connection
+	class Connection
+	{
+	public:
+		explicit Connection(int fd) : _fd{ fd } {}
+
+		bool ReadFrame(std::vector<unsigned char>& frame)
+		{
+			unsigned char header[4];
+			if (!ReadExact(header, sizeof(header))) return false;
+			const uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (uint32_t(header[3]) << 24);
+			if (length == 0 || length > MaxRequestSize) return false;
+			frame.resize(length);
+			return ReadExact(frame.data(), frame.size());
+		}
+
+		bool Send(Status status, ResLib::Pe::Bytes payload)
+		{
+			const auto length = static_cast<uint32_t>(payload.size() + 1);
+			unsigned char header[5] = {
+				static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+				static_cast<unsigned char>(length >> 16), static_cast<unsigned char>(length >> 24),
+				static_cast<unsigned char>(status) };
+
+			iovec iov[2] = {
+				{ header, sizeof(header) },
+				{ const_cast<unsigned char*>(payload.data()), payload.size() } };
+			size_t index = 0;
+			while (index < 2)
+			{
+				msghdr msg{};
+				msg.msg_iov = iov + index;
+				msg.msg_iovlen = 2 - index;
+				auto sent = ::sendmsg(_fd, &msg, MSG_NOSIGNAL);
+				if (sent < 0 && errno == EINTR) continue;
+				if (sent < 0) return false;     // EAGAIN/EWOULDBLOCK: the client stopped reading, the connection is dropped
+				for (; index < 2 && static_cast<size_t>(sent) >= iov[index].iov_len; ++index) sent -= iov[index].iov_len;
+				if (index < 2)
+				{
+					iov[index].iov_base = static_cast<unsigned char*>(iov[index].iov_base) + sent;
+					iov[index].iov_len -= sent;
+				}
+			}
+			return true;
+		}
+
+		bool Send(Status status, std::string const& text)
+		{
+			return Send(status, ResLib::Pe::Bytes(reinterpret_cast<const unsigned char*>(text.data()), text.size()));
+		}
+
+	private:
+		bool ReadExact(unsigned char* buffer, size_t size)
+		{
+			while (size)
+			{
+				const auto result = ::recv(_fd, buffer, size, 0);
+				if (result < 0 && errno == EINTR) continue;
+				if (result <= 0) return false;
+				buffer += result;
+				size -= static_cast<size_t>(result);
+			}
+			return true;
+		}
+
+		int _fd;
+	};
+
+	// sequential access to the fields of a request frame
+	class Reader
+	{
+	public:
+		explicit Reader(ResLib::Pe::Bytes frame) : _frame{ frame } {}
+
+		template<typename T>
+		T Read()
+		{
+			auto value = ResLib::Pe::Read<T>(_frame, _offset);
+			_offset += sizeof(T);
+			return value;
+		}
+
+		std::string ReadString()
+		{
+			const auto length = Read<uint16_t>();
+			if (_frame.size() - _offset < length) throw ResLib::InvalidDataException();
+			std::string value(reinterpret_cast<const char*>(_frame.data()) + _offset, length);
+			_offset += length;
+			return value;
+		}
+
+	private:
+		ResLib::Pe::Bytes _frame;
+		size_t _offset{ 0 };
+	};
+
+	void Listen()
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (_options.socketPath.empty() || _options.socketPath.size() >= sizeof(address.sun_path))
+		{
+			throw std::runtime_error("Invalid socket path '" + _options.socketPath + "'");
+		}
+		std::strcpy(address.sun_path, _options.socketPath.c_str());
+
+		// a socket file left behind by a crashed server is replaced, a live one is not
+		struct stat st {};
+		if (::lstat(_options.socketPath.c_str(), &st) == 0)
+		{
+			if (!S_ISSOCK(st.st_mode)) throw std::runtime_error("'" + _options.socketPath + "' exists and is not a socket");
+			const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			const bool inUse = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+			if (probe >= 0) ::close(probe);
+			if (inUse) throw std::runtime_error("Socket '" + _options.socketPath + "' is in use by another server");
+			::unlink(_options.socketPath.c_str());
+		}
+
+		const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) throw std::system_error(errno, std::generic_category(), "Creating socket failed");
+		if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0)
+		{
+			const auto err = errno;
+			::close(fd);
+			throw std::system_error(err, std::generic_category(), "Listening on '" + _options.socketPath + "' failed");
+		}
+		_listener = fd;
+	}
+
+	void Work()
+	{
+		std::vector<unsigned char> frame;
+		for (;;)
+		{
+			int client = -1;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wakeup.wait(lock, [this] { return _stop || !_clients.empty(); });
+				if (_clients.empty()) return;
+				client = _clients.front();
+				_clients.pop_front();
+				_active.insert(client);
+			}
+
+			// one request, then the connection goes back to the poll set
+			Connection connection(client);
+			bool keep = !_stop && connection.ReadFrame(frame);
+			if (keep)
+			{
+				++_requests;
+				keep = Handle(connection, frame);
+			}
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_active.erase(client);
+				if (keep && !_stop) _returned.push_back(client);
+				else ::close(client);
+			}
+			if (keep) Wake();
+		}
+	}
+
+	void Wake() noexcept
+	{
+		const char byte = 0;
+		[[maybe_unused]] auto written = ::write(_wakeFds[1], &byte, 1);
+	}
+
+	bool Handle(Connection& connection, std::vector<unsigned char> const& frame)
+	{
+		Reader reader(frame);
+		Op op{};
+		std::string file;
+		std::string type;
+		std::string name;
+		uint16_t lang = AnyLang;
+		try
+		{
+			op = static_cast<Op>(reader.Read<uint8_t>());
+			file = reader.ReadString();
+			type = reader.ReadString();
+			if (op == Op::Read || op == Op::Hash)
+			{
+				name = reader.ReadString();
+				lang = reader.Read<uint16_t>();
+			}
+			else if (op != Op::Enum)
+			{
+				return connection.Send(Status::BadRequest, "unknown operation " + std::to_string(static_cast<int>(op)));
+			}
+		}
+		catch (std::exception const&)
+		{
+			return connection.Send(Status::BadRequest, std::string("truncated request"));
+		}
+
+		try
+		{
+			auto module = _cache.Get(file);
+			if (op == Op::Enum) return connection.Send(Status::Ok, Enumerate(*module, type));
+
+			const std::optional<uint16_t> langFilter = lang == AnyLang ? std::nullopt : std::optional<uint16_t>(lang);
+			auto entry = module->Find(ResLib::ResId::ParseType(type.c_str()), ResLib::ResId::Parse(name.c_str()), langFilter);
+			if (!entry) return connection.Send(Status::NotFound, type + "/" + name + " not found in '" + file + "'");
+
+			const auto data = module->Resources().GetData(*entry);
+			if (op == Op::Read) return connection.Send(Status::Ok, data);
+
+			unsigned char hash[12];
+			ResLib::Pe::Write<uint64_t>(hash, 0, ResLib::Hash::Fnv1a64(data));
+			ResLib::Pe::Write<uint32_t>(hash, 8, entry->size);
+			return connection.Send(Status::Ok, ResLib::Pe::Bytes(hash, sizeof(hash)));
+		}
+		catch (std::exception const& e)
+		{
+			return connection.Send(Status::Error, std::string(e.what()));
+		}
+	}
+
+	static std::string Enumerate(ResLib::Module const& module, std::string const& type)
+	{
+		std::string result;
+		if (type.empty())
+		{
+			std::set<ResLib::ResId> types;
+			module.ForEach(std::nullopt, [&](ResLib::ResourceEntry const& entry) { types.insert(entry.type.ToResId()); });
+			for (auto const& id : types) result += id.ToTypeString() + "\n";
+			return result;
+		}
+
+		module.ForEach(ResLib::ResId::ParseType(type.c_str()), [&](ResLib::ResourceEntry const& entry)
+		{
+			result += entry.name.ToString() + "\t" + std::to_string(entry.lang) + "\t" + std::to_string(entry.size) + "\n";
+		});
+		return result;
+	}
+
+	Options _options;
+	ResLib::ModuleCache _cache;
+	int _listener{ -1 };
+	std::atomic<bool> _stop{ false };
+	std::atomic<size_t> _requests{ 0 };
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	int _wakeFds[2]{ -1, -1 };    // interrupts the poll when a connection is handed back
+	std::deque<int> _clients;     // with a request waiting, for the next worker
+	std::set<int> _active;        // being served
+	std::vector<int> _returned;   // served, to be watched again
+};
+
+#endif
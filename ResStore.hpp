@@ -0,0 +1,498 @@
+#pragma once
+
+// Content addressable archive of resources.
+//
+// Layout of a store directory:
+//   packs/NNNNNN.pack   resource data, blobs appended back to back, never rewritten
+//   blobs.idx           16 byte header ("RESBLOBS" | u32 version | u32 record size), then
+//                       one 48 byte record per blob: sha256[32] | u32 size | u32 pack | u64 offset
+//   store.lock          locked by the process that has the store open
+//   index/<label>/<path>.idx
+//                       text, "# " comment lines, then one resource per line:
+//                       type<TAB>name<TAB>lang<TAB>codepage<TAB>sha256<TAB>size<TAB>pack<TAB>offset
+//
+// Blobs are identified by SHA-256 and size and only stored if no blob with
+// the same content exists yet, so the store grows with new content rather
+// than with the number of archived binaries. <path> is the path of the
+// archived file relative to the current directory (or its absolute path
+// without the root), so equally named files of different directories get
+// indexes of their own; archiving a different file under an existing index
+// fails. Pack data is written and flushed to disk before the blob records,
+// those before the index that refers to them, which replaces its previous
+// version atomically; records left incomplete by an interrupted run are
+// ignored when loading. A ResStore holds an exclusive lock on store.lock
+// while it exists, so runs sharing a store wait for each other instead of
+// appending to the same pack.
+
+#include "ResLib/Hash.hpp"
+#include "ResLib/ModuleCache.hpp"
+#include "ResLib/PendingFile.hpp"
+#include "ResLib/ResLib.hpp"
+#include "ResUtil.h"
+#include "StringHelper.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ResStore
+{
+public:
+	static constexpr uint64_t DefaultPackSize = 256ull * 1024 * 1024;
+	static constexpr size_t BlobHeaderSize = 16;
+	static constexpr size_t BlobRecordSize = 48;
+	static constexpr uint32_t BlobVersion = 2;
+
+	struct Blob
+	{
+		ResLib::Hash::Digest hash{};
+		uint32_t size{ 0 };
+		uint32_t pack{ 0 };
+		uint64_t offset{ 0 };
+	};
+
+	struct IndexEntry
+	{
+		ResLib::ResId type;
+		ResLib::ResId name;
+		uint16_t lang{ 0 };
+		uint32_t codePage{ 0 };
+		Blob blob;
+	};
+
+	struct ArchiveResult
+	{
+		std::string index;
+		size_t resources{ 0 };
+		size_t newBlobs{ 0 };
+		uint64_t newBytes{ 0 };
+	};
+
+	explicit ResStore(std::filesystem::path root, uint64_t packSize = DefaultPackSize)
+		: _root{ std::move(root) }
+		, _packSize{ packSize }
+	{
+		std::filesystem::create_directories(_root / "packs");
+		std::filesystem::create_directories(_root / "index");
+		_lock.emplace((_root / "store.lock").string());
+		LoadBlobs();
+	}
+
+	ResStore(const ResStore&) = delete;
+	ResStore& operator=(const ResStore&) = delete;
+
+	size_t BlobCount() const noexcept { return _blobCount; }
+
+	// Stores the resources of a binary and writes its index as <label>/<path>.
+	ArchiveResult Archive(std::string const& fileName, std::string const& label)
+	{
+		ArchiveResult result;
+		result.index = IndexName(fileName, label);
+		const auto indexPath = IndexPath(result.index);
+		const auto source = std::filesystem::absolute(fileName).lexically_normal().string();
+		const auto previous = IndexedFile(indexPath);
+		if (!previous.empty() && previous != source)
+		{
+			throw ResUtil::IoException(("Index " + result.index + " already holds " + previous + ", archive " + source + " with another label").c_str());
+		}
+
+		ResLib::Module module(fileName);
+		std::vector<IndexEntry> entries;
+		std::vector<Blob> added;
+		module.ForEach(std::nullopt, [&](ResLib::ResourceEntry const& entry)
+		{
+			const auto data = module.Resources().GetData(entry);
+			const auto hash = ResLib::Hash::Sha256(data);
+			auto blob = Find(hash, static_cast<uint32_t>(data.size()));
+			if (!blob)
+			{
+				blob = Append(hash, data);
+				added.push_back(*blob);
+				++result.newBlobs;
+				result.newBytes += data.size();
+			}
+			entries.push_back({ entry.type.ToResId(), entry.name.ToResId(), entry.lang, entry.codePage, *blob });
+			return true;
+		});
+		result.resources = entries.size();
+
+		// data first, then the blob records, then the index referring to both
+		SyncPacks();
+		WriteBlobRecords(added);
+		WriteIndex(indexPath, source, entries);
+		return result;
+	}
+
+	std::vector<IndexEntry> ReadIndex(std::string const& index) const
+	{
+		const auto path = IndexPath(index);
+		std::ifstream in(path);
+		if (!in) throw ResUtil::IoException(("Unable to open index " + path.string()).c_str());
+
+		std::vector<IndexEntry> entries;
+		size_t lineNumber = 0;
+		for (std::string line; std::getline(in, line);)
+		{
+			++lineNumber;
+			if (line.empty() || line.rfind("# ", 0) == 0) continue;     // comment; ids are "#<number>"
+			auto fields = StringHelper::split(line, '\t');
+			try
+			{
+				if (fields.size() != 8) throw std::invalid_argument("field count");
+				IndexEntry entry;
+				entry.type = Decode(fields[0]);
+				entry.name = Decode(fields[1]);
+				entry.lang = static_cast<uint16_t>(std::stoul(fields[2]));
+				entry.codePage = static_cast<uint32_t>(std::stoul(fields[3]));
+				entry.blob.hash = ParseHash(fields[4]);
+				entry.blob.size = static_cast<uint32_t>(std::stoul(fields[5]));
+				entry.blob.pack = static_cast<uint32_t>(std::stoul(fields[6]));
+				entry.blob.offset = std::stoull(fields[7]);
+				entries.emplace_back(std::move(entry));
+			}
+			catch (std::exception const&)
+			{
+				throw ResUtil::IoException((path.string() + "(" + std::to_string(lineNumber) + "): invalid index entry").c_str());
+			}
+		}
+		return entries;
+	}
+
+	// Reads a blob back and checks it against its hash.
+	std::vector<unsigned char> ReadBlob(Blob const& blob) const
+	{
+		if (_pack && blob.pack == _packNumber) _pack->flush();
+		std::vector<unsigned char> data(blob.size);
+		std::ifstream in(PackPath(blob.pack), std::ios::binary);
+		in.seekg(static_cast<std::streamoff>(blob.offset));
+		in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!in || ResLib::Hash::Sha256(data) != blob.hash)
+		{
+			throw ResUtil::IoException(("Blob at " + PackPath(blob.pack).string() + ":" + std::to_string(blob.offset) + " is missing or corrupt").c_str());
+		}
+		return data;
+	}
+
+	// Writes the resources of an index into the target file with a single commit.
+	size_t Restore(std::string const& index, const char* targetFile, ResLib::CommitOptions const& options = {}) const
+	{
+		const auto entries = ReadIndex(index);
+		ResLib::UpdateSession session(targetFile, options);
+		for (auto const& entry : entries)
+		{
+			const auto data = ReadBlob(entry.blob);
+			session.Set(entry.type, entry.name, entry.lang, data.data(), static_cast<uint32_t>(data.size()));
+		}
+		session.Commit();
+		return entries.size();
+	}
+
+	// ids are written as #<number>, names escaped so that they can't be taken for one
+	static std::string Encode(ResLib::ResId const& id)
+	{
+		if (id.IsId()) return "#" + std::to_string(id.id);
+		std::string result;
+		for (auto c : id.ToString())
+		{
+			if (c == '%' || c == '\t' || c == '\n' || c == '\r' || (c == '#' && result.empty()))
+			{
+				static const char digits[] = "0123456789ABCDEF";
+				result += '%';
+				result += digits[static_cast<unsigned char>(c) >> 4];
+				result += digits[c & 0xF];
+			}
+			else
+			{
+				result += c;
+			}
+		}
+		return result;
+	}
+
+	static ResLib::ResId Decode(std::string const& str)
+	{
+		if (str.empty()) throw std::invalid_argument("empty id");
+		if (str.front() == '#') return ResLib::ResId(static_cast<uint16_t>(std::stoul(str.substr(1))));
+		std::string name;
+		for (size_t i = 0; i < str.size(); ++i)
+		{
+			if (str[i] == '%' && i + 2 < str.size())
+			{
+				name += static_cast<char>(std::stoul(str.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			else
+			{
+				name += str[i];
+			}
+		}
+		return ResLib::ResId(Utf8::ToUtf16(name));
+	}
+
+private:
+	std::filesystem::path PackPath(uint32_t pack) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%06u.pack", pack);
+		return _root / "packs" / name;
+	}
+
+	std::filesystem::path IndexPath(std::string const& index) const
+	{
+		const auto relative = std::filesystem::path(index + ".idx").lexically_normal();
+		if (relative.is_absolute() || relative.empty() || *relative.begin() == "..") throw ResUtil::IoException(("Invalid index name: " + index).c_str());
+		return _root / "index" / relative;
+	}
+
+	// <label>/<path of the file relative to the current directory>; a file
+	// outside of it is indexed by its absolute path, the root replaced by
+	// the drive letter (if any)
+	static std::string IndexName(std::string const& fileName, std::string const& label)
+	{
+		const auto absolute = std::filesystem::absolute(fileName).lexically_normal();
+		auto relative = absolute.lexically_relative(std::filesystem::current_path());
+		if (relative.empty() || *relative.begin() == "..")
+		{
+			std::string root;
+			for (auto c : absolute.root_name().string())
+			{
+				if (c != ':' && c != '/' && c != '\\') root += c;
+			}
+			relative = root.empty() ? absolute.relative_path() : std::filesystem::path(root) / absolute.relative_path();
+		}
+		return label + "/" + relative.generic_string();
+	}
+
+	// the file an existing index was written for, empty if there is none
+	static std::string IndexedFile(std::filesystem::path const& path)
+	{
+		std::ifstream in(path);
+		for (std::string line; std::getline(in, line) && line.rfind("# ", 0) == 0;)
+		{
+			if (line.rfind("# file: ", 0) == 0) return line.substr(8);
+		}
+		return {};
+	}
+
+	static std::string FormatHash(ResLib::Hash::Digest const& hash)
+	{
+		std::string text;
+		for (auto b : hash)
+		{
+			static const char digits[] = "0123456789abcdef";
+			text += digits[b >> 4];
+			text += digits[b & 0xF];
+		}
+		return text;
+	}
+
+	static ResLib::Hash::Digest ParseHash(std::string const& text)
+	{
+		ResLib::Hash::Digest hash{};
+		if (text.size() != hash.size() * 2) throw std::invalid_argument("hash");
+		for (size_t i = 0; i < hash.size(); ++i)
+		{
+			size_t used = 0;
+			hash[i] = static_cast<unsigned char>(std::stoul(text.substr(2 * i, 2), &used, 16));
+			if (used != 2) throw std::invalid_argument("hash");
+		}
+		return hash;
+	}
+
+	struct BlobKeyHash
+	{
+		size_t operator()(std::pair<ResLib::Hash::Digest, uint32_t> const& key) const noexcept
+		{
+			size_t value;
+			std::memcpy(&value, key.first.data(), sizeof(value));
+			return value ^ key.second;
+		}
+	};
+
+	void LoadBlobs()
+	{
+		std::ifstream in(_root / "blobs.idx", std::ios::binary);
+		if (!in) return;
+		std::vector<unsigned char> records((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		if (records.size() < BlobHeaderSize) return;    // torn header, rewritten with the first record
+		if (std::memcmp(records.data(), "RESBLOBS", 8) != 0 || ResLib::Pe::Read<uint32_t>(records, 8) != BlobVersion || ResLib::Pe::Read<uint32_t>(records, 12) != BlobRecordSize)
+		{
+			throw ResUtil::IoException(((_root / "blobs.idx").string() + " is not a blob index of this version").c_str());
+		}
+
+		std::unordered_map<uint32_t, uint64_t> packSizes;
+		auto packSize = [&](uint32_t pack)
+		{
+			auto pos = packSizes.find(pack);
+			if (pos != packSizes.end()) return pos->second;
+			std::error_code ec;
+			const auto size = std::filesystem::file_size(PackPath(pack), ec);
+			return packSizes[pack] = ec ? 0 : size;
+		};
+
+		// a torn record at the end, or one whose data never made it to disk, is ignored
+		size_t pos = BlobHeaderSize;
+		for (; pos + BlobRecordSize <= records.size(); pos += BlobRecordSize)
+		{
+			Blob blob;
+			std::memcpy(blob.hash.data(), records.data() + pos, blob.hash.size());
+			blob.size = ResLib::Pe::Read<uint32_t>(records, pos + 32);
+			blob.pack = ResLib::Pe::Read<uint32_t>(records, pos + 36);
+			blob.offset = ResLib::Pe::Read<uint64_t>(records, pos + 40);
+			if (blob.offset + blob.size > packSize(blob.pack)) continue;
+			if (_blobs.emplace(std::make_pair(blob.hash, blob.size), blob).second) ++_blobCount;
+			_packNumber = std::max(_packNumber, blob.pack);
+		}
+		_validRecords = pos;
+	}
+
+	// equal hash and size is equal content, the data isn't read back
+	std::optional<Blob> Find(ResLib::Hash::Digest const& hash, uint32_t size) const
+	{
+		const auto pos = _blobs.find(std::make_pair(hash, size));
+		if (pos == _blobs.end()) return std::nullopt;
+		return pos->second;
+	}
+
+	Blob Append(ResLib::Hash::Digest const& hash, ResLib::Pe::Bytes data)
+	{
+		if (!_pack || (_packOffset > 0 && _packOffset + data.size() > _packSize))
+		{
+			if (_pack)
+			{
+				ClosePack();
+				++_packNumber;
+			}
+			OpenPack();
+		}
+		Blob blob{ hash, static_cast<uint32_t>(data.size()), _packNumber, _packOffset };
+		_pack->write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		_packOffset += data.size();
+		if (std::find(_unsynced.begin(), _unsynced.end(), _packNumber) == _unsynced.end()) _unsynced.push_back(_packNumber);
+		_blobs.emplace(std::make_pair(hash, blob.size), blob);
+		++_blobCount;
+		return blob;
+	}
+
+	void OpenPack()
+	{
+		for (;;)
+		{
+			std::error_code ec;
+			const auto size = std::filesystem::file_size(PackPath(_packNumber), ec);
+			_packOffset = ec ? 0 : size;
+			if (_packOffset < _packSize) break;
+			++_packNumber;
+		}
+		_newPack = _newPack || _packOffset == 0;
+		_pack = std::make_unique<std::ofstream>(PackPath(_packNumber), std::ios::binary | std::ios::app);
+		if (!*_pack) throw ResUtil::IoException(("Unable to open pack " + PackPath(_packNumber).string()).c_str());
+	}
+
+	void ClosePack()
+	{
+		_pack->close();
+		const bool ok = static_cast<bool>(*_pack);
+		_pack.reset();
+		if (!ok) throw ResUtil::IoException(("Writing pack " + PackPath(_packNumber).string() + " failed").c_str());
+	}
+
+	// flushes the packs written to since the last call to disk
+	void SyncPacks()
+	{
+		if (_pack)
+		{
+			_pack->flush();
+			if (!*_pack) throw ResUtil::IoException(("Writing pack " + PackPath(_packNumber).string() + " failed").c_str());
+		}
+		for (auto pack : _unsynced) ResLib::PendingFile::SyncFile(PackPath(pack).string());
+		if (_newPack) ResLib::PendingFile::SyncDirectory((_root / "packs").string());
+		_unsynced.clear();
+		_newPack = false;
+	}
+
+	void WriteBlobRecords(std::vector<Blob> const& blobs)
+	{
+		if (blobs.empty()) return;
+		std::vector<unsigned char> records;
+		if (_validRecords < BlobHeaderSize)
+		{
+			records.resize(BlobHeaderSize);
+			std::memcpy(records.data(), "RESBLOBS", 8);
+			ResLib::Pe::Write<uint32_t>(records, 8, BlobVersion);
+			ResLib::Pe::Write<uint32_t>(records, 12, static_cast<uint32_t>(BlobRecordSize));
+		}
+		for (auto const& blob : blobs)
+		{
+			const auto pos = records.size();
+			records.resize(pos + BlobRecordSize);
+			std::memcpy(records.data() + pos, blob.hash.data(), blob.hash.size());
+			ResLib::Pe::Write<uint32_t>(records, pos + 32, blob.size);
+			ResLib::Pe::Write<uint32_t>(records, pos + 36, blob.pack);
+			ResLib::Pe::Write<uint64_t>(records, pos + 40, blob.offset);
+		}
+
+		// drop a torn record first, so that the new ones start on a record boundary
+		const auto path = _root / "blobs.idx";
+		std::error_code ec;
+		const bool exists = std::filesystem::exists(path);
+		if (exists && std::filesystem::file_size(path, ec) != _validRecords) std::filesystem::resize_file(path, _validRecords);
+
+		std::ofstream out(path, std::ios::binary | std::ios::app);
+		out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size()));
+		out.close();
+		if (!out) throw ResUtil::IoException(("Writing " + path.string() + " failed").c_str());
+		ResLib::PendingFile::SyncFile(path.string());
+		if (!exists) ResLib::PendingFile::SyncDirectory(_root.string());
+		_validRecords += records.size();
+	}
+
+	static void WriteIndex(std::filesystem::path const& path, std::string const& fileName, std::vector<IndexEntry> const& entries)
+	{
+		CreateDirectories(path.parent_path());
+		ResLib::PendingFile index(path.string(), false);
+		{
+			std::ofstream out(index.TempName(), std::ios::trunc);
+			out << "# resutil archive index 1\n";
+			out << "# file: " << fileName << "\n";
+			for (auto const& entry : entries)
+			{
+				out << Encode(entry.type) << '\t' << Encode(entry.name) << '\t' << entry.lang << '\t' << entry.codePage << '\t'
+					<< FormatHash(entry.blob.hash) << '\t' << entry.blob.size << '\t' << entry.blob.pack << '\t' << entry.blob.offset << '\n';
+			}
+			out.close();
+			if (!out) throw ResUtil::IoException(("Writing index " + index.TempName() + " failed").c_str());
+		}
+		index.Commit();
+	}
+
+	// creates the missing directories of path and makes their entries durable
+	static void CreateDirectories(std::filesystem::path const& path)
+	{
+		std::vector<std::filesystem::path> missing;
+		for (auto dir = path; !dir.empty() && !std::filesystem::exists(dir); dir = dir.parent_path()) missing.push_back(dir);
+		std::filesystem::create_directories(path);
+		for (auto const& dir : missing) ResLib::PendingFile::SyncDirectory(dir.parent_path().string());
+	}
+
+	std::filesystem::path _root;
+	uint64_t _packSize;
+	std::optional<ResLib::FileLock> _lock;
+	std::unordered_map<std::pair<ResLib::Hash::Digest, uint32_t>, Blob, BlobKeyHash> _blobs;
+	size_t _blobCount{ 0 };
+	uint64_t _validRecords{ 0 };
+	uint32_t _packNumber{ 0 };
+	uint64_t _packOffset{ 0 };
+	std::unique_ptr<std::ofstream> _pack;
+	std::vector<uint32_t> _unsynced;
+	bool _newPack{ false };
+};
@@ -1,9 +1,30 @@
 #pragma once
 
+#ifdef _WIN32
 #include "ResLib/Handle.hpp"
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+#include "ResLib/PendingFile.hpp"
+#include "StringHelper.h"
 #include "Utf8.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
 #include <vector>
 #include <system_error>
 #include <gsl/util>
@@ -22,43 +43,275 @@ public:
 
 	ResUtil() noexcept;
 
+	// "-" reads stdin / writes stdout
+	static bool IsStdio(const char* fileName) noexcept
+	{
+		return fileName[0] == '-' && fileName[1] == '\0';
+	}
+
+#ifdef _WIN32
 	static std::vector<unsigned char> ReadData(const char* fileName)
 	{
+		if (IsStdio(fileName))
+		{
+			_setmode(_fileno(stdin), _O_BINARY);
+			return ReadAll(::GetStdHandle(STD_INPUT_HANDLE));
+		}
+
 		Handle file = { ::CreateFileW(Utf8::ToWide(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
 		if (!file.IsValid())
 		{
 			const auto msg = std::string("Unable to open target file: ") + GetError().message();
 			throw IoException(msg.c_str());
 		}
+		return ReadAll(file);
+	}
+
+	static void WriteData(std::span<const unsigned char> data, const char* fileName)
+	{
+		if (IsStdio(fileName))
+		{
+			std::cout.flush();
+			_setmode(_fileno(stdout), _O_BINARY);
+			WriteAll(::GetStdHandle(STD_OUTPUT_HANDLE), data);
+			return;
+		}
 
-		DWORD size = ::GetFileSize(file, nullptr);
-		auto data = std::vector<unsigned char>(size, 0x00);
-		if (0 == ::ReadFile(file, data.data(), gsl::narrow_cast<DWORD>(data.size()), &size, nullptr))
+		// written next to the target and renamed over it, a device or pipe
+		// directly, see ResLib::PendingFile
+		ResLib::PendingFile pending(fileName, false);
 		{
-			const auto err = GetError();
-			const auto msg = std::string("Unable to read data: ") + err.message();
+			Handle file = { ::CreateFileW(Utf8::ToWide(pending.TempName()).c_str(), GENERIC_WRITE, 0, nullptr, pending.Direct() ? OPEN_EXISTING : TRUNCATE_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+			if (!file.IsValid())
+			{
+				const auto msg = std::string("Unable to open target file: ") + GetError().message();
+				throw IoException(msg.c_str());
+			}
+			WriteAll(file, data);
+		}
+		pending.Commit();
+	}
+
+	// Writes data, which is the mapped range [offset, offset + data.size())
+	// of sourceFile, to fileName. Windows has no file to file/pipe sendfile,
+	// so this writes straight from the mapping.
+	static void WriteFileRange(const char* /*sourceFile*/, uint64_t /*offset*/, std::span<const unsigned char> data, const char* fileName)
+	{
+		WriteData(data, fileName);
+	}
+#else
+	static std::vector<unsigned char> ReadData(const char* fileName)
+	{
+		const bool stdio = IsStdio(fileName);
+		const int file = stdio ? STDIN_FILENO : ::open(fileName, O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+		{
+			const auto msg = std::string("Unable to open target file: ") + GetError().message();
 			throw IoException(msg.c_str());
 		}
 
+		// read() straight into the result, which is sized up front for regular files
+		std::vector<unsigned char> data;
+		struct stat info {};
+		size_t capacity = ::fstat(file, &info) == 0 && S_ISREG(info.st_mode) ? static_cast<size_t>(info.st_size) + 1 : 64 * 1024;
+		size_t size = 0;
+		for (;;)
+		{
+			if (size == data.size()) data.resize(std::max(capacity, 2 * data.size()));
+			const auto bytesRead = ::read(file, data.data() + size, data.size() - size);
+			if (bytesRead == 0) break;
+			if (bytesRead < 0)
+			{
+				if (errno == EINTR) continue;
+				const auto err = GetError();
+				if (!stdio) ::close(file);
+				const auto msg = std::string("Unable to read data: ") + err.message();
+				throw IoException(msg.c_str());
+			}
+			size += static_cast<size_t>(bytesRead);
+		}
+		if (!stdio) ::close(file);
+		data.resize(size);
 		return data;
 	}
 
-	static void WriteData(std::vector<unsigned char> const& data, const char* fileName)
+	static void WriteData(std::span<const unsigned char> data, const char* fileName)
 	{
-		Handle file = { ::CreateFileW(Utf8::ToWide(fileName).c_str(), GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
-		DWORD bytesWritten{ 0 };
-		if (!::WriteFile(file, data.data(), gsl::narrow_cast<DWORD>(data.size()), &bytesWritten, nullptr))
+		WriteFileRange(nullptr, 0, data, fileName);
+	}
+
+	// Writes data, which is the mapped range [offset, offset + data.size())
+	// of sourceFile, to fileName ("-" for stdout). On Linux the bytes are
+	// moved by sendfile from the page cache to the target file or pipe
+	// without passing through user space; if the target doesn't support that
+	// (or there is no sourceFile) they are written from the mapping directly.
+	// A target file is written next to it and renamed over it, a FIFO or
+	// device directly, see ResLib::PendingFile.
+	static void WriteFileRange(const char* sourceFile, uint64_t offset, std::span<const unsigned char> data, const char* fileName)
+	{
+		const bool stdio = IsStdio(fileName);
+		if (stdio) std::cout.flush();
+		std::optional<ResLib::PendingFile> pending;
+		if (!stdio) pending.emplace(fileName, false);
+		const int file = stdio ? STDOUT_FILENO : ::open(pending->TempName().c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+		if (file < 0)
+		{
+			const auto msg = std::string("Unable to write data: ") + GetError().message();
+			throw IoException(msg.c_str());
+		}
+
+		size_t written = 0;
+		bool failed = false;
+#ifdef __linux__
+		if (sourceFile && !data.empty())
+		{
+			const int source = ::open(sourceFile, O_RDONLY | O_CLOEXEC);
+			auto position = static_cast<off_t>(offset);
+			while (source >= 0 && written < data.size())
+			{
+				const auto result = ::sendfile(file, source, &position, std::min<size_t>(data.size() - written, 0x7FFFF000));
+				if (result < 0 && errno == EINTR) continue;
+				if (result <= 0)
+				{
+					// EINVAL/ENOSYS: not supported for this target, anything else is an error
+					failed = result < 0 && errno != EINVAL && errno != ENOSYS;
+					break;
+				}
+				written += static_cast<size_t>(result);
+			}
+			if (source >= 0) ::close(source);
+		}
+#else
+		(void)sourceFile;
+		(void)offset;
+#endif
+		while (!failed && written < data.size())
+		{
+			const auto result = ::write(file, data.data() + written, data.size() - written);
+			if (result < 0 && errno == EINTR) continue;
+			if (result < 0) failed = true;
+			else written += static_cast<size_t>(result);
+		}
+		if (failed)
 		{
 			const auto err = GetError();
+			if (!stdio) ::close(file);
 			const auto msg = std::string("Unable to write data: ") + err.message();
 			throw IoException(msg.c_str());
 		}
+		if (!stdio)
+		{
+			::close(file);
+			pending->Commit();
+		}
+	}
+#endif
+
+	// Expands a file list argument: entries are separated by ';', '@file'
+	// entries name a text file containing one path per line and '*' or '?'
+	// in the file name part match the files of that directory.
+	static std::vector<std::string> ExpandFileList(std::string const& spec)
+	{
+		std::vector<std::string> files;
+		for (auto const& entry : StringHelper::split(spec, ';'))
+		{
+			if (entry.front() != '@')
+			{
+				ExpandWildcards(entry, files);
+				continue;
+			}
+
+			std::ifstream list(entry.substr(1));
+			if (!list)
+			{
+				const auto msg = std::string("Unable to open file list: ") + entry.substr(1);
+				throw IoException(msg.c_str());
+			}
+			for (std::string line; std::getline(list, line);)
+			{
+				while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+				if (!line.empty()) files.emplace_back(std::move(line));
+			}
+		}
+		return files;
 	}
 
 private:
+#ifdef _WIN32
+	static std::vector<unsigned char> ReadAll(HANDLE file)
+	{
+		std::vector<unsigned char> data;
+		LARGE_INTEGER fileSize{};
+		size_t capacity = ::GetFileType(file) == FILE_TYPE_DISK && ::GetFileSizeEx(file, &fileSize) ? gsl::narrow_cast<size_t>(fileSize.QuadPart) + 1 : 64 * 1024;
+		size_t size = 0;
+		for (;;)
+		{
+			if (size == data.size()) data.resize(std::max(capacity, 2 * data.size()));
+			DWORD bytesRead = 0;
+			const auto chunk = gsl::narrow_cast<DWORD>(std::min<size_t>(data.size() - size, 0x40000000));
+			if (!::ReadFile(file, data.data() + size, chunk, &bytesRead, nullptr))
+			{
+				if (::GetLastError() == ERROR_BROKEN_PIPE) break;     // end of a pipe
+				const auto msg = std::string("Unable to read data: ") + GetError().message();
+				throw IoException(msg.c_str());
+			}
+			if (bytesRead == 0) break;
+			size += bytesRead;
+		}
+		data.resize(size);
+		return data;
+	}
+
+	static void WriteAll(HANDLE file, std::span<const unsigned char> data)
+	{
+		for (size_t written = 0; written < data.size();)
+		{
+			DWORD bytesWritten{ 0 };
+			const auto chunk = gsl::narrow_cast<DWORD>(std::min<size_t>(data.size() - written, 0x40000000));
+			if (!::WriteFile(file, data.data() + written, chunk, &bytesWritten, nullptr))
+			{
+				const auto msg = std::string("Unable to write data: ") + GetError().message();
+				throw IoException(msg.c_str());
+			}
+			written += bytesWritten;
+		}
+	}
+#endif
+
+	// Appends the matches sorted by name. A pattern matching nothing is kept
+	// as it is, so that the caller reports the missing file.
+	static void ExpandWildcards(std::string const& path, std::vector<std::string>& files)
+	{
+		const std::filesystem::path pattern(path);
+		const auto name = pattern.filename().string();
+		if (name.find_first_of("*?") == std::string::npos)
+		{
+			files.push_back(path);
+			return;
+		}
+
+		std::vector<std::string> matches;
+		std::error_code ec;
+		const auto directory = pattern.has_parent_path() ? pattern.parent_path() : std::filesystem::path(".");
+		for (auto const& entry : std::filesystem::directory_iterator(directory, ec))
+		{
+			if (StringHelper::wildcardMatch(name, entry.path().filename().string()) && entry.is_regular_file(ec))
+			{
+				matches.push_back(pattern.has_parent_path() ? entry.path().string() : entry.path().filename().string());
+			}
+		}
+		if (matches.empty()) matches.push_back(path);
+		std::sort(matches.begin(), matches.end());
+		files.insert(files.end(), matches.begin(), matches.end());
+	}
+
 	static std::error_code GetError() noexcept
 	{
+#ifdef _WIN32
 		return std::error_code(::GetLastError(), std::system_category());
+#else
+		return std::error_code(errno, std::generic_category());
+#endif
 	}
 };
 
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\ByteSearch.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ByteSearchTest)
+	{
+	public:
+
+		static vector<size_t> FindAll(ByteSearch const& search, vector<unsigned char> const& data)
+		{
+			vector<size_t> result;
+			search.ForEach(data, [&](size_t offset) { result.push_back(offset); return true; });
+			return result;
+		}
+
+		static vector<size_t> FindAllNaive(vector<unsigned char> const& pattern, vector<unsigned char> const& data)
+		{
+			vector<size_t> result;
+			for (size_t i = 0; i + pattern.size() <= data.size(); ++i)
+			{
+				if (equal(pattern.begin(), pattern.end(), data.begin() + i)) result.push_back(i);
+			}
+			return result;
+		}
+
+		TEST_METHOD(ForEach_matches_naive_search)
+		{
+			// small alphabet, so that there are many candidates and overlapping matches
+			vector<unsigned char> data(1000);
+			uint32_t state = 12345;
+			for (auto& b : data)
+			{
+				state = state * 1103515245 + 12345;
+				b = static_cast<unsigned char>('a' + (state >> 16) % 3);
+			}
+
+			for (size_t length : { 1, 2, 3, 5, 16, 17 })
+			{
+				for (size_t start : { 0, 1, 15, 500, 1000 - 17 })
+				{
+					vector<unsigned char> pattern(data.begin() + start, data.begin() + start + length);
+					Assert::IsTrue(FindAll(ByteSearch(pattern), data) == FindAllNaive(pattern, data));
+				}
+			}
+		}
+
+		TEST_METHOD(Find_handles_matches_at_the_end_and_short_data)
+		{
+			const vector<unsigned char> data{ 'x', 'x', 'x', 'a', 'b', 'c' };
+			Assert::AreEqual(size_t{ 3 }, ByteSearch({ 'a', 'b', 'c' }).Find(data));
+			Assert::AreEqual(ByteSearch::npos, ByteSearch({ 'a', 'b', 'c' }).Find(data, 4));
+			Assert::AreEqual(ByteSearch::npos, ByteSearch({ 'x', 'x', 'x', 'a', 'b', 'c', 'd' }).Find(data));
+		}
+	};
+}
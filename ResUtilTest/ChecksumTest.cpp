@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\ImageIntegrity.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ChecksumTest)
+	{
+	public:
+
+		// odd length, so the last byte is summed as a word of its own
+		static vector<unsigned char> MakeData()
+		{
+			vector<unsigned char> data(1001);
+			for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<unsigned char>(i * 7 + 3);
+			Pe::Write<uint32_t>(data, 0x40, 0x12345678);
+			return data;
+		}
+
+		TEST_METHOD(Compute_matches_CheckSumMappedFile)
+		{
+			Assert::AreEqual(0x25C5u, Checksum::Compute(MakeData(), 0x40));
+		}
+
+		TEST_METHOD(Sum_at_odd_offset_matches_bytewise_sum)
+		{
+			const auto data = MakeData();
+			for (size_t offset : { 0, 1, 2, 3 })
+			{
+				for (size_t size : { 0, 1, 15, 16, 17, 33, 1001 })
+				{
+					uint64_t expected = 0;
+					for (size_t i = 0; i < size; ++i) expected += uint64_t{ data[i] } << (8 * ((offset + i) & 1));
+					Assert::AreEqual(static_cast<uint32_t>(expected % 0xFFFF), Checksum::Sum(Pe::Bytes(data).first(size), offset));
+				}
+			}
+		}
+
+		TEST_METHOD(Update_agrees_with_full_computation)
+		{
+			auto data = MakeData();
+			const auto checksum = Checksum::Compute(data, 0x40);
+			Pe::Write<uint32_t>(data, 0x40, checksum);
+
+			const vector<unsigned char> before(data.begin() + 0x101, data.begin() + 0x10A);
+			for (size_t i = 0x101; i < 0x10A; ++i) data[i] ^= 0x5A;
+			const Checksum::Change change{ 0x101, before, Pe::Bytes(data).subspan(0x101, before.size()) };
+
+			auto updated = Checksum::Update(checksum, data.size(), data.size(), 0x40, span<const Checksum::Change>(&change, 1));
+			Assert::IsTrue(updated.has_value());
+			Assert::AreEqual(Checksum::Compute(data, 0x40), *updated);
+
+			// an unset checksum can't be updated
+			Assert::IsFalse(Checksum::Update(0, data.size(), data.size(), 0x40, span<const Checksum::Change>(&change, 1)).has_value());
+		}
+	};
+}
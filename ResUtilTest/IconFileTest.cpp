@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\IconFile.hpp"
+#include "..\ResLib\ResLib.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(IconFileTest)
+	{
+	public:
+
+		// .ico with two images of 4 and 2 bytes
+		static vector<unsigned char> MakeIcoFile()
+		{
+			vector<unsigned char> ico(Icons::DirHeaderSize + 2 * Icons::FileEntrySize);
+			Pe::Write<uint16_t>(ico, 2, Icons::IconType);
+			Pe::Write<uint16_t>(ico, 4, 2);
+			const uint32_t firstOffset = static_cast<uint32_t>(ico.size());
+			Pe::Write<uint8_t>(ico, 6, 16);
+			Pe::Write<uint8_t>(ico, 7, 16);
+			Pe::Write<uint16_t>(ico, 10, 1);
+			Pe::Write<uint16_t>(ico, 12, 32);
+			Pe::Write<uint32_t>(ico, 14, 4);
+			Pe::Write<uint32_t>(ico, 18, firstOffset);
+			Pe::Write<uint16_t>(ico, 26, 1);
+			Pe::Write<uint16_t>(ico, 28, 32);
+			Pe::Write<uint32_t>(ico, 30, 2);
+			Pe::Write<uint32_t>(ico, 34, firstOffset + 4);
+			ico.insert(ico.end(), { 1, 2, 3, 4, 5, 6 });
+			return ico;
+		}
+
+		TEST_METHOD(ParseIcoFile_returns_all_images)
+		{
+			auto ico = MakeIcoFile();
+			auto images = Icons::ParseIcoFile(ico);
+			Assert::IsTrue(images.size() == 2);
+			Assert::IsTrue(images[0].width == 16 && images[0].bitCount == 32 && images[0].data.size() == 4);
+			Assert::IsTrue(images[1].width == 0 && images[1].data.size() == 2 && images[1].data[0] == 5);
+		}
+
+		TEST_METHOD(ParseIcoFile_rejects_truncated_image)
+		{
+			auto ico = MakeIcoFile();
+			ico.pop_back();
+			Assert::ExpectException<InvalidFileException>([&] { Icons::ParseIcoFile(ico); });
+		}
+
+		TEST_METHOD(BuildGroup_and_ParseGroup_roundtrip)
+		{
+			vector<Icons::GroupEntry> entries(2);
+			entries[0].width = 32;
+			entries[0].bitCount = 32;
+			entries[0].bytesInRes = 1234;
+			entries[0].id = 7;
+			entries[1].id = 9;
+
+			auto group = Icons::BuildGroup(entries);
+			Assert::IsTrue(group.size() == Icons::DirHeaderSize + 2 * Icons::GroupEntrySize);
+
+			auto parsed = Icons::ParseGroup(group);
+			Assert::IsTrue(parsed.size() == 2);
+			Assert::IsTrue(parsed[0].width == 32 && parsed[0].bytesInRes == 1234 && parsed[0].id == 7);
+			Assert::IsTrue(parsed[1].id == 9);
+		}
+
+		TEST_METHOD(WriteIcon_shares_images_between_groups)
+		{
+			ResourceTable table;
+			const unsigned char payload[]{ 'x' };
+			table.Set(ResId(10), ResId(1), 0, Pe::Bytes(payload, sizeof(payload)));
+			const auto path = (filesystem::temp_directory_path() / "IconFileTest.dll").string();
+			{
+				const auto image = CreateResourceImage(table);
+				ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			}
+
+			const auto ico = MakeIcoFile();
+			const auto first = WriteIcon(ico, path.c_str(), "1", 0);
+			Assert::AreEqual(size_t{ 2 }, first.added);
+			const auto second = WriteIcon(ico, path.c_str(), "2", 0);
+			Assert::AreEqual(size_t{ 0 }, second.added);
+			Assert::AreEqual(size_t{ 2 }, second.reused);
+
+			MappedFile file(path.c_str());
+			Pe::Image image(file.Data());
+			ResourceDirectory resources(image);
+			size_t icons = 0;
+			resources.ForEachOfType(ResId(3), [&](ResourceEntry const&) { ++icons; return true; });
+			Assert::AreEqual(size_t{ 2 }, icons);
+
+			auto groupOf = [&](uint16_t id) { return Icons::ParseGroup(resources.GetData(*resources.Find(ResId(14), ResId(id)))); };
+			const auto group1 = groupOf(1);
+			const auto group2 = groupOf(2);
+			Assert::IsTrue(group1.size() == 2 && group2.size() == 2);
+			Assert::IsTrue(group1[0].id == group2[0].id && group1[1].id == group2[1].id);
+		}
+	};
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\MessageTable.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(MessageTableTest)
+	{
+	public:
+
+		static void AddEntry(vector<unsigned char>& data, uint16_t flags, vector<unsigned char> const& text)
+		{
+			const auto offset = data.size();
+			data.resize(offset + 4);
+			Pe::Write<uint16_t>(data, offset, static_cast<uint16_t>(4 + text.size()));
+			Pe::Write<uint16_t>(data, offset + 2, flags);
+			data.insert(data.end(), text.begin(), text.end());
+		}
+
+		// blocks stored out of order: 0xC0000005 (UTF-16) and 100..101 (ANSI, UTF-8)
+		static vector<unsigned char> MakeMessageTable()
+		{
+			vector<unsigned char> data(4 + 2 * 12);
+			Pe::Write<uint32_t>(data, 0, 2);
+			Pe::Write<uint32_t>(data, 4, 0xC0000005);
+			Pe::Write<uint32_t>(data, 8, 0xC0000005);
+			Pe::Write<uint32_t>(data, 12, static_cast<uint32_t>(data.size()));
+			AddEntry(data, MessageTable::UnicodeFlag, { 'A', 0, 'V', 0, 0, 0, 0, 0 });
+
+			Pe::Write<uint32_t>(data, 16, 100);
+			Pe::Write<uint32_t>(data, 20, 101);
+			Pe::Write<uint32_t>(data, 24, static_cast<uint32_t>(data.size()));
+			AddEntry(data, MessageTable::AnsiFlag, { 'c', 'a', 'f', 0xE9, 0, 0, 0, 0 });
+			AddEntry(data, MessageTable::Utf8Flag, { 'o', 'k', 0, 0 });
+			return data;
+		}
+
+		TEST_METHOD(Find_decodes_all_encodings)
+		{
+			auto data = MakeMessageTable();
+			MessageTable table(data);
+			Assert::IsTrue(table.Size() == 3);
+			Assert::AreEqual("AV", table.Find(0xC0000005)->c_str());
+			Assert::AreEqual("caf\xC3\xA9", table.Find(100)->c_str());
+			Assert::AreEqual("ok", table.Find(101)->c_str());
+		}
+
+		TEST_METHOD(Find_returns_nothing_for_gaps)
+		{
+			auto data = MakeMessageTable();
+			MessageTable table(data);
+			Assert::IsFalse(table.Find(99).has_value());
+			Assert::IsFalse(table.Find(102).has_value());
+			Assert::IsFalse(table.Find(0xC0000004).has_value());
+		}
+
+		TEST_METHOD(Constructor_rejects_truncated_entries)
+		{
+			auto data = MakeMessageTable();
+			data.resize(data.size() - 2);
+			Assert::ExpectException<InvalidResourceException>([&] { MessageTable table(data); });
+		}
+
+		TEST_METHOD(Constructor_rejects_overlapping_blocks)
+		{
+			// 100..101 and 101..101 on the same entries
+			auto data = MakeMessageTable();
+			data.insert(data.begin() + 28, 12, 0);
+			Pe::Write<uint32_t>(data, 0, 3);
+			for (size_t offset = 12; offset <= 24; offset += 12) Pe::Write<uint32_t>(data, offset, Pe::Read<uint32_t>(data, offset) + 12);
+			Pe::Write<uint32_t>(data, 28, 101);
+			Pe::Write<uint32_t>(data, 32, 101);
+			Pe::Write<uint32_t>(data, 36, Pe::Read<uint32_t>(data, 24));
+			Assert::ExpectException<InvalidResourceException>([&] { MessageTable table(data); });
+
+			// the second block moved past the first: accepted
+			Pe::Write<uint32_t>(data, 28, 102);
+			Pe::Write<uint32_t>(data, 32, 102);
+			Assert::IsTrue(MessageTable(data).Find(102) == MessageTable(data).Find(100));
+		}
+
+		TEST_METHOD(Constructor_rejects_more_entries_than_fit)
+		{
+			// a range of 2^20 ids in a table of a few dozen bytes
+			auto data = MakeMessageTable();
+			Pe::Write<uint32_t>(data, 20, 100 + (1u << 20));
+			Assert::ExpectException<InvalidResourceException>([&] { MessageTable table(data); });
+		}
+	};
+}
@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\NameList.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(NameListTest)
+	{
+	public:
+
+		TEST_METHOD(NameList_keeps_ids_and_names_in_order)
+		{
+			NameList list;
+			list.Add(uint16_t{ 7 });
+			list.Add(u"ABOUT");
+			list.Add(string_view("Main"));
+			list.Add(uint16_t{ 65535 });
+
+			Assert::AreEqual(size_t{ 4 }, list.Size());
+			Assert::IsTrue(list[0].IsId() && list[0].id == 7);
+			Assert::IsTrue(!list[1].IsId() && list[1].name == "ABOUT");
+			Assert::IsTrue(list[2].name == "Main");
+			Assert::IsTrue(list[3].IsId() && list[3].id == 65535);
+
+			const vector<string> expected{ "7", "ABOUT", "Main", "65535" };
+			Assert::IsTrue(list.ToStrings() == expected);
+		}
+
+		TEST_METHOD(NameList_converts_utf16_names)
+		{
+			const char16_t name[] = { 0xE4, 0x20AC, 0 };   // a-umlaut, euro sign
+			const string expected{ char(0xC3), char(0xA4), char(0xE2), char(0x82), char(0xAC) };
+			NameList list;
+			list.Add(u16string_view(name));
+			list.Add(u"x");
+			Assert::IsTrue(list[0].name == expected);
+			Assert::IsTrue(list[1].name == "x");
+		}
+
+		TEST_METHOD(NameList_formats_predefined_types_by_name)
+		{
+			NameList list;
+			list.Add(uint16_t{ 16 });
+			list.Add(uint16_t{ 4711 });
+			list.Add(u"CUSTOM");
+			const vector<string> expected{ "version", "4711", "CUSTOM" };
+			Assert::IsTrue(list.ToTypeStrings() == expected);
+		}
+	};
+}
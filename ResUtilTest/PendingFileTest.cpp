@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\PendingFile.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(PendingFileTest)
+	{
+	public:
+
+		static string TempFile(const char* name, const char* content)
+		{
+			const auto path = (filesystem::temp_directory_path() / name).string();
+			ofstream(path, ios::binary) << content;
+			return path;
+		}
+
+		static string Content(string const& path)
+		{
+			ifstream file(path, ios::binary);
+			return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		}
+
+		TEST_METHOD(Commit_replaces_target_and_abandoned_file_is_removed)
+		{
+			const auto target = TempFile("PendingFileTest.bin", "old");
+			string tempName;
+			{
+				PendingFile pending(target, false);
+				tempName = pending.TempName();
+				Assert::IsFalse(pending.Cloned());
+				ofstream(tempName, ios::binary) << "discarded";
+			}
+			Assert::IsFalse(filesystem::exists(tempName));
+			Assert::IsTrue(Content(target) == "old");
+
+			PendingFile pending(target);
+			ofstream(pending.TempName(), ios::binary | ios::trunc) << "new";
+			Assert::IsTrue(Content(target) == "old");
+			pending.Commit();
+			Assert::IsTrue(Content(target) == "new");
+			Assert::IsFalse(filesystem::exists(pending.TempName()));
+			filesystem::remove(target);
+		}
+
+		TEST_METHOD(SyncBatch_replaces_all_files)
+		{
+			vector<string> targets;
+			SyncBatch batch;
+			for (auto name : { "PendingFileTest1.bin", "PendingFileTest2.bin", "PendingFileTest3.bin" })
+			{
+				targets.push_back(TempFile(name, "old"));
+				PendingFile pending(targets.back(), false);
+				ofstream(pending.TempName(), ios::binary) << name;
+				batch.Add(move(pending));
+			}
+			Assert::AreEqual(size_t{ 3 }, batch.Size());
+
+			const auto errors = batch.Commit();
+			Assert::AreEqual(size_t{ 3 }, errors.size());
+			for (size_t i = 0; i < targets.size(); ++i)
+			{
+				Assert::IsTrue(errors[i].empty());
+				Assert::IsTrue(Content(targets[i]) == filesystem::path(targets[i]).filename().string());
+				filesystem::remove(targets[i]);
+			}
+		}
+
+#ifndef _WIN32
+		TEST_METHOD(Fifo_target_is_written_directly)
+		{
+			const auto target = (filesystem::temp_directory_path() / "PendingFileTest.fifo").string();
+			filesystem::remove(target);
+			Assert::AreEqual(0, ::mkfifo(target.c_str(), 0600));
+			{
+				PendingFile pending(target, true);
+				Assert::IsTrue(pending.Direct());
+				Assert::IsFalse(pending.Cloned());
+				Assert::AreEqual(target, pending.TempName());
+			}
+			Assert::IsTrue(filesystem::is_fifo(target));
+
+			PendingFile pending(target);
+			pending.Commit();
+			Assert::IsTrue(filesystem::is_fifo(target));
+			filesystem::remove(target);
+		}
+#endif
+	};
+}
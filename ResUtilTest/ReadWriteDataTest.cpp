@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResUtil.h"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ReadWriteDataTest)
+	{
+	public:
+
+		static string TempFile(const char* name, string const& content)
+		{
+			const auto path = (filesystem::temp_directory_path() / name).string();
+			ofstream(path, ios::binary | ios::trunc) << content;
+			return path;
+		}
+
+		static string Content(string const& path)
+		{
+			ifstream in(path, ios::binary);
+			return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		}
+
+		static span<const unsigned char> Span(string const& text, size_t offset, size_t size)
+		{
+			return span<const unsigned char>(reinterpret_cast<const unsigned char*>(text.data()) + offset, size);
+		}
+
+		TEST_METHOD(ReadData_reads_whole_files)
+		{
+			Assert::IsTrue(ResUtil::ReadData(TempFile("ReadWriteDataTest.empty", "").c_str()).empty());
+
+			// more than one read
+			string large(300000, 'x');
+			large[299999] = 'y';
+			const auto data = ResUtil::ReadData(TempFile("ReadWriteDataTest.large", large).c_str());
+			Assert::IsTrue(large == string(data.begin(), data.end()));
+
+			Assert::ExpectException<ResUtil::IoException>([] { ResUtil::ReadData((filesystem::temp_directory_path() / "ReadWriteDataTest.missing").string().c_str()); });
+		}
+
+		TEST_METHOD(WriteFileRange_writes_a_partial_range)
+		{
+			const string content("0123456789");
+			const auto source = TempFile("ReadWriteDataTest.source", content);
+			const auto target = TempFile("ReadWriteDataTest.target", "previous, longer content");
+
+			ResUtil::WriteFileRange(source.c_str(), 3, Span(content, 3, 4), target.c_str());
+			Assert::AreEqual(string("3456"), Content(target));
+			ResUtil::WriteFileRange(source.c_str(), 0, Span(content, 0, content.size()), target.c_str());
+			Assert::AreEqual(content, Content(target));
+			ResUtil::WriteFileRange(source.c_str(), 9, Span(content, 9, 0), target.c_str());
+			Assert::AreEqual(string(), Content(target));
+		}
+
+		TEST_METHOD(WriteFileRange_writes_the_data_where_the_source_ends)
+		{
+			const auto source = TempFile("ReadWriteDataTest.source", "0123456789");
+			const auto target = (filesystem::temp_directory_path() / "ReadWriteDataTest.target").string();
+
+			// the source was truncated after mapping: what is left of it, then the rest of the data
+			const string data("89AB");
+			ResUtil::WriteFileRange(source.c_str(), 8, Span(data, 0, data.size()), target.c_str());
+			Assert::AreEqual(data, Content(target));
+
+			// an offset beyond the source end, and no source at all
+			ResUtil::WriteFileRange(source.c_str(), 100, Span(data, 0, data.size()), target.c_str());
+			Assert::AreEqual(data, Content(target));
+			ResUtil::WriteFileRange(nullptr, 0, Span(data, 1, 2), target.c_str());
+			Assert::AreEqual(string("9A"), Content(target));
+		}
+
+#ifndef _WIN32
+		TEST_METHOD(WriteFileRange_writes_into_a_fifo)
+		{
+			const string content("0123456789");
+			const auto source = TempFile("ReadWriteDataTest.source", content);
+			const auto fifo = (filesystem::temp_directory_path() / "ReadWriteDataTest.fifo").string();
+			filesystem::remove(fifo);
+			Assert::AreEqual(0, ::mkfifo(fifo.c_str(), 0600));
+
+			string received;
+			thread reader([&] { received = Content(fifo); });
+			ResUtil::WriteFileRange(source.c_str(), 2, Span(content, 2, 5), fifo.c_str());
+			reader.join();
+			Assert::AreEqual(string("23456"), received);
+			Assert::IsTrue(filesystem::is_fifo(fifo));
+			filesystem::remove(fifo);
+		}
+#endif
+	};
+}
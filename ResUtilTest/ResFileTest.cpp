@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResFile.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResFileTest)
+	{
+	public:
+
+		TEST_METHOD(Export_and_ForEach_round_trip_ids_and_names)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(u"CONFIG"), 1033, AsBytes("abc"));
+			table.Set(ResId(u"MYTYPE"), ResId(7), 0, AsBytes("payload"));
+			table.Set(ResId(u"MYTYPE"), ResId(u"123"), 0, AsBytes("x"));
+			const auto file = CreateResourceImage(table);
+			Pe::Image image(file);
+
+			const auto res = ResFile::Export(ResourceDirectory(image));
+			Assert::AreEqual(size_t{ 0 }, res.size() % 4);
+			Assert::AreEqual(0u, Pe::Read<uint32_t>(res, 0));      // leading empty record
+			Assert::AreEqual(32u, Pe::Read<uint32_t>(res, 4));
+
+			ResourceTable imported;
+			size_t count = 0;
+			ResFile::ForEach(res, [&](ResFile::Record const& record)
+			{
+				Assert::AreEqual(ResFile::DefaultMemoryFlags, record.memoryFlags);
+				imported.Set(record.type, record.name, record.lang, record.data);
+				++count;
+				return true;
+			});
+			Assert::AreEqual(size_t{ 3 }, count);
+			Assert::IsTrue(CreateResourceImage(imported) == file);
+
+			// a string name of digits stays a string
+			auto item = imported.Find(ResId(u"MYTYPE"), ResId(u"123"), 0);
+			Assert::IsNotNull(item);
+			Assert::IsNull(imported.Find(ResId(u"MYTYPE"), ResId(123), 0));
+		}
+
+		TEST_METHOD(ForEach_rejects_truncated_records)
+		{
+			vector<unsigned char> res;
+			ResFile::Append(res, ResFile::Record{ ResId(10), ResId(u"NAME"), 0, 0x30, 0, 0, 0, AsBytes("data") });
+			for (size_t size : { res.size() - 1, size_t{ 20 }, size_t{ 6 } })
+			{
+				const Pe::Bytes truncated(res.data(), size);
+				Assert::ExpectException<InvalidFileException>([&] { ResFile::ForEach(truncated, [](ResFile::Record const&) { return true; }); });
+			}
+		}
+	};
+}
@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResPatch.hpp"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResPatchTest)
+	{
+	public:
+
+		static vector<unsigned char> WriteBundle(vector<ResPatch::Op> const& ops)
+		{
+			ostringstream out(ios::binary);
+			const auto size = ResPatch::Write(out, ops);
+			const auto bytes = out.str();
+			Assert::AreEqual(size_t(size), bytes.size());
+			return vector<unsigned char>(bytes.begin(), bytes.end());
+		}
+
+		TEST_METHOD(Lz_round_trips_and_rejects_corrupt_input)
+		{
+			string text;
+			for (int i = 0; i < 200; ++i) text += "<assembly name='Contoso.App' version='" + to_string(i) + "'/>";
+			const auto compressed = Lz::Compress(AsBytes(text.c_str()));
+			Assert::IsTrue(compressed.size() < text.size() / 4);
+
+			vector<unsigned char> data(text.size());
+			Lz::Decompress(compressed, data);
+			Assert::IsTrue(string(data.begin(), data.end()) == text);
+
+			// random bytes don't compress, short input has literals only
+			vector<unsigned char> noise(1000);
+			uint32_t state = 1;
+			for (auto& b : noise) b = static_cast<unsigned char>((state = state * 1103515245u + 12345u) >> 24);
+			for (size_t size : { size_t{ 0 }, size_t{ 3 }, noise.size() })
+			{
+				const Pe::Bytes input(noise.data(), size);
+				vector<unsigned char> output(size);
+				Lz::Decompress(Lz::Compress(input), output);
+				Assert::IsTrue(equal(output.begin(), output.end(), input.begin(), input.end()));
+			}
+
+			vector<unsigned char> shorter(text.size() - 1);
+			Assert::ExpectException<InvalidFileException>([&] { Lz::Decompress(compressed, shorter); });
+			auto corrupt = compressed;
+			corrupt[compressed.size() / 2] ^= 0xFF;
+			Assert::ExpectException<InvalidFileException>([&] { Lz::Decompress(Pe::Bytes(corrupt.data(), corrupt.size() - 1), data); });
+		}
+
+		TEST_METHOD(Bundle_round_trips_the_changes_between_two_builds)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(u"CONFIG"), 1033, AsBytes("old config"));
+			table.Set(ResId(10), ResId(u"SAME"), 1033, AsBytes("unchanged"));
+			table.Set(ResId(u"CERT"), ResId(1), 0, AsBytes("old certificate"));
+			const auto oldFile = CreateResourceImage(table);
+			auto other = table;
+
+			table.Set(ResId(10), ResId(u"CONFIG"), 1033, AsBytes("new config, new config, new config, new config"));
+			table.Remove(ResId(u"CERT"), ResId(1), 0);
+			table.Set(ResId(u"CERT"), ResId(2), 0, AsBytes("new certificate"));
+			const auto newFile = CreateResourceImage(table);
+
+			Pe::Image oldImage(oldFile);
+			Pe::Image newImage(newFile);
+			const auto ops = ResPatch::MakePatch(ResourceDirectory(oldImage), ResourceDirectory(newImage));
+			Assert::AreEqual(size_t{ 3 }, ops.size());
+
+			const auto file = WriteBundle(ops);
+			ResPatch::Bundle bundle(file);
+			Assert::AreEqual(ops.size(), bundle.Ops().size());
+			for (size_t i = 0; i < ops.size(); ++i)
+			{
+				auto const& op = bundle.Ops()[i];
+				Assert::IsTrue(op.kind == ops[i].kind && op.expect == ops[i].expect && op.type == ops[i].type && op.name == ops[i].name && op.lang == ops[i].lang);
+				if (op.kind == ResPatch::OpKind::Remove) continue;
+				const auto data = bundle.Data(op);
+				Assert::IsTrue(equal(data.begin(), data.end(), ops[i].payload.begin(), ops[i].payload.end()));
+			}
+			const auto config = find_if(bundle.Ops().begin(), bundle.Ops().end(), [](ResPatch::Op const& op) { return op.name == ResId(u"CONFIG"); });
+			Assert::IsTrue(config->compression == ResPatch::Compression::Lz && config->expect == ResPatch::Expect::Hash);
+
+			string message;
+			Assert::IsTrue(ResPatch::Check(ResourceDirectory(oldImage), bundle.Ops(), &message) == ResPatch::TargetState::Old);
+			Assert::IsTrue(ResPatch::Check(ResourceDirectory(newImage), bundle.Ops()) == ResPatch::TargetState::Patched);
+
+			other.Set(ResId(10), ResId(u"CONFIG"), 1033, AsBytes("local config"));
+			const auto otherFile = CreateResourceImage(other);
+			Pe::Image otherImage(otherFile);
+			Assert::IsTrue(ResPatch::Check(ResourceDirectory(otherImage), bundle.Ops(), &message) == ResPatch::TargetState::Mismatch);
+			Assert::AreEqual(string("rcdata/CONFIG/1033 has different content"), message);
+		}
+
+		TEST_METHOD(Bundle_rejects_corrupt_tables_and_payloads)
+		{
+			const ResPatch::Op op{ ResPatch::OpKind::Set, ResId(10), ResId(u"DATA"), 0, ResPatch::Expect::Absent, 0, 0, 0, 0, ResPatch::Compression::None, AsBytes("payload") };
+			const auto file = WriteBundle({ op });
+			Assert::AreEqual(size_t{ 1 }, ResPatch::Bundle(file).Ops().size());
+
+			auto table = file;
+			table[ResPatch::HeaderSize + 12] ^= 1;
+			Assert::ExpectException<InvalidFileException>([&] { ResPatch::Bundle bundle(table); });
+			const Pe::Bytes truncated(file.data(), file.size() - 1);
+			Assert::ExpectException<InvalidFileException>([&] { ResPatch::Bundle bundle(truncated); });
+
+			auto payload = file;
+			payload.back() ^= 1;
+			ResPatch::Bundle bundle(payload);
+			Assert::ExpectException<InvalidFileException>([&] { bundle.Data(bundle.Ops()[0]); });
+		}
+	};
+}
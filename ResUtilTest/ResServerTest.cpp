@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#ifndef _WIN32
+#include "..\ResServer.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResServerTest)
+	{
+	public:
+
+		static void AddString(vector<unsigned char>& frame, string const& value)
+		{
+			frame.push_back(static_cast<unsigned char>(value.size()));
+			frame.push_back(static_cast<unsigned char>(value.size() >> 8));
+			frame.insert(frame.end(), value.begin(), value.end());
+		}
+
+		static int Connect(string const& socketPath)
+		{
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			strcpy(address.sun_path, socketPath.c_str());
+			for (int attempt = 0; attempt < 200; ++attempt)
+			{
+				const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+				if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+				{
+					timeval timeout{ 5, 0 };
+					::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+					return fd;
+				}
+				::close(fd);
+				this_thread::sleep_for(chrono::milliseconds(10));
+			}
+			Assert::Fail(L"server not listening");
+			return -1;
+		}
+
+		// sends a read request, returns status and payload of the response
+		static pair<int, string> Read(int fd, string const& file, string const& type, string const& name)
+		{
+			vector<unsigned char> frame(4);
+			frame.push_back(static_cast<unsigned char>(ResServer::Op::Read));
+			AddString(frame, file);
+			AddString(frame, type);
+			AddString(frame, name);
+			frame.insert(frame.end(), { 0xFF, 0xFF });
+			Pe::Write<uint32_t>(frame, 0, static_cast<uint32_t>(frame.size() - 4));
+			Assert::AreEqual(static_cast<ssize_t>(frame.size()), ::send(fd, frame.data(), frame.size(), MSG_NOSIGNAL));
+
+			unsigned char header[5];
+			Assert::AreEqual(ssize_t{ 5 }, ::recv(fd, header, sizeof(header), MSG_WAITALL));
+			string payload(Pe::Read<uint32_t>(Pe::Bytes(header, 4), 0) - 1, char{});
+			if (!payload.empty()) Assert::AreEqual(static_cast<ssize_t>(payload.size()), ::recv(fd, payload.data(), payload.size(), MSG_WAITALL));
+			return { header[4], payload };
+		}
+
+		TEST_METHOD(Idle_connections_dont_hold_workers)
+		{
+			ResourceTable table;
+			const unsigned char hello[]{ 'h', 'e', 'l', 'l', 'o' };
+			table.Set(ResId(10), ResId(1), 0, Pe::Bytes(hello, sizeof(hello)));
+			const auto path = (filesystem::temp_directory_path() / "ResServerTest.dll").string();
+			{
+				const auto image = CreateResourceImage(table);
+				ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			}
+
+			ResServer::Options options;
+			options.socketPath = (filesystem::temp_directory_path() / "ResServerTest.sock").string();
+			options.threads = 1;
+			ResServer server(options);
+			thread serving([&] { server.Run(); });
+
+			// with a single worker, two idle keep-alive clients must not block a third
+			const int idle1 = Connect(options.socketPath);
+			const int idle2 = Connect(options.socketPath);
+			const int client = Connect(options.socketPath);
+			for (int i = 0; i < 2; ++i)
+			{
+				const auto response = Read(client, path, "rcdata", "1");
+				Assert::AreEqual(0, response.first);
+				Assert::AreEqual(string("hello"), response.second);
+			}
+			Assert::AreEqual(1, Read(idle1, path, "rcdata", "2").first);   // not found
+
+			server.Stop();
+			serving.join();
+			Assert::AreEqual(size_t{ 3 }, server.Requests());
+			for (auto fd : { idle1, idle2, client }) ::close(fd);
+		}
+
+		TEST_METHOD(Clients_that_stop_reading_dont_hold_workers)
+		{
+			// a response much larger than the socket buffers
+			ResourceTable table;
+			const vector<unsigned char> large(16 * 1024 * 1024, 'x');
+			table.Set(ResId(10), ResId(1), 0, Pe::Bytes(large.data(), large.size()));
+			const unsigned char hello[]{ 'h', 'e', 'l', 'l', 'o' };
+			table.Set(ResId(10), ResId(2), 0, Pe::Bytes(hello, sizeof(hello)));
+			const auto path = (filesystem::temp_directory_path() / "ResServerTest2.dll").string();
+			{
+				const auto image = CreateResourceImage(table);
+				ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			}
+
+			ResServer::Options options;
+			options.socketPath = (filesystem::temp_directory_path() / "ResServerTest2.sock").string();
+			options.threads = 1;
+			ResServer server(options);
+			thread serving([&] { server.Run(); });
+
+			// requests the large resource and never reads the response
+			const int stalled = Connect(options.socketPath);
+			vector<unsigned char> frame(4);
+			frame.push_back(static_cast<unsigned char>(ResServer::Op::Read));
+			AddString(frame, path);
+			AddString(frame, "rcdata");
+			AddString(frame, "1");
+			frame.insert(frame.end(), { 0xFF, 0xFF });
+			Pe::Write<uint32_t>(frame, 0, static_cast<uint32_t>(frame.size() - 4));
+			Assert::AreEqual(static_cast<ssize_t>(frame.size()), ::send(stalled, frame.data(), frame.size(), MSG_NOSIGNAL));
+
+			// the only worker drops it after SendTimeoutSeconds and serves the next client
+			const int client = Connect(options.socketPath);
+			timeval timeout{ ResServer::SendTimeoutSeconds + 5, 0 };
+			::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			const auto response = Read(client, path, "rcdata", "2");
+			Assert::AreEqual(0, response.first);
+			Assert::AreEqual(string("hello"), response.second);
+
+			server.Stop();
+			serving.join();
+			for (auto fd : { stalled, client }) ::close(fd);
+		}
+	};
+}
+#endif
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResStore.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResStoreTest)
+	{
+	public:
+
+		static string WriteImage(string const& name, ResourceTable const& table)
+		{
+			const auto path = (filesystem::temp_directory_path() / name).string();
+			const auto image = CreateResourceImage(table);
+			ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			return path;
+		}
+
+		static filesystem::path EmptyStore(const char* name)
+		{
+			const auto root = filesystem::temp_directory_path() / name;
+			filesystem::remove_all(root);
+			return root;
+		}
+
+		TEST_METHOD(Encode_and_Decode_round_trip)
+		{
+			Assert::AreEqual(string("#5"), ResStore::Encode(ResId(5)));
+			Assert::AreEqual(string("5"), ResStore::Encode(ResId(u"5")));
+			Assert::AreEqual(string("%235"), ResStore::Encode(ResId(u"#5")));
+			Assert::AreEqual(string("A#B%25C%09D%0A"), ResStore::Encode(ResId(u"A#B%C\tD\n")));
+
+			for (auto const& id : { ResId(5), ResId(u"5"), ResId(u"#5"), ResId(u"A#B%C\tD\r\n"), ResId(u"CONFIG") })
+			{
+				Assert::IsTrue(id == ResStore::Decode(ResStore::Encode(id)));
+			}
+			Assert::ExpectException<std::invalid_argument>([] { ResStore::Decode(""); });
+		}
+
+		TEST_METHOD(Archive_stores_equal_content_once)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 1033, AsBytes("first"));
+			table.Set(ResId(10), ResId(2), 1033, AsBytes("second"));
+			table.Set(ResId(10), ResId(u"SAME"), 1033, AsBytes("first"));
+			const auto path = WriteImage("ResStoreTest1.dll", table);
+			const auto root = EmptyStore("ResStoreTest1");
+
+			ResStore::ArchiveResult first;
+			{
+				ResStore store(root);
+				first = store.Archive(path, "1");
+				Assert::AreEqual(size_t{ 3 }, first.resources);
+				Assert::AreEqual(size_t{ 2 }, first.newBlobs);
+				Assert::AreEqual(size_t{ 0 }, store.Archive(path, "2").newBlobs);
+			}
+			ResStore store(root);
+			Assert::AreEqual(size_t{ 0 }, store.Archive(path, "3").newBlobs);
+
+			const auto entries = store.ReadIndex(first.index);
+			Assert::AreEqual(size_t{ 3 }, entries.size());
+			for (auto const& entry : entries)
+			{
+				const auto data = store.ReadBlob(entry.blob);
+				Assert::AreEqual(string(entry.name == ResId(2) ? "second" : "first"), string(data.begin(), data.end()));
+			}
+		}
+
+		TEST_METHOD(Archive_rejects_another_file_under_the_same_index)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 1033, AsBytes("data"));
+			const auto path = WriteImage("ResStoreTest2.dll", table);
+			const auto root = EmptyStore("ResStoreTest2");
+			ResStore store(root);
+			const auto result = store.Archive(path, "1");
+
+			// another file with the index of the first
+			const auto index = root / "index" / (result.index + ".idx");
+			string text;
+			{
+				ifstream in(index);
+				text.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+			}
+			const auto pos = text.find("# file: ") + 8;
+			text.insert(pos, "/elsewhere");
+			ofstream(index, ios::trunc) << text;
+			Assert::ExpectException<ResUtil::IoException>([&] { store.Archive(path, "1"); });
+			Assert::AreEqual(size_t{ 1 }, store.Archive(path, "2").resources);
+		}
+
+		TEST_METHOD(Torn_blob_records_are_ignored)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 1033, AsBytes("first"));
+			table.Set(ResId(10), ResId(2), 1033, AsBytes("second"));
+			const auto path = WriteImage("ResStoreTest3.dll", table);
+			const auto root = EmptyStore("ResStoreTest3");
+			ResStore(root).Archive(path, "1");
+
+			// an interrupted run: half a record, and a whole one whose data never reached the pack
+			{
+				ofstream out(root / "blobs.idx", ios::binary | ios::app);
+				vector<char> record(ResStore::BlobRecordSize, 'x');
+				out.write(record.data(), static_cast<streamsize>(record.size()));
+				out.write(record.data(), static_cast<streamsize>(record.size() / 2));
+			}
+			ResStore::ArchiveResult result;
+			{
+				ResStore store(root);
+				Assert::AreEqual(size_t{ 2 }, store.BlobCount());
+
+				// new records start on a record boundary and survive reopening
+				table.Set(ResId(10), ResId(3), 1033, AsBytes("third"));
+				result = store.Archive(WriteImage("ResStoreTest3.dll", table), "2");
+				Assert::AreEqual(size_t{ 1 }, result.newBlobs);
+			}
+			ResStore reopened(root);
+			Assert::AreEqual(size_t{ 3 }, reopened.BlobCount());
+			for (auto const& entry : reopened.ReadIndex(result.index)) reopened.ReadBlob(entry.blob);
+		}
+
+		TEST_METHOD(A_store_is_open_in_one_place_at_a_time)
+		{
+			const auto root = EmptyStore("ResStoreTest4");
+			atomic<bool> opened{ false };
+			thread second;
+			{
+				ResStore store(root);
+				second = thread([&] { ResStore other(root); opened = true; });
+				this_thread::sleep_for(chrono::milliseconds(200));
+				Assert::IsFalse(opened);
+			}
+			second.join();
+			Assert::IsTrue(opened);
+		}
+	};
+}
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResourceWriter.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResourceDirectoryTest)
+	{
+	public:
+
+		// PE32 headers without sections plus the resources of the table
+		static vector<unsigned char> MakeImage(ResourceTable const& table)
+		{
+			vector<unsigned char> image(0x200);
+			Pe::Write<uint16_t>(image, 0, Pe::DosSignature);
+			Pe::Write<uint32_t>(image, 0x3C, 0x80);
+			Pe::Write<uint32_t>(image, 0x80, Pe::NtSignature);
+			Pe::Write<uint16_t>(image, 0x94, 224);          // SizeOfOptionalHeader
+			Pe::Write<uint16_t>(image, 0x98, Pe::Pe32Magic);
+			Pe::Write<uint32_t>(image, 0x98 + 32, 0x1000);  // SectionAlignment
+			Pe::Write<uint32_t>(image, 0x98 + 36, 0x200);   // FileAlignment
+			Pe::Write<uint32_t>(image, 0x98 + 56, 0x1000);  // SizeOfImage
+			Pe::Write<uint32_t>(image, 0x98 + 60, 0x200);   // SizeOfHeaders
+			Pe::Write<uint32_t>(image, 0x98 + 92, 16);      // NumberOfRvaAndSizes
+			return ReplaceResourceSection(image, table);
+		}
+
+		static ResourceTable MakeTable()
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(u"data"), 0, AsBytes("hello"));
+			table.Set(ResId(10), ResId(7), 1031, AsBytes("sieben"));
+			table.Set(ResId(10), ResId(7), 1033, AsBytes("seven"));
+			table.Set(ResId(24), ResId(1), 1033, AsBytes("<assembly/>"));
+			return table;
+		}
+
+		TEST_METHOD(Entries_matches_ForEach)
+		{
+			const auto file = MakeImage(MakeTable());
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+
+			vector<size_t> expected;
+			resources.ForEach([&](ResourceEntry const& entry) { expected.push_back(entry.dataOffset); return true; });
+			vector<size_t> actual;
+			for (auto const& entry : resources.Entries()) actual.push_back(entry.dataOffset);
+			Assert::AreEqual(size_t{ 4 }, actual.size());
+			Assert::IsTrue(expected == actual);
+		}
+
+		TEST_METHOD(Entries_filters_and_stops_early)
+		{
+			const auto file = MakeImage(MakeTable());
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+
+			size_t count = 0;
+			for (auto const& entry : resources.Entries({ ResId(10), ResId(7), nullopt }))
+			{
+				Assert::IsTrue(entry.name.IsId() && entry.name.id == 7);
+				++count;
+			}
+			Assert::AreEqual(size_t{ 2 }, count);
+
+			auto german = resources.Entries({ ResId(10), ResId(7), 1031 });
+			auto it = german.begin();
+			Assert::IsFalse(german.empty());
+			Assert::AreEqual(6u, it->size);
+			Assert::IsTrue(++it == default_sentinel);
+
+			Assert::IsTrue(resources.Contains({ ResId(10), ResId(u"DATA"), nullopt }));
+			Assert::IsTrue(resources.Contains({ ResId(24), nullopt, nullopt }));
+			Assert::IsFalse(resources.Contains({ ResId(24), ResId(2), nullopt }));
+			Assert::IsFalse(resources.Contains({ ResId(3), nullopt, nullopt }));
+		}
+
+		TEST_METHOD(Walks_stop_at_tables_referenced_again_and_again)
+		{
+			// 1000 types pointing at one table of 1000 names pointing at one table of 1000 languages
+			const vector<unsigned char> data(32 * 1024, 'x');
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, Pe::Bytes(data));
+			auto file = MakeImage(table);
+			const auto root = ResourceDirectory(Pe::Image(file)).RootOffset();
+			const auto rootRva = ResourceDirectory(Pe::Image(file)).RootRva();
+			const uint32_t count = 1000;
+			const uint32_t tableSize = 16 + 8 * count;
+			for (uint32_t level = 0; level < 3; ++level)
+			{
+				const auto offset = root + level * tableSize;
+				fill(file.begin() + offset, file.begin() + offset + 16, 0);
+				Pe::Write<uint16_t>(file, offset + 14, static_cast<uint16_t>(count));
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					Pe::Write<uint32_t>(file, offset + 16 + 8 * i, i + 1);
+					Pe::Write<uint32_t>(file, offset + 20 + 8 * i, (level + 1) * tableSize | (level < 2 ? ResourceDirectory::SubdirectoryFlag : 0));
+				}
+			}
+			Pe::Write<uint32_t>(file, root + 3 * tableSize, rootRva);
+			Pe::Write<uint32_t>(file, root + 3 * tableSize + 4, 16);
+
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+			Assert::ExpectException<InvalidResourceException>([&] { resources.ForEach([](ResourceEntry const&) { return true; }); });
+			Assert::ExpectException<InvalidResourceException>([&] { resources.ForEachOfType(ResId(1), [](ResourceEntry const&) { return true; }); });
+			Assert::ExpectException<InvalidResourceException>([&] { for (auto const& entry : resources.Entries()) (void)entry; });
+
+			// lookups read one table per level
+			Assert::IsTrue(resources.Find(ResId(5), ResId(6), 7).has_value());
+		}
+	};
+}
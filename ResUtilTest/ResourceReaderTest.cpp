@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResourceReader.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResourceReaderTest)
+	{
+	public:
+
+		TEST_METHOD(Coalesce_sorts_by_offset_and_merges_close_ranges)
+		{
+			ResourceReader::Options options;
+			options.maxGap = 16;
+			options.maxExtent = 100;
+			vector<ResourceReader::Range> ranges{ { 200, 10, 0 }, { 0, 10, 1 }, { 20, 10, 2 }, { 90, 20, 3 }, { 220, 0, 4 }, { 25, 5, 5 } };
+			const auto extents = ResourceReader::Coalesce(ranges, options);
+
+			Assert::AreEqual(size_t{ 1 }, ranges[0].index);
+			Assert::AreEqual(size_t{ 4 }, ranges.back().index);
+			// 0-30 within the gap, 90 too far, 200 after the gap but 220 within it
+			Assert::AreEqual(size_t{ 3 }, extents.size());
+			Assert::AreEqual(uint64_t{ 0 }, extents[0].offset);
+			Assert::AreEqual(uint64_t{ 30 }, extents[0].size);
+			Assert::AreEqual(size_t{ 3 }, extents[0].count);
+			Assert::AreEqual(uint64_t{ 90 }, extents[1].offset);
+			Assert::AreEqual(size_t{ 1 }, extents[1].count);
+			Assert::AreEqual(uint64_t{ 200 }, extents[2].offset);
+			Assert::AreEqual(uint64_t{ 20 }, extents[2].size);
+			Assert::AreEqual(size_t{ 4 }, extents[2].first);
+
+			// an extent isn't grown beyond maxExtent
+			options.maxExtent = 10;
+			Assert::AreEqual(size_t{ 5 }, ResourceReader::Coalesce(ranges, options).size());
+		}
+
+		TEST_METHOD(Read_delivers_every_resource_in_file_order)
+		{
+			ResourceTable table;
+			string large(100000, 'x');
+			table.Set(ResId(10), ResId(1), 1033, AsBytes("first"));
+			table.Set(ResId(10), ResId(2), 1033, AsBytes(large.c_str()));
+			table.Set(ResId(10), ResId(u"CONFIG"), 0, AsBytes("config"));
+			table.Set(ResId(24), ResId(1), 1033, AsBytes("manifest"));
+			const auto path = (filesystem::temp_directory_path() / "ResourceReaderTest.dll").string();
+			{
+				const auto image = CreateResourceImage(table);
+				ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			}
+
+			ResourceReader::Options options;
+			options.maxGap = 1024;
+			options.maxExtent = 4096;
+			ResourceReader reader(path.c_str(), options);
+			Assert::IsTrue(reader.Add(ResId(24), ResId(1)));
+			Assert::IsFalse(reader.Add(ResId(10), ResId(3)));
+			ResourceSelector rcdata;
+			rcdata.types.push_back(NamePattern::ParseType("rcdata"));
+			Assert::AreEqual(size_t{ 3 }, reader.Add(rcdata));
+
+			vector<size_t> offsets;
+			vector<string> data(reader.Entries().size());
+			const auto result = reader.Read([&](size_t index, ResourceEntry const& entry, Pe::Bytes bytes)
+			{
+				offsets.push_back(entry.dataOffset);
+				data[index].assign(bytes.begin(), bytes.end());
+				return true;
+			});
+			Assert::AreEqual(size_t{ 4 }, result.resources);
+			Assert::AreEqual(size_t{ 3 }, result.extents);    // the large one on its own, between the others
+			Assert::IsTrue(is_sorted(offsets.begin(), offsets.end()));
+			Assert::AreEqual(string("manifest"), data[0]);
+			Assert::IsTrue(find(data.begin(), data.end(), large) != data.end());
+			Assert::IsTrue(find(data.begin(), data.end(), "config") != data.end());
+
+			size_t calls = 0;
+			reader.Read([&](size_t, ResourceEntry const&, Pe::Bytes) { return ++calls < 2; });
+			Assert::AreEqual(size_t{ 2 }, calls);
+		}
+	};
+}
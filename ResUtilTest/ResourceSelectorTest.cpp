@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResourceSelector.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResourceSelectorTest)
+	{
+	public:
+
+		TEST_METHOD(NamePattern_matches_keys_and_globs)
+		{
+			Assert::IsTrue(NamePattern::ParseType("icon").Matches(ResId(3)));
+			Assert::IsFalse(NamePattern::Parse("icon").Matches(ResId(3)));
+			Assert::IsTrue(NamePattern::Parse("debug_dlg").Matches(ResId(u"DEBUG_DLG")));
+			Assert::IsFalse(NamePattern::Parse("12").Matches(ResId(u"12")));
+
+			const auto debug = NamePattern::Parse("DEBUG*");
+			Assert::IsTrue(debug.IsGlob());
+			Assert::IsTrue(debug.Matches(ResId(u"DEBUG")));
+			Assert::IsTrue(debug.Matches(ResId(u"debug_view")));
+			Assert::IsFalse(debug.Matches(ResId(u"NODEBUG")));
+
+			// ids match by their decimal number
+			const auto hundreds = NamePattern::Parse("1??");
+			Assert::IsTrue(hundreds.Matches(ResId(100)));
+			Assert::IsTrue(hundreds.Matches(ResId(199)));
+			Assert::IsFalse(hundreds.Matches(ResId(10)));
+			Assert::IsFalse(hundreds.Matches(ResId(1000)));
+
+			const auto any = NamePattern::Parse("*");
+			Assert::IsTrue(any.Matches(ResId(1)) && any.Matches(ResId(u"X")));
+			Assert::IsTrue(NamePattern::Parse("*_*_END").Matches(ResId(u"A_B_C_END")));
+			Assert::IsFalse(NamePattern::Parse("*_*_END").Matches(ResId(u"A_END")));
+		}
+
+		TEST_METHOD(ListNames_applies_ranges_languages_and_sizes)
+		{
+			ResourceTable table;
+			for (uint16_t id = 1; id <= 300; ++id) table.Set(ResId(10), ResId(id), 1033, vector<unsigned char>(id, 'x'));
+			table.Set(ResId(10), ResId(150), 1031, AsBytes("de"));
+			table.Set(ResId(10), ResId(u"NAMED"), 1031, AsBytes("named"));
+			table.Set(ResId(6), ResId(150), 1033, AsBytes("other type"));
+			const auto file = CreateResourceImage(table);
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+
+			ResourceSelector selector;
+			selector.types.push_back(NamePattern::ParseType("rcdata"));
+			selector.AddName("100-199");
+			selector.AddName("250");
+			Assert::AreEqual(size_t{ 101 }, ListNames(resources, selector).Size());   // 150 once for both languages
+
+			selector.minSize = 190;
+			auto names = ListNames(resources, selector).ToStrings();
+			Assert::AreEqual(size_t{ 11 }, names.size());
+			Assert::AreEqual(string("190"), names.front());
+			Assert::AreEqual(string("250"), names.back());
+
+			ResourceSelector german;
+			german.types.push_back(NamePattern::ParseType("*"));
+			german.langs = { 1031 };
+			names = ListNames(resources, german).ToStrings();
+			Assert::IsTrue(names == vector<string>{ "NAMED", "150" });
+
+			Assert::ExpectException<InvalidArgsException>([&] { german.AddName("20-10"); });
+		}
+
+		TEST_METHOD(ForEachSelectedName_passes_the_type_along)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(5), 1033, AsBytes("rcdata"));
+			table.Set(ResId(10), ResId(5), 1031, AsBytes("rcdata, german"));
+			table.Set(ResId(6), ResId(5), 1033, AsBytes("string"));
+			const auto file = CreateResourceImage(table);
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+
+			ResourceSelector selector;
+			selector.types.push_back(NamePattern::ParseType("rcdata"));
+			Assert::IsFalse(selector.CanMatchTypes());
+			selector.types.push_back(NamePattern::ParseType("6"));
+			Assert::IsTrue(selector.CanMatchTypes());
+
+			vector<string> names;
+			ForEachSelectedName(resources, selector, [&](ResNameRef const& type, ResNameRef const& name)
+			{
+				names.push_back(type.ToString() + "/" + name.ToString());
+			});
+			Assert::IsTrue(names == vector<string>{ "6/5", "10/5" });
+			Assert::IsTrue(ResourceSelector{}.CanMatchTypes());
+		}
+
+		TEST_METHOD(RemoveResources_removes_all_matches_with_one_rebuild)
+		{
+			ResourceTable table;
+			table.Set(ResId(5), ResId(u"DEBUG_MAIN"), 1033, AsBytes("debug dialog"));
+			table.Set(ResId(5), ResId(u"DEBUG_MAIN"), 1031, AsBytes("debug dialog de"));
+			table.Set(ResId(5), ResId(u"MAIN"), 1033, AsBytes("dialog"));
+			table.Set(ResId(6), ResId(1), 1033, AsBytes("strings"));
+			table.Set(ResId(6), ResId(1), 1031, AsBytes("strings de"));
+			table.Set(ResId(6), ResId(1), 1036, AsBytes("strings fr"));
+			const auto path = (filesystem::temp_directory_path() / "ResourceSelectorTest.dll").string();
+			{
+				const auto image = CreateResourceImage(table);
+				ofstream(path, ios::binary).write(reinterpret_cast<const char*>(image.data()), static_cast<streamsize>(image.size()));
+			}
+
+			ResourceSelector debug;
+			debug.types.push_back(NamePattern::ParseType("dialog"));
+			debug.names.push_back(NamePattern::Parse("debug_*"));
+			Assert::AreEqual(size_t{ 2 }, RemoveResources(path.c_str(), debug));
+
+			ResourceSelector otherLanguages;
+			otherLanguages.types.push_back(NamePattern::ParseType("*"));
+			otherLanguages.exceptLangs = { 1033 };
+			Assert::AreEqual(size_t{ 2 }, RemoveResources(path.c_str(), otherLanguages));
+			Assert::AreEqual(size_t{ 0 }, RemoveResources(path.c_str(), otherLanguages));
+
+			MappedFile file(path.c_str());
+			Pe::Image image(file.Data());
+			ResourceTable remaining{ ResourceDirectory(image) };
+			Assert::AreEqual(size_t{ 2 }, remaining.Size());
+			Assert::IsNotNull(remaining.Find(ResId(5), ResId(u"MAIN"), 1033));
+			Assert::IsNotNull(remaining.Find(ResId(6), ResId(1), 1033));
+		}
+	};
+}
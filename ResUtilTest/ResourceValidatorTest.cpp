@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResourceValidator.hpp"
+#include "..\ResLib\ResourceWriter.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResourceValidatorTest)
+	{
+	public:
+
+		static vector<unsigned char> CreateImage()
+		{
+			ResourceTable table;
+			table.Set(ResId(3), ResId(1), 1033, AsBytes("icon data"));
+			table.Set(ResId(10), ResId(u"CONFIG"), 1033, AsBytes("config data"));
+			return CreateResourceImage(table);
+		}
+
+		static size_t RootOffset(vector<unsigned char> const& file)
+		{
+			Pe::Image image(file);
+			const auto dir = image.GetDataDirectory(Pe::ResourceDirectory);
+			return *image.RvaToOffset(dir.virtualAddress, dir.size);
+		}
+
+		// the data entry reached through the first entry of every level below the root entry at index
+		static size_t DataEntryOffset(vector<unsigned char> const& file, size_t index)
+		{
+			const auto root = RootOffset(file);
+			size_t entry = root + ResourceDirectory::DirectoryHeaderSize + index * ResourceDirectory::DirectoryEntrySize;
+			for (int level = 0; level < 2; ++level)
+			{
+				const auto table = Pe::Read<uint32_t>(file, entry + 4) & ~ResourceDirectory::SubdirectoryFlag;
+				entry = root + table + ResourceDirectory::DirectoryHeaderSize;
+			}
+			return root + Pe::Read<uint32_t>(file, entry + 4);
+		}
+
+		static vector<ResourceDefect> Validate(vector<unsigned char> const& file)
+		{
+			Pe::Image image(file);
+			return ResourceValidator(image).Run();
+		}
+
+		static bool HasDefect(vector<ResourceDefect> const& defects, const char* message)
+		{
+			return any_of(defects.begin(), defects.end(), [&](ResourceDefect const& defect) { return defect.message.find(message) != string::npos; });
+		}
+
+		TEST_METHOD(Run_reports_nothing_for_a_written_section)
+		{
+			const auto file = CreateImage();
+			Assert::IsTrue(Validate(file).empty());
+		}
+
+		TEST_METHOD(Run_reports_cycles_and_unsorted_keys)
+		{
+			auto file = CreateImage();
+			const auto root = RootOffset(file);
+			const auto first = root + ResourceDirectory::DirectoryHeaderSize;
+			Pe::Write<uint32_t>(file, first, 12);                                       // type 3 becomes 12, after 10
+			Pe::Write<uint32_t>(file, first + 4, ResourceDirectory::SubdirectoryFlag);   // and points back to the root
+
+			const auto defects = Validate(file);
+			Assert::IsTrue(HasDefect(defects, "directory tables form a cycle"));
+			Assert::IsTrue(HasDefect(defects, "key 10 is out of order"));
+		}
+
+		TEST_METHOD(Run_reports_data_not_backed_by_the_file_and_overlaps)
+		{
+			auto file = CreateImage();
+			const auto icon = DataEntryOffset(file, 0);
+			const auto config = DataEntryOffset(file, 1);
+			Pe::Write<uint32_t>(file, icon, Pe::Read<uint32_t>(file, config) + 4);     // inside the config data
+			Pe::Write<uint32_t>(file, config + 4, 0x10000000);
+
+			auto defects = Validate(file);
+			Assert::AreEqual(size_t{ 1 }, defects.size());
+			Assert::IsTrue(HasDefect(defects, "is not backed by file data"));
+			Assert::AreEqual(string("rcdata/CONFIG/1033"), defects[0].path);
+
+			Pe::Write<uint32_t>(file, config + 4, 11);
+			defects = Validate(file);
+			Assert::AreEqual(size_t{ 1 }, defects.size());
+			Assert::IsTrue(HasDefect(defects, "data overlaps the data of rcdata/CONFIG/1033"));
+			Assert::AreEqual(icon, defects[0].offset);
+		}
+	};
+}
@@ -0,0 +1,337 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "TestData.h"
+#include "..\ResLib\ResourceWriter.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(ResourceWriterTest)
+	{
+	public:
+
+		// PE32 headers with a single .text section and no resources, followed by an overlay
+		static vector<unsigned char> MakeImage()
+		{
+			vector<unsigned char> image(0x400);
+			Pe::Write<uint16_t>(image, 0, Pe::DosSignature);
+			Pe::Write<uint32_t>(image, 0x3C, 0x80);
+			Pe::Write<uint32_t>(image, 0x80, Pe::NtSignature);
+			Pe::Write<uint16_t>(image, 0x86, 1);            // NumberOfSections
+			Pe::Write<uint16_t>(image, 0x94, 224);          // SizeOfOptionalHeader
+			Pe::Write<uint16_t>(image, 0x98, Pe::Pe32Magic);
+			Pe::Write<uint32_t>(image, 0x98 + 32, 0x1000);  // SectionAlignment
+			Pe::Write<uint32_t>(image, 0x98 + 36, 0x200);   // FileAlignment
+			Pe::Write<uint32_t>(image, 0x98 + 56, 0x2000);  // SizeOfImage
+			Pe::Write<uint32_t>(image, 0x98 + 60, 0x200);   // SizeOfHeaders
+			Pe::Write<uint32_t>(image, 0x98 + 92, 16);      // NumberOfRvaAndSizes
+
+			const size_t section = 0x98 + 224;
+			image[section] = '.';
+			image[section + 1] = 't';
+			Pe::Write<uint32_t>(image, section + 8, 0x10);
+			Pe::Write<uint32_t>(image, section + 12, 0x1000);
+			Pe::Write<uint32_t>(image, section + 16, 0x200);
+			Pe::Write<uint32_t>(image, section + 20, 0x200);
+			image.insert(image.end(), { 'O', 'V', 'L' });
+			return image;
+		}
+
+		TEST_METHOD(ReplaceResourceSection_appends_section_and_keeps_overlay)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(u"data"), 0, AsBytes("hello"));
+			table.Set(ResId(10), ResId(7), 1033, AsBytes("seven"));
+			table.Set(ResId(u"CUSTOM"), ResId(1), 0, AsBytes("x"));
+
+			auto result = ReplaceResourceSection(MakeImage(), table);
+			Pe::Image image(result);
+			Assert::IsTrue(image.Sections().size() == 2);
+			Assert::IsTrue(image.Sections()[1].name == ".rsrc");
+			Assert::IsTrue(result.size() - image.EndOfSectionData() == 3 && result.back() == 'L');
+
+			ResourceDirectory resources(image);
+			auto entry = resources.Find(ResId(10), ResId(u"DATA"));
+			Assert::IsTrue(entry.has_value());
+			auto data = resources.GetData(*entry);
+			Assert::IsTrue(string(data.begin(), data.end()) == "hello");
+			Assert::IsTrue(resources.Find(ResId(10), ResId(7), 1033).has_value());
+			Assert::IsTrue(resources.Find(ResId(u"custom"), ResId(1)).has_value());
+		}
+
+		TEST_METHOD(ReplaceResourceSection_rebuilds_last_section_in_place)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, AsBytes("first"));
+			auto first = ReplaceResourceSection(MakeImage(), table);
+
+			Pe::Image firstImage(first);
+			ResourceTable updated{ ResourceDirectory(firstImage) };
+			updated.Remove(ResId(10), ResId(1), 0);
+			updated.Set(ResId(10), ResId(2), 0, AsBytes("second"));
+			auto second = ReplaceResourceSection(first, updated);
+
+			Pe::Image image(second);
+			Assert::IsTrue(image.Sections().size() == 2);
+			ResourceDirectory resources(image);
+			Assert::IsFalse(resources.Find(ResId(10), ResId(1)).has_value());
+			Assert::IsTrue(resources.Find(ResId(10), ResId(2)).has_value());
+		}
+
+		TEST_METHOD(ReplaceResourceSection_reuses_section_in_front_if_it_fits)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, AsBytes("first"));
+			table.Set(ResId(10), ResId(2), 0, AsBytes("second"));
+			auto file = ReplaceResourceSection(MakeImage(), table);
+
+			// another section behind .rsrc, like .reloc
+			const auto end = Pe::Image(file).EndOfSectionData();
+			file.insert(file.begin() + end, 0x200, 'R');
+			const size_t header = 0x98 + 224 + 2 * Pe::SectionHeaderSize;
+			Pe::Write<uint16_t>(file, 0x86, 3);
+			Pe::Write<uint32_t>(file, header + 8, 0x10);
+			Pe::Write<uint32_t>(file, header + 12, 0x3000);
+			Pe::Write<uint32_t>(file, header + 16, 0x200);
+			Pe::Write<uint32_t>(file, header + 20, static_cast<uint32_t>(end));
+
+			table.Remove(ResId(10), ResId(2), 0);
+			const auto result = ReplaceResourceSection(file, table);
+			Assert::AreEqual(file.size(), result.size());
+			Assert::IsTrue(equal(file.begin() + end, file.end(), result.begin() + end));
+
+			Pe::Image image(result);
+			Assert::IsTrue(image.Sections().size() == 3);
+			Assert::AreEqual(0x2000u, image.GetDataDirectory(Pe::ResourceDirectory).virtualAddress);
+			ResourceDirectory resources(image);
+			Assert::IsTrue(resources.Find(ResId(10), ResId(1)).has_value());
+			Assert::IsFalse(resources.Find(ResId(10), ResId(2)).has_value());
+		}
+
+		// adds a .reloc section 0x1000 bytes behind the last one, with its raw data in front of the overlay
+		static vector<unsigned char> AddReloc(vector<unsigned char> file)
+		{
+			const Pe::Image image(file);
+			const auto end = image.EndOfSectionData();
+			const auto count = image.Sections().size();
+			const auto header = image.SectionTableOffset() + count * Pe::SectionHeaderSize;
+			const auto rva = image.Sections().back().virtualAddress + 0x1000;
+			const auto sizeOfImage = image.SizeOfImageOffset();
+			file.insert(file.begin() + end, 0x200, 'R');
+			Pe::Write<uint16_t>(file, image.NumberOfSectionsOffset(), static_cast<uint16_t>(count + 1));
+			Pe::Write<uint32_t>(file, header + 8, 0x10);
+			Pe::Write<uint32_t>(file, header + 12, rva);
+			Pe::Write<uint32_t>(file, header + 16, 0x200);
+			Pe::Write<uint32_t>(file, header + 20, static_cast<uint32_t>(end));
+			Pe::Write<uint32_t>(file, sizeOfImage, rva + 0x1000);
+			return file;
+		}
+
+		TEST_METHOD(ReplaceResourceSection_shrinks_section_in_front_and_moves_the_rest_down)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, AsBytes("first"));
+			table.Set(ResId(10), ResId(2), 0, vector<unsigned char>(3000, 'X'));
+			const auto file = AddReloc(ReplaceResourceSection(MakeImage(), table));
+			Assert::AreEqual(0xE00u, Pe::Image(file).Sections()[1].sizeOfRawData);
+
+			table.Remove(ResId(10), ResId(2), 0);
+			const auto update = PlanResourceSection(file, table);
+			Assert::AreEqual(size_t{ 0x400 }, update.tailOffset);
+			Assert::AreEqual(size_t{ 0x200 }, update.section.size());    // the sections behind aren't rewritten
+			Assert::AreEqual(size_t{ 0x1200 }, update.overlayOffset);
+			const auto result = ReplaceResourceSection(file, table);
+			Assert::AreEqual(file.size() - 0xC00, result.size());
+
+			Pe::Image image(result);
+			auto const& sections = image.Sections();
+			Assert::AreEqual(0x200u, sections[1].sizeOfRawData);
+			Assert::AreEqual(0x2000u, sections[1].virtualAddress);
+			Assert::AreEqual(0x3000u, sections[2].virtualAddress);
+			Assert::AreEqual(0x600u, sections[2].pointerToRawData);
+			Assert::IsTrue(all_of(result.begin() + 0x600, result.begin() + 0x800, [](unsigned char b) { return b == 'R'; }));
+			Assert::IsTrue(string(result.end() - 3, result.end()) == "OVL");
+			ResourceDirectory resources(image);
+			Assert::IsTrue(resources.Find(ResId(10), ResId(1)).has_value());
+			Assert::IsFalse(resources.Find(ResId(10), ResId(2)).has_value());
+
+			// debug data addressed by its file offset behind .rsrc keeps everything in place
+			auto withDebug = file;
+			Pe::Write<uint32_t>(withDebug, 0x98 + 96 + 8 * Pe::DebugDirectory, 0x1000);
+			Pe::Write<uint32_t>(withDebug, 0x98 + 96 + 8 * Pe::DebugDirectory + 4, 28);
+			Pe::Write<uint32_t>(withDebug, 0x200 + 24, 0x1200);
+			Assert::AreEqual(withDebug.size(), ReplaceResourceSection(withDebug, table).size());
+		}
+
+		TEST_METHOD(ReplaceResourceSection_releases_the_raw_data_of_an_outgrown_section)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, vector<unsigned char>(3000, 'X'));
+			auto file = AddReloc(CreateResourceImage(table));
+			file.insert(file.end(), { 'O', 'V', 'L' });
+
+			table.Set(ResId(10), ResId(2), 0, vector<unsigned char>(3000, 'Y'));
+			const auto result = ReplaceResourceSection(file, table);
+			Pe::Image image(result);
+			auto const& sections = image.Sections();
+			Assert::AreEqual(size_t{ 3 }, sections.size());
+
+			// the old .rsrc keeps its addresses, .reloc takes its place in the file
+			Assert::AreEqual(0u, sections[0].sizeOfRawData);
+			Assert::AreEqual(Pe::Image(file).Sections()[0].virtualSize, sections[0].virtualSize);
+			Assert::AreEqual(0x200u, sections[1].pointerToRawData);
+			Assert::IsTrue(all_of(result.begin() + 0x200, result.begin() + 0x400, [](unsigned char b) { return b == 'R'; }));
+			Assert::AreEqual(0x3000u, sections[2].virtualAddress);
+			Assert::AreEqual(0x400u, sections[2].pointerToRawData);
+			Assert::AreEqual(size_t{ 0x400 } + sections[2].sizeOfRawData + 3, result.size());
+			Assert::IsTrue(string(result.end() - 3, result.end()) == "OVL");
+
+			ResourceDirectory resources(image);
+			const auto entry = resources.Find(ResId(10), ResId(2));
+			Assert::IsTrue(entry.has_value());
+			Assert::AreEqual('Y', static_cast<char>(resources.GetData(*entry)[2999]));
+		}
+
+		TEST_METHOD(Rebase_moves_the_data_entries)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, AsBytes("first"));
+			table.Set(ResId(u"CUSTOM"), ResId(u"NAME"), 1033, AsBytes("second"));
+			auto section = table.Build(0x1000);
+			ResourceTable::Rebase(section, 0x3000);
+			Assert::IsTrue(section == table.Build(0x4000));
+		}
+
+		TEST_METHOD(PlanResourceSection_writes_headers_and_tail_only)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(1), 0, AsBytes("first"));
+			const auto file = MakeImage();
+			const auto update = PlanResourceSection(file, table);
+
+			// .text stays untouched, the overlay moves behind the new section
+			Assert::IsTrue(update.headers.size() <= 0x200);
+			Assert::AreEqual(size_t{ 0x400 }, update.tailOffset);
+			Assert::AreEqual(size_t{ 0x400 }, update.overlayOffset);
+			Assert::AreEqual(size_t{ 3 }, update.overlaySize);
+			Assert::AreEqual(update.NewOverlayOffset() + 3, update.NewSize());
+
+			// the same bytes ReplaceResourceSection produces
+			vector<unsigned char> result(file.begin(), file.begin() + update.tailOffset);
+			copy(update.headers.begin(), update.headers.end(), result.begin());
+			result.insert(result.end(), update.section.begin(), update.section.end());
+			result.insert(result.end(), file.begin() + update.overlayOffset, file.end());
+			Assert::IsTrue(result == ReplaceResourceSection(file, table));
+		}
+
+		TEST_METHOD(Build_with_locality_layout_groups_startup_resources_and_aligns_large_ones)
+		{
+			ResourceTable table;
+			const vector<unsigned char> database(10000, 'D');
+			const vector<unsigned char> manifest(3000, 'M');
+			table.Set(ResId(3), ResId(1), 0, AsBytes("icon"));
+			table.Set(ResId(10), ResId(u"DATABASE"), 0, database);
+			table.Set(ResId(10), ResId(u"SMALL"), 0, AsBytes("small"));
+			table.Set(ResId(14), ResId(1), 0, AsBytes("group icon"));
+			table.Set(ResId(24), ResId(1), 0, manifest);
+
+			SectionLayout layout;
+			layout.locality = true;
+			const auto file = ReplaceResourceSection(MakeImage(), table, layout);
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+			auto rva = [&](ResId type, ResId name) { return resources.Find(type, name)->dataRva; };
+
+			// directory, then group icon and manifest, then the small ones, then the database
+			Assert::IsTrue(rva(ResId(14), ResId(1)) < rva(ResId(24), ResId(1)));
+			Assert::IsTrue(rva(ResId(24), ResId(1)) < rva(ResId(3), ResId(1)));
+			Assert::IsTrue(rva(ResId(10), ResId(u"SMALL")) < rva(ResId(10), ResId(u"DATABASE")));
+			const auto entry = resources.Find(ResId(10), ResId(u"DATABASE"));
+			Assert::AreEqual(0u, entry->dataRva % layout.pageSize);
+			Assert::AreEqual(size_t{ 0 }, entry->dataOffset % layout.pageSize);
+			auto data = resources.GetData(*entry);
+			Assert::IsTrue(equal(data.begin(), data.end(), database.begin(), database.end()));
+
+			const auto pages = CountPages(resources);
+			Assert::AreEqual(1u, pages.startup);
+			Assert::AreEqual(pages.largeMinimum, pages.large);
+		}
+
+		TEST_METHOD(CreateResourceImage_builds_resource_only_dll)
+		{
+			ResourceTable table;
+			table.Set(ResId(10), ResId(u"DATA"), 1033, AsBytes("hello"));
+			table.Set(ResId(16), ResId(1), 0, AsBytes("version"));
+
+			for (auto machine : { Pe::MachineI386, Pe::MachineAmd64, Pe::MachineArm64 })
+			{
+				ImageOptions options;
+				options.machine = machine;
+				const auto file = CreateResourceImage(table, options);
+
+				Pe::Image image(file);
+				Assert::AreEqual(machine != Pe::MachineI386, image.IsPe32Plus());
+				Assert::IsTrue(image.Sections().size() == 1);
+				Assert::AreEqual(0x1000u, image.Sections()[0].virtualAddress);
+				Assert::AreEqual(Checksum::Compute(image), Pe::Read<uint32_t>(file, image.CheckSumOffset()));
+
+				ResourceDirectory resources(image);
+				auto entry = resources.Find(ResId(10), ResId(u"DATA"), 1033);
+				Assert::IsTrue(entry.has_value());
+				auto data = resources.GetData(*entry);
+				Assert::IsTrue(string(data.begin(), data.end()) == "hello");
+				Assert::IsTrue(resources.Find(ResId(16), ResId(1)).has_value());
+			}
+
+			ImageOptions unknown;
+			unknown.machine = 0x1C0;
+			Assert::ExpectException<InvalidArgsException>([&] { CreateResourceImage(table, unknown); });
+		}
+
+		TEST_METHOD(Build_sorts_names_by_code_unit)
+		{
+			// more names than std::sort handles alone, in reverse order
+			ResourceTable table;
+			vector<u16string> names;
+			for (char16_t c : { u'z', u'a', char16_t(0x00E9), char16_t(0x0100), u'B' })
+			{
+				for (int i = 99; i >= 0; --i)
+				{
+					names.push_back(u16string(1, c) + u16string(1, char16_t(u'0' + i / 10)) + u16string(1, char16_t(u'0' + i % 10)));
+					table.Set(ResId(10), ResId(names.back()), 0, AsBytes("x"));
+				}
+			}
+			table.Set(ResId(10), ResId(1), 0, AsBytes("id"));
+
+			for (auto& name : names) name = ResourceTable::Normalize(ResId(name)).name;
+			sort(names.begin(), names.end());
+			const auto sorted = table.Sorted();
+			Assert::AreEqual(names.size() + 1, sorted.size());
+			for (size_t i = 0; i < names.size(); ++i) Assert::IsTrue(sorted[i].key->name.name == names[i]);
+			Assert::IsTrue(sorted.back().key->name.IsId());
+
+			auto file = ReplaceResourceSection(MakeImage(), table);
+			Pe::Image image(file);
+			ResourceDirectory resources(image);
+			size_t index = 0;
+			for (auto const& entry : resources.Entries())
+			{
+				if (index < names.size()) Assert::IsTrue(entry.name.ToU16String() == names[index]);
+				++index;
+			}
+			Assert::AreEqual(names.size() + 1, index);
+		}
+
+		TEST_METHOD(Build_rejects_more_than_65535_entries_per_directory)
+		{
+			ResourceTable table;
+			for (uint32_t id = 0; id <= 0xFFFF; ++id) table.Set(ResId(10), ResId(1), static_cast<uint16_t>(id), AsBytes("x"));
+			table.Set(ResId(10), ResId(1), 0, AsBytes("y"));
+			Assert::AreEqual(size_t{ 0x10000 }, table.Size());
+			Assert::ExpectException<UpdateResourceException>([&] { table.Build(0x1000); });
+		}
+	};
+}
@@ -35,5 +35,24 @@ namespace ResUtilTest
 			vector<string> v{ "Hello" };
 			Assert::AreEqual(StringHelper::join(v, "__").c_str(), "Hello");
 		}
+
+		TEST_METHOD(split_drops_empty_parts)
+		{
+			auto parts = StringHelper::split(";a.dll;;b.dll;", ';');
+			Assert::IsTrue(parts.size() == 2);
+			Assert::AreEqual("a.dll", parts[0].c_str());
+			Assert::AreEqual("b.dll", parts[1].c_str());
+		}
+
+		TEST_METHOD(wildcardMatch_star_and_question_mark)
+		{
+			Assert::IsTrue(StringHelper::wildcardMatch("*.dll", "a.dll"));
+			Assert::IsTrue(StringHelper::wildcardMatch("*.dll", ".dll"));
+			Assert::IsTrue(StringHelper::wildcardMatch("lib?.*", "libx.so.1"));
+			Assert::IsTrue(StringHelper::wildcardMatch("*a*b", "xaxxab"));
+			Assert::IsFalse(StringHelper::wildcardMatch("*.dll", "a.exe"));
+			Assert::IsFalse(StringHelper::wildcardMatch("?", ""));
+			Assert::IsFalse(StringHelper::wildcardMatch("a", "ab"));
+		}
 	};
 }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "..\ResLib\PeImage.hpp"
+
+#include <cstring>
+
+namespace ResUtilTest
+{
+	// the characters of a string, without the terminator, as resource data
+	static inline ResLib::Pe::Bytes AsBytes(const char* text)
+	{
+		return ResLib::Pe::Bytes(reinterpret_cast<const unsigned char*>(text), strlen(text));
+	}
+}
@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\ResLib\VersionInfo.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResLib;
+using namespace std;
+
+namespace ResUtilTest
+{
+	TEST_CLASS(VersionInfoTest)
+	{
+	public:
+
+		static vector<unsigned char> MakeVersionResource()
+		{
+			VersionInfo::Node root;
+			root.key = VersionInfo::RootKey;
+			VersionInfo::Update update;
+			update.fileVersion = VersionInfo::ParseVersion("1.0.0.0");
+			update.strings = { { "CompanyName", "ACME Corporation" }, { "FileVersion", "1.0.0.0" } };
+			VersionInfo::Apply(root, update);
+			return VersionInfo::Serialize(root);
+		}
+
+		TEST_METHOD(ParseVersion_fills_missing_parts_with_zero)
+		{
+			auto version = VersionInfo::ParseVersion("1.2");
+			Assert::AreEqual("1.2.0.0", VersionInfo::ToString(version).c_str());
+		}
+
+		TEST_METHOD(ParseVersion_rejects_invalid_input)
+		{
+			Assert::ExpectException<InvalidArgsException>([] { VersionInfo::ParseVersion("1.2.3.4.5"); });
+			Assert::ExpectException<InvalidArgsException>([] { VersionInfo::ParseVersion("1.x"); });
+			Assert::ExpectException<InvalidArgsException>([] { VersionInfo::ParseVersion("70000"); });
+		}
+
+		TEST_METHOD(Serialize_and_Parse_roundtrip)
+		{
+			auto data = MakeVersionResource();
+			auto root = VersionInfo::Parse(data);
+			Assert::AreEqual("1.0.0.0", VersionInfo::ToString(*VersionInfo::GetVersion(root, VersionInfo::FileVersionIndex)).c_str());
+			Assert::IsTrue(data == VersionInfo::Serialize(root));
+		}
+
+		TEST_METHOD(TryPatchInPlace_updates_fitting_values)
+		{
+			auto data = MakeVersionResource();
+			auto size = data.size();
+			auto root = VersionInfo::Parse(data);
+
+			VersionInfo::Update update;
+			update.fileVersion = VersionInfo::ParseVersion("2.1.0.7");
+			update.strings = { { "CompanyName", "ACME" } };
+			Assert::IsTrue(VersionInfo::TryPatchInPlace(data, root, update));
+			Assert::IsTrue(size == data.size());
+
+			auto patched = VersionInfo::Parse(data);
+			Assert::AreEqual("2.1.0.7", VersionInfo::ToString(*VersionInfo::GetVersion(patched, VersionInfo::FileVersionIndex)).c_str());
+			auto table = patched.FindChild(VersionInfo::StringFileInfoKey)->children.front();
+			Assert::IsTrue(u16string(u"ACME") == reinterpret_cast<const char16_t*>(table.FindChild(u"CompanyName")->value.data()));
+			Assert::IsTrue(u16string(u"2.1.0.7") == reinterpret_cast<const char16_t*>(table.FindChild(u"FileVersion")->value.data()));
+		}
+
+		TEST_METHOD(TryPatchInPlace_leaves_data_alone_if_value_grows)
+		{
+			auto data = MakeVersionResource();
+			auto original = data;
+			auto root = VersionInfo::Parse(data);
+
+			VersionInfo::Update update;
+			update.fileVersion = VersionInfo::ParseVersion("2.0");
+			update.strings = { { "CompanyName", "ACME Corporation International" } };
+			Assert::IsFalse(VersionInfo::TryPatchInPlace(data, root, update));
+			Assert::IsTrue(original == data);
+		}
+
+		TEST_METHOD(Apply_adds_missing_strings)
+		{
+			auto data = MakeVersionResource();
+			auto root = VersionInfo::Parse(data);
+
+			VersionInfo::Update update;
+			update.strings = { { "ProductName", "Road Runner Trap" } };
+			VersionInfo::Apply(root, update);
+			auto reparsed = VersionInfo::Parse(VersionInfo::Serialize(root));
+			auto table = reparsed.FindChild(VersionInfo::StringFileInfoKey)->children.front();
+			Assert::IsNotNull(table.FindChild(u"ProductName"));
+			Assert::IsNotNull(table.FindChild(u"CompanyName"));
+		}
+	};
+}
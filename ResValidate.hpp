@@ -0,0 +1,111 @@
+#pragma once
+
+// Checks the resource sections of many files (ResLib::ResourceValidator),
+// one file per worker thread at a time; results are printed in input order.
+//
+// Output, one line per defect:  file: offset: type/name/lang: message
+// Files that don't start with "MZ" are skipped (as found in directory trees),
+// files that do but can't be parsed as PE image are reported as defective.
+
+#include "Parallel.hpp"
+#include "ResLib/MappedFile.hpp"
+#include "ResLib/PeImage.hpp"
+#include "ResLib/ResourceValidator.hpp"
+#include "ResUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ResValidate
+{
+public:
+	struct Result
+	{
+		size_t files{ 0 };          // PE images checked
+		size_t defective{ 0 };      // images with defects
+		size_t defects{ 0 };
+		size_t errors{ 0 };         // files that couldn't be read
+	};
+
+	explicit ResValidate(size_t threads)
+		: _threads{ threads ? threads : std::max(1u, std::thread::hardware_concurrency()) }
+	{}
+
+	Result Run(std::vector<std::string> const& files, std::ostream& out, std::ostream& err)
+	{
+		struct Slot
+		{
+			bool image{ false };
+			size_t defects{ 0 };
+			std::string output;
+			std::string error;
+		};
+		Result result;
+		Parallel::ForEachOrdered(files.size(), _threads, [&](size_t index)
+		{
+			Slot slot;
+			try
+			{
+				std::ostringstream lines;
+				slot.image = ValidateFile(files[index], lines, slot.defects);
+				slot.output = lines.str();
+			}
+			catch (std::exception const& e)
+			{
+				slot.error = files[index] + ": error: " + e.what() + "\n";
+			}
+			return slot;
+		},
+		[&](size_t, Slot const& slot)
+		{
+			out << slot.output;
+			err << slot.error;
+			result.files += slot.image ? 1 : 0;
+			result.defective += slot.defects ? 1 : 0;
+			result.defects += slot.defects;
+			result.errors += slot.error.empty() ? 0 : 1;
+		});
+
+		out.flush();
+		return result;
+	}
+
+	// Writes the defects of one file; returns false if it isn't a PE image.
+	static bool ValidateFile(std::string const& fileName, std::ostream& out, size_t& defects)
+	{
+		std::error_code ec;
+		if (std::filesystem::file_size(fileName, ec) < 2 || ec) return false;
+		ResLib::MappedFile file(fileName.c_str());
+		const auto data = file.Data();
+		if (data[0] != 'M' || data[1] != 'Z') return false;
+
+		std::vector<ResLib::ResourceDefect> found;
+		try
+		{
+			ResLib::Pe::Image image(data);
+			found = ResLib::ResourceValidator(image).Run();
+		}
+		catch (ResLib::InvalidFileException const& e)
+		{
+			found.push_back({ 0, {}, std::string("not a valid PE image: ") + e.what() });
+		}
+
+		for (auto const& defect : found)
+		{
+			char offset[24];
+			std::snprintf(offset, sizeof(offset), "0x%zX", defect.offset);
+			out << fileName << ": " << offset << ": " << (defect.path.empty() ? std::string("-") : defect.path) << ": " << defect.message << '\n';
+		}
+		defects = found.size();
+		return true;
+	}
+
+private:
+	size_t _threads;
+};
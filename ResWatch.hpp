@@ -0,0 +1,206 @@
+#pragma once
+
+// Keeps resources of one or more targets in sync with their input files.
+//
+// The spec file has one mapping per line:  input;target;type;id[;lang]
+// Empty lines and lines starting with '#' are ignored, relative paths are
+// relative to the spec file.
+//
+// Changes are debounced, inputs whose content hash didn't change are skipped
+// and all changed resources of a target are written in a single commit.
+
+#include "FileWatcher.hpp"
+#include "ResLib/Hash.hpp"
+#include "ResLib/ModuleCache.hpp"
+#include "ResLib/ResLib.hpp"
+#include "ResLib/ResourceWriter.hpp"
+#include "ResUtil.h"
+#include "StringHelper.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ResWatch
+{
+public:
+	struct Mapping
+	{
+		std::string input;      // normalized, see FileWatcher::Normalize
+		std::string target;
+		ResLib::ResId type;
+		ResLib::ResId name;
+		uint16_t lang{ 0 };
+	};
+
+	static std::vector<Mapping> ParseSpec(std::string const& specFile)
+	{
+		std::ifstream spec(specFile);
+		if (!spec) throw ResUtil::IoException(("Unable to open spec file: " + specFile).c_str());
+
+		const auto base = std::filesystem::absolute(specFile).parent_path();
+		auto resolve = [&](std::string const& path) { return FileWatcher::Normalize((base / path).string()).string(); };
+
+		std::vector<Mapping> mappings;
+		size_t lineNumber = 0;
+		for (std::string line; std::getline(spec, line);)
+		{
+			++lineNumber;
+			while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+			if (line.empty() || line.front() == '#') continue;
+
+			auto fields = StringHelper::split(line, ';');
+			if (fields.size() != 4 && fields.size() != 5)
+			{
+				throw ResUtil::IoException((specFile + "(" + std::to_string(lineNumber) + "): expected input;target;type;id[;lang]").c_str());
+			}
+
+			Mapping mapping;
+			mapping.input = resolve(fields[0]);
+			mapping.target = resolve(fields[1]);
+			mapping.type = ResLib::ResId::ParseType(fields[2].c_str());
+			mapping.name = ResLib::ResId::Parse(fields[3].c_str());
+			if (fields.size() == 5)
+			{
+				auto lang = ResLib::ResId::Parse(fields[4].c_str());
+				if (!lang.IsId()) throw ResUtil::IoException((specFile + "(" + std::to_string(lineNumber) + "): invalid language id").c_str());
+				mapping.lang = lang.id;
+			}
+			mappings.emplace_back(std::move(mapping));
+		}
+		return mappings;
+	}
+
+	ResWatch(std::vector<Mapping> mappings, std::chrono::milliseconds debounce, ResLib::CommitOptions const& options, std::ostream& log)
+		: _mappings{ std::move(mappings) }
+		, _debounce{ debounce }
+		, _options{ options }
+		, _log{ log }
+	{}
+
+	// Brings all targets up to date, then applies changes until stop is set.
+	void Run(std::atomic<bool> const& stop)
+	{
+		std::vector<std::string> inputs;
+		for (auto const& mapping : _mappings) inputs.push_back(mapping.input);
+		FileWatcher watcher(inputs);
+
+		InitialSync();
+		_log << "watching " << _mappings.size() << " input(s)" << std::endl;
+
+		while (!stop)
+		{
+			auto changed = watcher.Wait(std::chrono::milliseconds(250));
+			if (changed.empty()) continue;
+
+			// debounce: wait until the inputs have been quiet for a while
+			for (;;)
+			{
+				auto more = watcher.Wait(_debounce);
+				if (more.empty()) break;
+				changed.insert(more.begin(), more.end());
+			}
+			Apply(changed);
+		}
+	}
+
+	// Updates the resources of the given inputs if their content changed.
+	// Returns the number of resources written.
+	size_t Apply(std::set<std::string> const& changedInputs)
+	{
+		// target -> (mapping, data)
+		std::map<std::string, std::vector<std::pair<Mapping const*, std::vector<unsigned char>>>> updates;
+		for (auto const& mapping : _mappings)
+		{
+			if (!changedInputs.count(mapping.input)) continue;
+			try
+			{
+				auto data = ResUtil::ReadData(mapping.input.c_str());
+				if (data.empty()) continue;     // probably still being written, there will be another event
+				auto hash = ResLib::Hash::Fnv1a64(data);
+				auto known = _hashes.find(Key(mapping));
+				if (known != _hashes.end() && known->second == hash) continue;
+				updates[mapping.target].emplace_back(&mapping, std::move(data));
+			}
+			catch (std::exception const& e)
+			{
+				_log << mapping.input << ": error: " << e.what() << std::endl;
+			}
+		}
+
+		size_t written = 0;
+		for (auto const& [target, resources] : updates)
+		{
+			try
+			{
+				ResLib::UpdateSession session(target.c_str(), _options);
+				for (auto const& [mapping, data] : resources)
+				{
+					session.Set(mapping->type, mapping->name, mapping->lang, data.data(), static_cast<uint32_t>(data.size()));
+				}
+				session.Commit();
+
+				std::vector<std::string> names;
+				for (auto const& [mapping, data] : resources)
+				{
+					_hashes[Key(*mapping)] = ResLib::Hash::Fnv1a64(data);
+					names.push_back(mapping->type.ToTypeString() + "/" + mapping->name.ToString());
+				}
+				written += resources.size();
+				_log << target << ": updated " << StringHelper::join(names, ", ") << std::endl;
+			}
+			catch (std::exception const& e)
+			{
+				_log << target << ": error: " << e.what() << std::endl;
+			}
+		}
+		return written;
+	}
+
+private:
+	static std::string Key(Mapping const& mapping)
+	{
+		return mapping.target + '\n' + mapping.type.ToString() + '\n' + mapping.name.ToString() + '\n' + std::to_string(mapping.lang);
+	}
+
+	// Remembers the hash of resources that already match their input and
+	// applies all others.
+	void InitialSync()
+	{
+		std::set<std::string> outdated;
+		for (auto const& mapping : _mappings)
+		{
+			try
+			{
+				const auto input = ResLib::Hash::Fnv1a64(ResUtil::ReadData(mapping.input.c_str()));
+				ResLib::Module target(mapping.target);
+				auto entry = target.Find(mapping.type, mapping.name, mapping.lang);
+				if (entry && ResLib::Hash::Fnv1a64(target.Resources().GetData(*entry)) == input)
+				{
+					_hashes[Key(mapping)] = input;
+					continue;
+				}
+			}
+			catch (std::exception const&)
+			{
+				// missing or unreadable files are reported by Apply
+			}
+			outdated.insert(mapping.input);
+		}
+		if (!outdated.empty()) Apply(outdated);
+	}
+
+	std::vector<Mapping> _mappings;
+	std::chrono::milliseconds _debounce;
+	ResLib::CommitOptions _options;
+	std::ostream& _log;
+	std::unordered_map<std::string, uint64_t> _hashes;  // last written content per resource
+};
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <map>
+#include <sstream>
+#include <vector>
 
 namespace StringHelper
 {
@@ -54,4 +56,52 @@ namespace StringHelper
 
         return ss.str();
     }
+
+    // splits a string at each separator, empty parts are dropped
+    inline std::vector<std::string> split(const std::string& s, char separator)
+    {
+        std::vector<std::string> parts;
+        std::string::size_type pos = 0;
+        while (pos <= s.size())
+        {
+            auto next = s.find(separator, pos);
+            if (next == std::string::npos) next = s.size();
+            if (next > pos) parts.emplace_back(s.substr(pos, next - pos));
+            pos = next + 1;
+        }
+        return parts;
+    }
+
+    // '*' matches any sequence, '?' any single character (case sensitive)
+    inline bool wildcardMatch(const std::string& pattern, const std::string& text)
+    {
+        size_t p = 0;
+        size_t t = 0;
+        size_t starPattern = std::string::npos;
+        size_t starText = 0;
+        while (t < text.size())
+        {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
+            {
+                ++p;
+                ++t;
+            }
+            else if (p < pattern.size() && pattern[p] == '*')
+            {
+                starPattern = p++;
+                starText = t;
+            }
+            else if (starPattern != std::string::npos)
+            {
+                p = starPattern + 1;
+                t = ++starText;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') ++p;
+        return p == pattern.size();
+    }
 }
\ No newline at end of file
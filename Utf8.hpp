@@ -3,13 +3,110 @@
 // Helper to convert UTF-8 encoded std::string to std::wstring on Windows platforms
 // (c) 2016, Florian Muecke
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <memory>
 #include <string>
+#include <string_view>
 #include <gsl/util>
 
 namespace Utf8
 {
+    // Platform independent conversions for UTF-16 data that does not come from
+    // the Windows API (e.g. strings read directly from a PE resource section).
+    // Invalid sequences are replaced with U+FFFD.
+    static inline void AppendFromUtf16(std::string& result, std::u16string_view utf16Str)
+    {
+        for (size_t i = 0; i < utf16Str.size(); ++i)
+        {
+            char32_t cp = utf16Str[i];
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < utf16Str.size()
+                && utf16Str[i + 1] >= 0xDC00 && utf16Str[i + 1] <= 0xDFFF)
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (utf16Str[++i] - 0xDC00);
+            }
+            else if (cp >= 0xD800 && cp <= 0xDFFF)
+            {
+                cp = 0xFFFD;
+            }
+
+            if (cp < 0x80)
+            {
+                result.push_back(static_cast<char>(cp));
+            }
+            else if (cp < 0x800)
+            {
+                result.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000)
+            {
+                result.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else
+            {
+                result.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                result.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+        }
+    }
+
+    static inline std::string FromUtf16(std::u16string_view utf16Str)
+    {
+        std::string result;
+        result.reserve(utf16Str.size());
+        AppendFromUtf16(result, utf16Str);
+        return result;
+    }
+
+    static inline std::u16string ToUtf16(std::string_view utf8Str)
+    {
+        std::u16string result;
+        result.reserve(utf8Str.size());
+        for (size_t i = 0; i < utf8Str.size();)
+        {
+            const auto lead = static_cast<unsigned char>(utf8Str[i]);
+            const size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+            if (len == 0 || i + len > utf8Str.size())
+            {
+                result.push_back(u'\xFFFD');
+                ++i;
+                continue;
+            }
+
+            char32_t cp = len == 1 ? lead : len == 2 ? (lead & 0x1F) : len == 3 ? (lead & 0x0F) : (lead & 0x07);
+            bool valid = true;
+            for (size_t k = 1; k < len; ++k)
+            {
+                const auto c = static_cast<unsigned char>(utf8Str[i + k]);
+                valid = valid && (c & 0xC0) == 0x80;
+                cp = (cp << 6) | (c & 0x3F);
+            }
+            i += valid ? len : 1;
+
+            if (!valid || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            {
+                result.push_back(u'\xFFFD');
+            }
+            else if (cp >= 0x10000)
+            {
+                result.push_back(static_cast<char16_t>(0xD800 + ((cp - 0x10000) >> 10)));
+                result.push_back(static_cast<char16_t>(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+            }
+            else
+            {
+                result.push_back(static_cast<char16_t>(cp));
+            }
+        }
+        return result;
+    }
+
+#ifdef _WIN32
     namespace _internal
     {
         enum class CodePage { Utf8 = CP_UTF8, Ansi = CP_ACP };
@@ -97,4 +194,5 @@ namespace Utf8
     {
         return _internal::from_wide(utf16Str, _internal::CodePage::Ansi);
     }
+#endif
 }
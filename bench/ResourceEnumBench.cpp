@@ -0,0 +1,93 @@
+// Enumeration with filters pushed into the directory walk (ListNames with a
+// ResourceSelector) compared to converting every name and filtering the
+// strings afterwards, on a single type with the given numbers of entries.
+//
+// Linux:  g++ -std=c++20 -O2 -I<path to GSL> bench/ResourceEnumBench.cpp -o resourceenumbench
+// Usage:  resourceenumbench [entries...]      (default: 10000 100000)
+//
+// Half of the entries are named ITEM<n>, half numbered; each query runs
+// repeatedly for about a second.
+
+#include "../ResLib/ResourceSelector.hpp"
+#include "../ResLib/ResourceWriter.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs f until a second has passed, returns seconds per run
+template<typename F>
+static double Measure(F&& f)
+{
+    size_t runs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do
+    {
+        f();
+        ++runs;
+        elapsed = Seconds(start);
+    } while (elapsed < 1.0);
+    return elapsed / static_cast<double>(runs);
+}
+
+static void Run(size_t count)
+{
+    const unsigned char payload[16]{};
+    ResLib::ResourceTable table;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto name = i % 2 ? ResLib::ResId(static_cast<uint16_t>(i / 2 + 1)) : ResLib::ResId(Utf8::ToUtf16("ITEM" + std::to_string(i)));
+        table.Set(ResLib::ResId(10), name, 1033, ResLib::Pe::Bytes(payload, sizeof(payload)));
+    }
+    const auto file = ResLib::CreateResourceImage(table);
+    const ResLib::Pe::Image image(file);
+    const ResLib::ResourceDirectory resources(image);
+
+    // everything converted, then filtered like a shell pipeline would
+    size_t found = 0;
+    const auto convertAll = Measure([&]
+    {
+        std::vector<std::string> names;
+        resources.ForEachOfType(ResLib::ResId(10), [&](ResLib::ResourceEntry const& entry) { names.push_back(entry.name.ToString()); return true; });
+        for (auto const& name : names) found += name.rfind("ITEM1", 0) == 0 || name == "1000";
+    });
+
+    auto query = [&](const char* label, ResLib::ResourceSelector selector)
+    {
+        selector.types.push_back(ResLib::NamePattern::ParseType("rcdata"));
+        size_t names = 0;
+        const auto seconds = Measure([&] { names = ResLib::ListNames(resources, selector).Size(); });
+        std::printf("    %-22s %9.3f ms  (%6zu names, %5.1fx)\n", label, seconds * 1e3, names, convertAll / seconds);
+    };
+
+    std::printf("%7zu entries: convert all and filter %9.3f ms\n", count, convertAll * 1e3);
+    query("all", {});
+    ResLib::ResourceSelector range;
+    range.AddName("1000-1099");
+    query("ids 1000-1099", range);
+    ResLib::ResourceSelector glob;
+    glob.AddName("ITEM1*");
+    query("names ITEM1*", glob);
+    ResLib::ResourceSelector large;
+    large.minSize = 17;
+    query("minSize 17 (none)", large);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        for (size_t count : { 10000, 100000 }) Run(count);
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) Run(std::strtoull(argv[i], nullptr, 10));
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Throughput of ResourceValidator::Run() compared to a plain ResourceDirectory
+// walk, on resource-only images with the given numbers of entries.
+//
+// Linux:  g++ -std=c++20 -O2 -I<path to GSL> bench/ResourceValidatorBench.cpp -o resourcevalidatorbench
+// Usage:  resourcevalidatorbench [entries...]      (default: 100 10000 100000)
+//
+// Half of the entries are named, half numbered, with payloads of 64 bytes to
+// 4 KiB; each image is checked repeatedly for about a second.
+
+#include "../ResLib/ResourceValidator.hpp"
+#include "../ResLib/ResourceWriter.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// runs f until a second has passed, returns seconds per run
+template<typename F>
+static double Measure(F&& f)
+{
+    size_t runs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do
+    {
+        f();
+        ++runs;
+        elapsed = Seconds(start);
+    } while (elapsed < 1.0);
+    return elapsed / static_cast<double>(runs);
+}
+
+static void Run(size_t count)
+{
+    std::vector<unsigned char> payload(4096, 'x');
+    ResLib::ResourceTable table;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto type = ResLib::ResId(static_cast<uint16_t>(10 + i % 8));
+        const auto name = i % 2 ? ResLib::ResId(static_cast<uint16_t>(i / 16 + 1)) : ResLib::ResId(Utf8::ToUtf16("ITEM" + std::to_string(i)));
+        table.Set(type, name, static_cast<uint16_t>(1033 + i % 3), ResLib::Pe::Bytes(payload.data(), 64 + i * 61 % 4032));
+    }
+    const auto file = ResLib::CreateResourceImage(table);
+    const ResLib::Pe::Image image(file);
+
+    size_t defects = 0;
+    const auto validate = Measure([&] { defects += ResLib::ResourceValidator(image).Run().size(); });
+    size_t visited = 0;
+    const auto walk = Measure([&]
+    {
+        ResLib::ResourceDirectory(image).ForEach([&](ResLib::ResourceEntry const&) { ++visited; return true; });
+    });
+
+    const auto megabytes = static_cast<double>(file.size()) / (1024 * 1024);
+    std::printf("%7zu entries, %8.1f MiB: validate %9.3f ms (%7.0f MiB/s, %5.0f ns/entry), ForEach %9.3f ms%s\n",
+        count, megabytes, validate * 1e3, megabytes / validate, validate * 1e9 / static_cast<double>(count), walk * 1e3,
+        defects ? "  DEFECTS FOUND" : "");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        for (size_t count : { 100, 10000, 100000 }) Run(count);
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) Run(std::strtoull(argv[i], nullptr, 10));
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Fuzz target for the resource parsers: ResourceValidator, ResourceDirectory
+// (ForEach, Entries, Find) and ResourceTable/ResFile on whatever parses, and
+// patch bundles (ResPatch::Bundle, Lz) for inputs starting with their magic.
+// Any crash or sanitizer report is a bug; exceptions derived from
+// ResLibException are the expected reaction to bad input.
+//
+// libFuzzer:  clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address,undefined -I<path to GSL> fuzz/ResourceFuzz.cpp -o resourcefuzz
+//             resourcefuzz corpus/
+// Without libFuzzer the file has a simple mutation driver of its own:
+//             g++ -std=c++20 -g -O1 -fsanitize=address,undefined -DRESLIB_FUZZ_DRIVER -I<path to GSL> fuzz/ResourceFuzz.cpp -o resourcefuzz
+//             resourcefuzz iterations seed.dll...
+// Seeds should be PE images with resources; the driver mutates mostly the
+// resource section.
+
+#include "../ResLib/ResFile.hpp"
+#include "../ResLib/ResPatch.hpp"
+#include "../ResLib/ResourceDirectory.hpp"
+#include "../ResLib/ResourceValidator.hpp"
+#include "../ResLib/ResourceWriter.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    const ResLib::Pe::Bytes file(data, size);
+    try
+    {
+        if (size >= sizeof(ResLib::ResPatch::Magic) && std::memcmp(data, ResLib::ResPatch::Magic, sizeof(ResLib::ResPatch::Magic)) == 0)
+        {
+            const ResLib::ResPatch::Bundle bundle(file);
+            for (auto const& op : bundle.Ops())
+            {
+                if (op.kind == ResLib::ResPatch::OpKind::Set && op.size <= (size_t{ 1 } << 24)) bundle.Data(op);
+            }
+            return 0;
+        }
+
+        const ResLib::Pe::Image image(file);
+        const auto defects = ResLib::ResourceValidator(image).Run();
+
+        const ResLib::ResourceDirectory resources(image);
+        size_t total = 0;
+        resources.ForEach([&](ResLib::ResourceEntry const& entry)
+        {
+            total += resources.GetData(entry).size();
+            return true;
+        });
+        for (auto const& entry : resources.Entries({ ResLib::ResId(16), std::nullopt, std::nullopt }))
+        {
+            total += entry.size;
+        }
+        resources.Find(ResLib::ResId(24), ResLib::ResId(1));
+
+        // a section without defects has to survive a rebuild
+        if (defects.empty())
+        {
+            const ResLib::ResourceTable table(resources);
+            const auto rebuilt = ResLib::ReplaceResourceSection(file, table);
+            const ResLib::Pe::Image rebuiltImage(rebuilt);
+            ResLib::ResFile::Export(ResLib::ResourceDirectory(rebuiltImage));
+        }
+        (void)total;
+    }
+    catch (ResLib::ResLibException const&)
+    {
+    }
+    return 0;
+}
+
+#ifdef RESLIB_FUZZ_DRIVER
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s iterations seed...\n", argv[0]);
+        return 1;
+    }
+    const auto iterations = std::strtoull(argv[1], nullptr, 10);
+    std::mt19937_64 random(1);
+    for (int arg = 2; arg < argc; ++arg)
+    {
+        std::ifstream in(argv[arg], std::ios::binary);
+        const std::vector<uint8_t> seed{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+        size_t rsrc = 0;
+        try
+        {
+            const ResLib::Pe::Image image(seed);
+            const ResLib::ResourceDirectory resources(image);
+            rsrc = resources.RootOffset();
+        }
+        catch (ResLib::ResLibException const&)
+        {
+        }
+
+        static const uint32_t interesting[] = { 0, 1, 0x7FFFFFFF, 0x80000000, 0x80000010, 0xFFFFFFFF, 0xFFFF, 0x10000, 16, 24 };
+        for (unsigned long long i = 0; i < iterations; ++i)
+        {
+            auto input = seed;
+            const auto mutations = 1 + random() % 8;
+            for (size_t m = 0; m < mutations && !input.empty(); ++m)
+            {
+                // mostly within the first 4 KiB of the resource section
+                const size_t base = random() % 4 ? rsrc : 0;
+                const size_t at = std::min(input.size() - 1, base + static_cast<size_t>(random() % (base ? 4096 : input.size())));
+                switch (random() % 4)
+                {
+                case 0:
+                    input[at] ^= static_cast<uint8_t>(1u << (random() % 8));
+                    break;
+                case 1:
+                    input[at] = static_cast<uint8_t>(random());
+                    break;
+                case 2:
+                    if (at + 4 <= input.size())
+                    {
+                        const auto value = interesting[random() % std::size(interesting)];
+                        std::memcpy(input.data() + at, &value, 4);
+                    }
+                    break;
+                default:
+                    if (random() % 16 == 0) input.resize(at);
+                    break;
+                }
+            }
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        std::printf("%s: %llu inputs\n", argv[arg], iterations);
+    }
+    return 0;
+}
+#endif
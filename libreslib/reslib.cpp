@@ -0,0 +1,241 @@
+#ifndef RESLIB_EXPORTS
+#define RESLIB_EXPORTS
+#endif
+#include "reslib.h"
+
+#include "../ResLib/ModuleCache.hpp"
+#include "../ResLib/ResourceWriter.hpp"
+#ifdef _WIN32
+#include "../ResLib/ResLib.hpp"
+#endif
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+struct reslib_module
+{
+    explicit reslib_module(const char* fileName) : module{ fileName } {}
+
+    // enumerated type and name strings live as long as the handle
+    const char* Intern(std::string&& str)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return strings.insert(std::move(str)).first->c_str();
+    }
+
+    ResLib::Module module;
+    std::mutex mutex;
+    std::unordered_set<std::string> strings;
+};
+
+struct reslib_update
+{
+    reslib_update(const char* fileName, ResLib::CommitOptions const& options) : session{ fileName, options } {}
+
+    ResLib::UpdateSession session;
+};
+
+namespace
+{
+    thread_local std::string lastError;
+
+    reslib_status Fail(reslib_status status, std::string message)
+    {
+        lastError = std::move(message);
+        return status;
+    }
+
+    // Runs f and translates exceptions into status codes; nothing may leave
+    // the library as an exception.
+    template<typename F>
+    reslib_status Guard(F&& f) noexcept
+    {
+        try
+        {
+            lastError.clear();
+            return f();
+        }
+        catch (ResLib::FileAccessException const& e) { return Fail(RESLIB_E_IO, e.what()); }
+        catch (ResLib::InvalidFileException const& e) { return Fail(RESLIB_E_BAD_FORMAT, e.what()); }
+        catch (ResLib::InvalidResourceException const& e) { return Fail(RESLIB_E_BAD_FORMAT, e.what()); }
+        catch (ResLib::UpdateResourceException const& e) { return Fail(RESLIB_E_UPDATE, e.what()); }
+        catch (ResLib::InvalidDataException const&) { return Fail(RESLIB_E_BAD_FORMAT, "invalid data"); }
+        catch (ResLib::ArgumentNullException const&) { return Fail(RESLIB_E_INVALID_ARG, "null argument"); }
+        catch (ResLib::InvalidArgsException const&) { return Fail(RESLIB_E_INVALID_ARG, "invalid argument"); }
+        catch (std::bad_alloc const&) { return Fail(RESLIB_E_NO_MEMORY, "out of memory"); }
+        catch (std::exception const& e) { return Fail(RESLIB_E_INTERNAL, e.what()); }
+        catch (...) { return Fail(RESLIB_E_INTERNAL, "unknown error"); }
+    }
+
+    std::optional<uint16_t> ToLang(int lang)
+    {
+        if (lang == RESLIB_ANY_LANG) return std::nullopt;
+        if (lang < 0 || lang > 0xFFFF) throw ResLib::InvalidArgsException();
+        return static_cast<uint16_t>(lang);
+    }
+
+    reslib_status Lookup(reslib_module* module, const char* type, const char* name, int lang, ResLib::Pe::Bytes& data)
+    {
+        if (!module || !type || !name) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        auto entry = module->module.Find(ResLib::ResId::ParseType(type), ResLib::ResId::Parse(name), ToLang(lang));
+        if (!entry) return Fail(RESLIB_E_NOT_FOUND, std::string("resource ") + type + "/" + name + " not found");
+        data = module->module.Resources().GetData(*entry);
+        return RESLIB_OK;
+    }
+}
+
+extern "C" {
+
+RESLIB_API int reslib_api_version(void)
+{
+    return RESLIB_API_VERSION;
+}
+
+RESLIB_API const char* reslib_last_error(void)
+{
+    return lastError.c_str();
+}
+
+RESLIB_API reslib_status reslib_open(const char* file_name, reslib_module** module)
+{
+    return Guard([&]
+    {
+        if (!file_name || !module) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        *module = nullptr;
+        *module = new reslib_module(file_name);
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API void reslib_close(reslib_module* module)
+{
+    delete module;
+}
+
+RESLIB_API reslib_status reslib_enum(reslib_module* module, const char* type, reslib_entry* entries, size_t capacity, size_t* count)
+{
+    return Guard([&]
+    {
+        if (!module || !count || (capacity && !entries)) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+
+        std::optional<ResLib::ResId> typeId;
+        if (type) typeId = ResLib::ResId::ParseType(type);
+
+        size_t total = 0;
+        module->module.ForEach(typeId, [&](ResLib::ResourceEntry const& entry)
+        {
+            if (total < capacity)
+            {
+                auto& out = entries[total];
+                out.type = module->Intern(entry.type.ToTypeString());
+                out.name = module->Intern(entry.name.ToString());
+                out.lang = entry.lang;
+                out.size = entry.size;
+                out.code_page = entry.codePage;
+            }
+            ++total;
+        });
+        *count = total;
+        return total > capacity ? Fail(RESLIB_E_BUFFER_TOO_SMALL, std::to_string(total) + " entries, buffer holds " + std::to_string(capacity)) : RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_read(reslib_module* module, const char* type, const char* name, int lang, void* buffer, size_t capacity, size_t* size)
+{
+    return Guard([&]
+    {
+        if (!size || (capacity && !buffer)) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        ResLib::Pe::Bytes data;
+        auto status = Lookup(module, type, name, lang, data);
+        if (status != RESLIB_OK) return status;
+
+        *size = data.size();
+        if (data.size() > capacity) return Fail(RESLIB_E_BUFFER_TOO_SMALL, std::to_string(data.size()) + " bytes, buffer holds " + std::to_string(capacity));
+        if (!data.empty()) std::memcpy(buffer, data.data(), data.size());
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_data(reslib_module* module, const char* type, const char* name, int lang, const void** data, size_t* size)
+{
+    return Guard([&]
+    {
+        if (!data || !size) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        ResLib::Pe::Bytes bytes;
+        auto status = Lookup(module, type, name, lang, bytes);
+        if (status != RESLIB_OK) return status;
+
+        *data = bytes.data();
+        *size = bytes.size();
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_update_begin(const char* file_name, reslib_update** update)
+{
+    return Guard([&]
+    {
+        if (!file_name || !update) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        *update = nullptr;
+        *update = new reslib_update(file_name, {});
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_update_begin_ex(const char* file_name, uint32_t flags, reslib_update** update)
+{
+    return Guard([&]
+    {
+        if (!file_name || !update) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        if (flags & ~uint32_t{ RESLIB_UPDATE_CHECKSUM | RESLIB_UPDATE_STRIP_SIGNATURE }) return Fail(RESLIB_E_INVALID_ARG, "unknown flags");
+        ResLib::CommitOptions options;
+        options.updateChecksum = (flags & RESLIB_UPDATE_CHECKSUM) != 0;
+        options.signature = (flags & RESLIB_UPDATE_STRIP_SIGNATURE) ? ResLib::SignaturePolicy::Strip : ResLib::SignaturePolicy::Refuse;
+        *update = nullptr;
+        *update = new reslib_update(file_name, options);
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_update_set(reslib_update* update, const char* type, const char* name, uint16_t lang, const void* data, size_t size)
+{
+    return Guard([&]
+    {
+        if (!update || !type || !name || !data || size == 0) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        if (size > UINT32_MAX) return Fail(RESLIB_E_INVALID_ARG, "resource data too large");
+        update->session.Set(ResLib::ResId::ParseType(type), ResLib::ResId::Parse(name), lang, data, static_cast<uint32_t>(size));
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_update_remove(reslib_update* update, const char* type, const char* name, uint16_t lang)
+{
+    return Guard([&]
+    {
+        if (!update || !type || !name) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        update->session.Remove(ResLib::ResId::ParseType(type), ResLib::ResId::Parse(name), lang);
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API reslib_status reslib_update_commit(reslib_update* update)
+{
+    return Guard([&]
+    {
+        if (!update) return Fail(RESLIB_E_INVALID_ARG, "null argument");
+        update->session.Commit();
+        return RESLIB_OK;
+    });
+}
+
+RESLIB_API void reslib_update_end(reslib_update* update)
+{
+    delete update;
+}
+
+}
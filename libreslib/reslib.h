@@ -0,0 +1,107 @@
+#ifndef RESLIB_H
+#define RESLIB_H
+
+/*
+ * libreslib - C interface to ResLib for in-process use (Python ctypes, cgo, ...).
+ *
+ * - No function throws; every function returns a reslib_status. The message of
+ *   the last failure on the calling thread is available via reslib_last_error().
+ * - Strings are UTF-8. Types and names are given the same way as on the
+ *   command line: predefined type names ("icon", "version", ...) or numbers
+ *   are ids, anything else is a string name.
+ * - lang RESLIB_ANY_LANG selects the first language found.
+ * - A module handle may be used from several threads at once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#  ifdef RESLIB_EXPORTS
+#    define RESLIB_API __declspec(dllexport)
+#  else
+#    define RESLIB_API __declspec(dllimport)
+#  endif
+#else
+#  define RESLIB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESLIB_API_VERSION 1
+#define RESLIB_ANY_LANG (-1)
+
+typedef enum reslib_status
+{
+    RESLIB_OK = 0,
+    RESLIB_E_INVALID_ARG = 1,       /* null pointer or malformed argument */
+    RESLIB_E_NOT_FOUND = 2,         /* no such resource */
+    RESLIB_E_BUFFER_TOO_SMALL = 3,  /* required size/count is returned anyway */
+    RESLIB_E_IO = 4,                /* file could not be opened or mapped */
+    RESLIB_E_BAD_FORMAT = 5,        /* not a PE file or corrupt resource data */
+    RESLIB_E_UPDATE = 6,            /* writing resources failed */
+    RESLIB_E_UNSUPPORTED = 7,       /* operation not available on this platform */
+    RESLIB_E_NO_MEMORY = 8,
+    RESLIB_E_INTERNAL = 9
+} reslib_status;
+
+typedef struct reslib_module reslib_module;
+typedef struct reslib_update reslib_update;
+
+typedef struct reslib_entry
+{
+    const char* type;       /* owned by the module handle */
+    const char* name;       /* owned by the module handle */
+    uint16_t lang;
+    uint32_t size;
+    uint32_t code_page;
+} reslib_entry;
+
+/* RESLIB_API_VERSION the library was built with */
+RESLIB_API int reslib_api_version(void);
+
+/* message of the last error on the calling thread, "" if there was none */
+RESLIB_API const char* reslib_last_error(void);
+
+/* maps the file read-only and indexes its resources */
+RESLIB_API reslib_status reslib_open(const char* file_name, reslib_module** module);
+RESLIB_API void reslib_close(reslib_module* module);
+
+/*
+ * Fills entries[0 .. capacity) with the resources of the given type, or with
+ * all resources if type is NULL. *count receives the total number of matches;
+ * if it exceeds capacity, RESLIB_E_BUFFER_TOO_SMALL is returned (call with
+ * capacity 0 to query the count).
+ */
+RESLIB_API reslib_status reslib_enum(reslib_module* module, const char* type, reslib_entry* entries, size_t capacity, size_t* count);
+
+/* copies the resource data into buffer; *size receives the data size */
+RESLIB_API reslib_status reslib_read(reslib_module* module, const char* type, const char* name, int lang, void* buffer, size_t capacity, size_t* size);
+
+/* borrows the resource data; the pointer is valid until reslib_close */
+RESLIB_API reslib_status reslib_data(reslib_module* module, const char* type, const char* name, int lang, const void** data, size_t* size);
+
+/* flags for reslib_update_begin_ex */
+#define RESLIB_UPDATE_CHECKSUM          0x1u    /* recompute the PE checksum on commit */
+#define RESLIB_UPDATE_STRIP_SIGNATURE   0x2u    /* remove an Authenticode signature instead of failing */
+
+/*
+ * Batch update: any number of set/remove calls followed by a single commit.
+ * reslib_update_end discards everything not committed and frees the handle.
+ * Signed files are refused with RESLIB_E_UPDATE unless RESLIB_UPDATE_STRIP_SIGNATURE
+ * is given; reslib_update_begin is reslib_update_begin_ex with flags 0.
+ */
+RESLIB_API reslib_status reslib_update_begin(const char* file_name, reslib_update** update);
+RESLIB_API reslib_status reslib_update_begin_ex(const char* file_name, uint32_t flags, reslib_update** update);
+RESLIB_API reslib_status reslib_update_set(reslib_update* update, const char* type, const char* name, uint16_t lang, const void* data, size_t size);
+RESLIB_API reslib_status reslib_update_remove(reslib_update* update, const char* type, const char* name, uint16_t lang);
+RESLIB_API reslib_status reslib_update_commit(reslib_update* update);
+RESLIB_API void reslib_update_end(reslib_update* update);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
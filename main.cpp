@@ -1,7 +1,15 @@
 #include "stdafx.h"
 #include "CmdArgs.hpp"
 #include "CmdArgsParser.hpp"
+#include "ResFanOut.hpp"
 #include "ResLib/ResLib.hpp"
+#include "ResPatcher.hpp"
+#include "ResRemove.hpp"
+#include "ResSearch.hpp"
+#include "ResServer.hpp"
+#include "ResStore.hpp"
+#include "ResValidate.hpp"
+#include "ResWatch.hpp"
 #include "ResUtil.h"
 #include "StringHelper.h"
 
@@ -13,7 +21,19 @@
 #include <exception>
 #include <system_error>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#ifdef _WIN32
 #include <Windows.h>
+#else
+static const int ERROR_BAD_ARGUMENTS = 160;
+#endif
 
 using namespace std;
 
@@ -23,6 +43,23 @@ static const char* const strCommand_read = "read";
 static const char* const strCommand_copy = "copy";
 static const char* const strCommand_enum = "enum";
 static const char* const strCommand_enumTypes = "enumTypes";
+static const char* const strCommand_setVersion = "setVersion";
+static const char* const strCommand_writeIcon = "writeIcon";
+static const char* const strCommand_messages = "messages";
+static const char* const strCommand_serve = "serve";
+static const char* const strCommand_watch = "watch";
+static const char* const strCommand_archive = "archive";
+static const char* const strCommand_restore = "restore";
+static const char* const strCommand_search = "search";
+static const char* const strCommand_has = "has";
+static const char* const strCommand_create = "create";
+static const char* const strCommand_importRes = "importRes";
+static const char* const strCommand_exportRes = "exportRes";
+static const char* const strCommand_validate = "validate";
+static const char* const strCommand_remove = "remove";
+static const char* const strCommand_makePatch = "makePatch";
+static const char* const strCommand_applyPatch = "applyPatch";
+static const char* const strCommand_relayout = "relayout";
 
 static const char* const strParam_in = "in";
 static const char* const strParam_out = "out";
@@ -30,42 +67,946 @@ static const char* const strParam_type = "type";
 static const char* const strParam_id = "id";
 static const char* const strParam_idIn = "idIn";
 static const char* const strParam_idOut = "idOut";
+static const char* const strParam_fileVersion = "fileVersion";
+static const char* const strParam_productVersion = "productVersion";
+static const char* const strParam_strings = "strings";
+static const char* const strParam_lang = "lang";
+static const char* const strParam_ids = "ids";
+static const char* const strParam_socket = "socket";
+static const char* const strParam_threads = "threads";
+static const char* const strParam_cache = "cache";
+static const char* const strParam_spec = "spec";
+static const char* const strParam_debounce = "debounce";
+static const char* const strParam_checksum = "checksum";
+static const char* const strParam_signed = "signed";
+static const char* const strParam_store = "store";
+static const char* const strParam_label = "label";
+static const char* const strParam_index = "index";
+static const char* const strParam_pattern = "pattern";
+static const char* const strParam_format = "format";
+static const char* const strParam_depth = "depth";
+static const char* const strParam_machine = "machine";
+static const char* const strParam_batch = "batch";
+static const char* const strParam_exceptLang = "exceptLang";
+static const char* const strParam_minSize = "minSize";
+static const char* const strParam_maxSize = "maxSize";
+static const char* const strParam_from = "from";
+static const char* const strParam_to = "to";
+static const char* const strParam_patch = "patch";
+static const char* const strParam_layout = "layout";
+static const char* const strParam_outDir = "outDir";
 
+static uint16_t GetLangArg(CmdArgsParser const& args)
+{
+    if (!args.HasValue(strParam_lang)) return 0; // LANG_NEUTRAL, SUBLANG_NEUTRAL
+    auto id = ResLib::ResId::Parse(args.GetValue(strParam_lang).c_str());
+    if (!id.IsId())
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_lang + "' is not a numeric language id");
+    }
+    return id.id;
+}
+
+// ';' separated language ids
+static std::vector<uint16_t> GetLangListArg(CmdArgsParser const& args, const char* param)
+{
+    std::vector<uint16_t> langs;
+    if (!args.HasValue(param)) return langs;
+    for (auto const& value : StringHelper::split(args.GetValue(param), ';'))
+    {
+        auto id = ResLib::ResId::Parse(value.c_str());
+        if (!id.IsId())
+        {
+            throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + param + "' is not a list of numeric language ids");
+        }
+        langs.push_back(id.id);
+    }
+    return langs;
+}
+
+// size in bytes, up to 4 GB
+static uint32_t GetSizeArg(CmdArgsParser const& args, const char* param, uint32_t defaultValue)
+{
+    if (!args.HasValue(param)) return defaultValue;
+    auto const& value = args.GetValue(param);
+    if (value.empty() || value.size() > 10 || value.find_first_not_of("0123456789") != string::npos || stoull(value) > 0xFFFFFFFFull)
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + param + "' is not a valid size");
+    }
+    return static_cast<uint32_t>(stoull(value));
+}
+
+// /type: and the names (';' separated, wildcards and id ranges allowed),
+// /lang:, /exceptLang:, /minSize: and /maxSize:
+static ResLib::ResourceSelector GetSelectorArgs(CmdArgsParser const& args, const char* nameParam)
+{
+    ResLib::ResourceSelector selector;
+    for (auto const& type : StringHelper::split(args.GetValue(strParam_type), ';')) selector.types.push_back(ResLib::NamePattern::ParseType(type));
+    if (args.HasValue(nameParam))
+    {
+        for (auto const& name : StringHelper::split(args.GetValue(nameParam), ';'))
+        {
+            try
+            {
+                selector.AddName(name);
+            }
+            catch (ResLib::InvalidArgsException const&)
+            {
+                throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), "'" + name + "' is not a valid id range");
+            }
+        }
+    }
+    selector.langs = GetLangListArg(args, strParam_lang);
+    selector.exceptLangs = GetLangListArg(args, strParam_exceptLang);
+    selector.minSize = GetSizeArg(args, strParam_minSize, selector.minSize);
+    selector.maxSize = GetSizeArg(args, strParam_maxSize, selector.maxSize);
+    return selector;
+}
+
+// 'locality' or 'compact', see ResLib::SectionLayout
+static ResLib::SectionLayout GetLayoutArg(CmdArgsParser const& args, bool locality)
+{
+    ResLib::SectionLayout layout;
+    layout.locality = locality;
+    if (!args.HasValue(strParam_layout)) return layout;
+    auto const& value = args.GetValue(strParam_layout);
+    if (value != "locality" && value != "compact")
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_layout + "' must be 'locality' or 'compact'");
+    }
+    layout.locality = value == "locality";
+    return layout;
+}
+
+// /checksum:update|keep and /signed:refuse|strip
+static ResLib::CommitOptions GetCommitOptions(CmdArgsParser const& args)
+{
+    ResLib::CommitOptions options;
+    if (args.HasValue(strParam_checksum))
+    {
+        auto const& value = args.GetValue(strParam_checksum);
+        if (value != "update" && value != "keep")
+        {
+            throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_checksum + "' must be 'update' or 'keep'");
+        }
+        options.updateChecksum = value == "update";
+    }
+    if (args.HasValue(strParam_signed))
+    {
+        auto const& value = args.GetValue(strParam_signed);
+        if (value != "refuse" && value != "strip")
+        {
+            throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_signed + "' must be 'refuse' or 'strip'");
+        }
+        options.signature = value == "strip" ? ResLib::SignaturePolicy::Strip : ResLib::SignaturePolicy::Refuse;
+    }
+    options.layout = GetLayoutArg(args, false);
+    return options;
+}
+
+// "1234" or "0xC0000005"
+static bool ParseMessageId(string const& str, uint32_t& id)
+{
+    const bool hex = str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+    const auto digits = hex ? str.substr(2) : str;
+    if (digits.empty() || digits.size() > (hex ? 8u : 10u) || digits.find_first_not_of(hex ? "0123456789abcdefABCDEF" : "0123456789") != string::npos) return false;
+    const auto value = stoull(digits, nullptr, hex ? 16 : 10);
+    if (value > 0xFFFFFFFFull) return false;
+    id = static_cast<uint32_t>(value);
+    return true;
+}
+
+// Resolves message ids against the message tables of one or more modules.
+// Prints one "id<TAB>text" line per id; line breaks inside a message are written as \n.
+static int ResolveMessages(CmdArgsParser const& args)
+{
+    std::ios::sync_with_stdio(false);
+
+    std::optional<uint16_t> lang;
+    if (args.HasValue(strParam_lang)) lang = GetLangArg(args);
+
+    vector<unique_ptr<ResLib::MessageModule>> modules;
+    for (auto const& file : ResUtil::ExpandFileList(args.GetValue(strParam_in)))
+    {
+        modules.emplace_back(make_unique<ResLib::MessageModule>(file.c_str(), lang));
+    }
+
+    int missing = 0;
+    auto resolve = [&](string const& idStr)
+    {
+        uint32_t id = 0;
+        std::optional<string> text;
+        if (ParseMessageId(idStr, id))
+        {
+            for (auto const& module : modules)
+            {
+                if ((text = module->Find(id))) break;
+            }
+        }
+        if (!text)
+        {
+            cerr << idStr << ": message not found\n";
+            ++missing;
+            return;
+        }
+
+        while (!text->empty() && (text->back() == '\n' || text->back() == '\r')) text->pop_back();
+        cout << idStr << '\t';
+        for (auto c : *text)
+        {
+            if (c == '\n') cout << "\\n";
+            else if (c != '\r') cout << c;
+        }
+        cout << '\n';
+    };
+
+    const auto ids = args.GetValue(strParam_ids);
+    if (ids == "-")
+    {
+        for (string line; getline(cin, line);)
+        {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+            if (!line.empty()) resolve(line);
+        }
+    }
+    else
+    {
+        for (auto const& id : ResUtil::ExpandFileList(ids)) resolve(id);
+    }
+    cout.flush();
+    return missing ? 1 : 0;
+}
+
+static size_t GetCountArg(CmdArgsParser const& args, const char* param, size_t defaultValue)
+{
+    if (!args.HasValue(param)) return defaultValue;
+    auto const& value = args.GetValue(param);
+    if (value.empty() || value.size() > 6 || value.find_first_not_of("0123456789") != string::npos)
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + param + "' is not a valid number");
+    }
+    return stoul(value);
+}
+
+static std::atomic<bool> stopRequested{ false };
+
+static int Watch(CmdArgsParser const& args)
+{
+    auto mappings = ResWatch::ParseSpec(args.GetValue(strParam_spec));
+    ResWatch watch(std::move(mappings), std::chrono::milliseconds(GetCountArg(args, strParam_debounce, 200)), GetCommitOptions(args), cout);
+
+    auto stop = [](int) { stopRequested = true; };
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    watch.Run(stopRequested);
+    return 0;
+}
+
+// ids become "#<id>" (known types "#<type name>"); in names, characters that aren't
+// allowed in file names (on any of the platforms), '%', a leading '#' and trailing
+// dots and spaces are written as %XX, so no two resources get the same file name
+template<typename Name>
+static string ToFileName(Name const& name, bool type)
+{
+    if (name.IsId()) return "#" + (type ? name.ToTypeString() : name.ToString());
+    const auto text = name.ToString();
+    const auto end = text.find_last_not_of(". ") + 1;
+    string result;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        const auto c = text[i];
+        if (static_cast<unsigned char>(c) < 0x20 || strchr("/\\:*?\"<>|%", c) || (c == '#' && i == 0) || i >= end)
+        {
+            static const char digits[] = "0123456789ABCDEF";
+            result += '%';
+            result += digits[static_cast<unsigned char>(c) >> 4];
+            result += digits[c & 0xF];
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+// Writes every selected resource to <outDir>/<type>/<name>_<lang>.bin, see
+// ToFileName. The resources are read in file order with coalesced reads, see
+// ResLib::ResourceReader, and the files are committed in batches. A resource
+// whose file name differs from an earlier one only in case is an error.
+static int ReadAll(CmdArgsParser const& args)
+{
+    const auto fileName = args.GetValue(strParam_in);
+    const auto outDir = args.GetValue(strParam_outDir);
+    ResLib::ResourceReader reader(fileName.c_str());
+    if (!reader.Add(GetSelectorArgs(args, strParam_id))) throw ResLib::InvalidResourceException("No matching resources in file '" + fileName + "'");
+
+    ResLib::SyncBatch batch;
+    std::vector<string> targets;
+    size_t errors = 0;
+    auto commit = [&]
+    {
+        const auto commitErrors = batch.Commit();
+        for (size_t i = 0; i < commitErrors.size(); ++i)
+        {
+            if (commitErrors[i].empty()) continue;
+            cerr << targets[i] << ": error: " << commitErrors[i] << "\n";
+            ++errors;
+        }
+        targets.clear();
+    };
+
+    std::set<string> directories;
+    std::set<string> written;   // lower case, for case-insensitive file systems
+    const auto result = reader.Read([&](size_t, ResLib::ResourceEntry const& entry, ResLib::Pe::Bytes data)
+    {
+        const auto directory = outDir + "/" + ToFileName(entry.type, true);
+        const auto target = directory + "/" + ToFileName(entry.name, false) + "_" + std::to_string(entry.lang) + ".bin";
+        auto key = target.substr(outDir.size());
+        std::transform(key.begin(), key.end(), key.begin(), [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; });
+        if (!written.insert(key).second)
+        {
+            cerr << target << ": error: written for another resource already\n";
+            ++errors;
+            return true;
+        }
+        if (directories.insert(directory).second) std::filesystem::create_directories(ResLib::PendingFile::ToPath(directory));
+        ResLib::PendingFile pending(target, false);
+        std::ofstream file(ResLib::PendingFile::ToPath(pending.TempName()), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        file.close();
+        if (!file) throw ResUtil::IoException(("Unable to write data: " + pending.Target()).c_str());
+        targets.push_back(pending.Target());
+        batch.Add(std::move(pending));
+        if (batch.Size() >= 256) commit();
+        return true;
+    });
+    commit();
+    cerr << result.resources << " resource(s) read with " << result.extents << " read(s) of " << result.bytesRead << " byte(s)" << (errors ? ", " + std::to_string(errors) + " error(s)" : std::string()) << "\n";
+    return errors ? 1 : 0;
+}
+
+// Copies the resource from the mapped image to the target, see ResUtil::WriteFileRange
+static int Read(CmdArgsParser const& args)
+{
+    if (args.HasValue(strParam_outDir)) return ReadAll(args);
+    if (!args.HasValue(strParam_out) || !args.HasValue(strParam_id))
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("arguments '") + strParam_out + "' and '" + strParam_id + "' or '" + strParam_outDir + "' are required");
+    }
+    const auto fileName = args.GetValue(strParam_in);
+    const auto type = ResLib::ResId::ParseType(args.GetValue(strParam_type).c_str());
+    const auto name = ResLib::ResId::Parse(args.GetValue(strParam_id).c_str());
+    std::optional<uint16_t> lang;
+    if (args.HasValue(strParam_lang)) lang = GetLangArg(args);
+
+    ResLib::MappedFile file(fileName.c_str());
+    ResLib::Pe::Image image(file.Data());
+    ResLib::ResourceDirectory resources(image);
+    const auto entry = resources.Find(type, name, lang);
+    if (!entry)
+    {
+        throw ResLib::InvalidResourceException("Resource " + type.ToTypeString() + "/" + name.ToString() + " not found in file '" + fileName + "'");
+    }
+    ResUtil::WriteFileRange(fileName.c_str(), entry->dataOffset, resources.GetData(*entry), args.GetValue(strParam_out).c_str());
+    return 0;
+}
+
+// Writes the input into the resource of every target, see ResFanOut.hpp
+static int Write(CmdArgsParser const& args)
+{
+    ResFanOut::Options options;
+    options.threads = GetCountArg(args, strParam_threads, 0);
+    options.queueDepth = GetCountArg(args, strParam_depth, 0);
+    options.batchSize = GetCountArg(args, strParam_batch, options.batchSize);
+    options.commit = GetCommitOptions(args);
+
+    ResFanOut fanOut(
+        ResLib::ResId::ParseType(args.GetValue(strParam_type).c_str()),
+        ResLib::ResId::Parse(args.GetValue(strParam_id).c_str()),
+        GetLangArg(args),
+        ResUtil::ReadData(args.GetValue(strParam_in).c_str()),
+        options);
+    const auto result = fanOut.Run(ResUtil::ExpandFileList(args.GetValue(strParam_out)), cout, cerr);
+    if (result.targets > 1) cerr << result.written << " of " << result.targets << " target(s) written\n";
+    return result.errors ? 1 : 0;
+}
+
+static int Archive(CmdArgsParser const& args)
+{
+    ResStore store(args.GetValue(strParam_store));
+    const auto label = args.HasValue(strParam_label) ? args.GetValue(strParam_label) : std::string("default");
+
+    int failed = 0;
+    ResStore::ArchiveResult total;
+    for (auto const& file : ResUtil::ExpandFileList(args.GetValue(strParam_in)))
+    {
+        try
+        {
+            const auto result = store.Archive(file, label);
+            cout << file << " -> " << result.index << ": " << result.resources << " resource(s), " << result.newBlobs << " new blob(s), " << result.newBytes << " new byte(s)\n";
+            total.resources += result.resources;
+            total.newBlobs += result.newBlobs;
+            total.newBytes += result.newBytes;
+        }
+        catch (const std::exception& e)
+        {
+            cerr << file << ": error: " << e.what() << "\n";
+            ++failed;
+        }
+    }
+    cout << total.resources << " resource(s) archived, " << total.newBlobs << " new blob(s) with " << total.newBytes << " byte(s), " << store.BlobCount() << " blob(s) in store" << endl;
+    return failed ? 1 : 0;
+}
+
+static int Restore(CmdArgsParser const& args)
+{
+    ResStore store(args.GetValue(strParam_store));
+    const auto count = store.Restore(args.GetValue(strParam_index), args.GetValue(strParam_out).c_str(), GetCommitOptions(args));
+    cout << count << " resource(s) restored" << endl;
+    return 0;
+}
+
+static int Search(CmdArgsParser const& args)
+{
+    const auto format = args.HasValue(strParam_format) ? args.GetValue(strParam_format) : std::string("text");
+    auto const& pattern = args.GetValue(strParam_pattern);
+    std::vector<ResSearch::Pattern> patterns;
+    if (format == "hex")
+    {
+        patterns.push_back({ "hex", ResLib::ByteSearch(ResSearch::ParseHex(pattern)) });
+    }
+    else if (format == "utf8" || format == "utf16" || format == "text")
+    {
+        if (pattern.empty()) throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), "empty pattern");
+        if (format != "utf16") patterns.push_back({ "utf8", ResLib::ByteSearch(std::vector<unsigned char>(pattern.begin(), pattern.end())) });
+        if (format != "utf8") patterns.push_back({ "utf16", ResLib::ByteSearch(ResSearch::Utf16Bytes(pattern)) });
+    }
+    else
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_format + "' must be 'hex', 'utf8', 'utf16' or 'text'");
+    }
+
+    std::optional<ResLib::ResId> type;
+    if (args.HasValue(strParam_type)) type = ResLib::ResId::ParseType(args.GetValue(strParam_type).c_str());
+
+    ResSearch search(std::move(patterns), type, GetCountArg(args, strParam_threads, 0));
+    const auto files = ResSearch::CollectFiles(ResUtil::ExpandFileList(args.GetValue(strParam_in)));
+    const auto result = search.Run(files, cout, cerr);
+    cerr << result.matches << " match(es) in " << result.files << " file(s)" << (result.errors ? ", " + std::to_string(result.errors) + " error(s)" : std::string()) << "\n";
+    return result.errors ? 2 : result.matches ? 0 : 1;
+}
+
+// Prints the files that contain a resource of the given type (and id/lang).
+// Each directory is read only up to the first match.
+static int Has(CmdArgsParser const& args)
+{
+    ResLib::ResourceDirectory::Filter filter;
+    filter.type = ResLib::ResId::ParseType(args.GetValue(strParam_type).c_str());
+    if (args.HasValue(strParam_id)) filter.name = ResLib::ResId::Parse(args.GetValue(strParam_id).c_str());
+    if (args.HasValue(strParam_lang)) filter.lang = GetLangArg(args);
+
+    size_t found = 0;
+    size_t errors = 0;
+    for (auto const& file : ResSearch::CollectFiles(ResUtil::ExpandFileList(args.GetValue(strParam_in))))
+    {
+        try
+        {
+            std::error_code ec;
+            if (std::filesystem::file_size(file, ec) == 0 && !ec) continue;
+            ResLib::MappedFile mapped(file.c_str());
+            if (!ResSearch::IsImage(mapped.Data())) continue;
+            ResLib::Pe::Image image(mapped.Data());
+            if (ResLib::ResourceDirectory(image).Contains(filter))
+            {
+                cout << file << '\n';
+                ++found;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            cerr << file << ": error: " << e.what() << "\n";
+            ++errors;
+        }
+    }
+    cout.flush();
+    return errors ? 2 : found ? 0 : 1;
+}
+
+// Builds a resource-only DLL from the resources listed in the spec file,
+// one 'input;type;id[;lang]' per line (inputs relative to the spec file)
+static int Create(CmdArgsParser const& args)
+{
+    ResLib::ImageOptions options;
+    if (args.HasValue(strParam_machine))
+    {
+        auto const& machine = args.GetValue(strParam_machine);
+        if (machine == "x86") options.machine = ResLib::Pe::MachineI386;
+        else if (machine == "x64") options.machine = ResLib::Pe::MachineAmd64;
+        else if (machine == "arm64") options.machine = ResLib::Pe::MachineArm64;
+        else throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + strParam_machine + "' must be 'x86', 'x64' or 'arm64'");
+    }
+    options.layout = GetLayoutArg(args, false);
+
+    const auto specFile = args.GetValue(strParam_spec);
+    std::ifstream spec(specFile);
+    if (!spec) throw ResUtil::IoException(("Unable to open spec file: " + specFile).c_str());
+    const auto base = std::filesystem::absolute(specFile).parent_path();
+
+    ResLib::ResourceTable table;
+    size_t lineNumber = 0;
+    for (std::string line; std::getline(spec, line);)
+    {
+        ++lineNumber;
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        if (line.empty() || line.front() == '#') continue;
+
+        const auto fields = StringHelper::split(line, ';');
+        const auto where = specFile + "(" + std::to_string(lineNumber) + "): ";
+        if (fields.size() != 3 && fields.size() != 4) throw ResUtil::IoException((where + "expected input;type;id[;lang]").c_str());
+        uint16_t lang = 0;
+        if (fields.size() == 4)
+        {
+            const auto id = ResLib::ResId::Parse(fields[3].c_str());
+            if (!id.IsId()) throw ResUtil::IoException((where + "invalid language id").c_str());
+            lang = id.id;
+        }
+        table.Set(ResLib::ResId::ParseType(fields[1].c_str()), ResLib::ResId::Parse(fields[2].c_str()), lang,
+            ResUtil::ReadData((base / fields[0]).string().c_str()));
+    }
+
+    const auto image = ResLib::CreateResourceImage(table, options);
+    ResUtil::WriteData(image, args.GetValue(strParam_out).c_str());
+    return 0;
+}
+
+// Merges all resources of a .res file into the target with one commit
+static int ImportRes(CmdArgsParser const& args)
+{
+    const auto resFile = args.GetValue(strParam_in);
+    const auto target = args.GetValue(strParam_out);
+    ResLib::MappedFile file(resFile.c_str());
+    ResLib::UpdateSession session(target.c_str(), GetCommitOptions(args));
+    size_t count = 0;
+    ResLib::ResFile::ForEach(file.Data(), [&](ResLib::ResFile::Record const& record)
+    {
+        session.Set(record.type, record.name, record.lang, record.data.data(), static_cast<uint32_t>(record.data.size()));
+        ++count;
+        return true;
+    });
+    session.Commit();
+    cout << count << " resource(s) imported" << endl;
+    return 0;
+}
+
+static int ExportRes(CmdArgsParser const& args)
+{
+    const auto fileName = args.GetValue(strParam_in);
+    ResLib::MappedFile file(fileName.c_str());
+    ResLib::Pe::Image image(file.Data());
+    ResUtil::WriteData(ResLib::ResFile::Export(ResLib::ResourceDirectory(image)), args.GetValue(strParam_out).c_str());
+    return 0;
+}
+
+// Prints the names of the selected resources, each once per type. The
+// filters are applied while the directory is walked (see ForEachSelected).
+static int Enum(CmdArgsParser const& args)
+{
+    const auto fileName = args.GetValue(strParam_in);
+    ResLib::MappedFile file(fileName.c_str());
+    ResLib::Pe::Image image(file.Data());
+    const ResLib::ResourceDirectory resources(image);
+    const auto selector = GetSelectorArgs(args, strParam_id);
+    std::ios::sync_with_stdio(false);
+
+    // "type<TAB>name" as soon as the names of several types can be listed
+    if (selector.CanMatchTypes())
+    {
+        ResLib::ForEachSelectedName(resources, selector, [](ResLib::ResNameRef const& type, ResLib::ResNameRef const& name)
+        {
+            cout << type.ToTypeString() << '\t' << name.ToString() << '\n';
+        });
+        cout.flush();
+        return 0;
+    }
+
+    for (auto const& name : ResLib::ListNames(resources, selector))
+    {
+        if (name.IsId()) cout << name.id << '\n';
+        else cout << name.name << '\n';
+    }
+    cout.flush();
+    return 0;
+}
+
+// Removes the selected resources from every target, see ResRemove.hpp
+static int Remove(CmdArgsParser const& args)
+{
+    ResRemove::Options options;
+    options.threads = GetCountArg(args, strParam_threads, 0);
+    options.batchSize = GetCountArg(args, strParam_batch, options.batchSize);
+    options.commit = GetCommitOptions(args);
+
+    ResRemove remove(GetSelectorArgs(args, strParam_id), options);
+    const auto result = remove.Run(ResUtil::ExpandFileList(args.GetValue(strParam_in)), cout, cerr);
+    cerr << result.removed << " resource(s) removed from " << result.changed << " of " << result.files << " file(s), " << result.bytesSaved << " byte(s) saved" << (result.errors ? ", " + std::to_string(result.errors) + " error(s)" : std::string()) << "\n";
+    return result.errors ? 1 : 0;
+}
+
+// Writes the resource changes between two builds as patch bundle, see ResLib/ResPatch.hpp
+static int MakePatch(CmdArgsParser const& args)
+{
+    ResLib::MappedFile fromFile(args.GetValue(strParam_from).c_str());
+    ResLib::MappedFile toFile(args.GetValue(strParam_to).c_str());
+    const ResLib::Pe::Image fromImage(fromFile.Data());
+    const ResLib::Pe::Image toImage(toFile.Data());
+    const auto ops = ResLib::ResPatch::MakePatch(ResLib::ResourceDirectory(fromImage), ResLib::ResourceDirectory(toImage));
+
+    std::ostringstream bundle(std::ios::binary);
+    ResLib::ResPatch::Write(bundle, ops);
+    const auto bytes = std::move(bundle).str();
+    ResUtil::WriteData(std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size()), args.GetValue(strParam_out).c_str());
+
+    uint64_t payload = 0;
+    size_t removed = 0;
+    for (auto const& op : ops)
+    {
+        payload += op.size;
+        if (op.kind == ResLib::ResPatch::OpKind::Remove) ++removed;
+    }
+    cerr << ops.size() - removed << " resource(s) set, " << removed << " removed, " << payload << " byte(s) of data in a " << bytes.size() << " byte bundle\n";
+    return 0;
+}
+
+// Applies a patch bundle to many files, see ResPatcher.hpp
+static int ApplyPatch(CmdArgsParser const& args)
+{
+    ResPatcher::Options options;
+    options.threads = GetCountArg(args, strParam_threads, 0);
+    options.batchSize = GetCountArg(args, strParam_batch, options.batchSize);
+    options.commit = GetCommitOptions(args);
+
+    ResPatcher patcher(args.GetValue(strParam_patch).c_str(), options);
+    const auto result = patcher.Run(ResUtil::ExpandFileList(args.GetValue(strParam_in)), cout, cerr);
+    cerr << result.patched << " of " << result.files << " file(s) patched, " << result.upToDate << " already patched, " << result.rejected << " rejected" << (result.errors ? ", " + std::to_string(result.errors) + " error(s)" : std::string()) << "\n";
+    return result.errors || result.rejected ? 1 : 0;
+}
+
+// Rebuilds the resource sections with the given layout (default: locality)
+// and reports the pages they take before and after
+static int Relayout(CmdArgsParser const& args)
+{
+    auto options = GetCommitOptions(args);
+    options.layout = GetLayoutArg(args, true);
+    auto countPages = [&](std::string const& fileName)
+    {
+        ResLib::MappedFile file(fileName.c_str());
+        const ResLib::Pe::Image image(file.Data());
+        return ResLib::CountPages(ResLib::ResourceDirectory(image), options.layout.pageSize);
+    };
+
+    size_t errors = 0;
+    for (auto const& fileName : ResUtil::ExpandFileList(args.GetValue(strParam_in)))
+    {
+        try
+        {
+            const auto before = countPages(fileName);
+            ResLib::NativeUpdateSession session(fileName.c_str(), options);
+            session.Commit();
+            const auto after = countPages(fileName);
+            cout << fileName << ": startup " << before.startup << " -> " << after.startup << " page(s), large resources "
+                << before.large << " -> " << after.large << " page(s) (at least " << after.largeMinimum << "), section "
+                << before.section << " -> " << after.section << " page(s)\n";
+        }
+        catch (std::exception const& e)
+        {
+            cerr << fileName << ": error: " << e.what() << "\n";
+            ++errors;
+        }
+    }
+    return errors ? 1 : 0;
+}
+
+// Checks the resource sections of files and directory trees, see ResValidate.hpp
+static int Validate(CmdArgsParser const& args)
+{
+    ResValidate validate(GetCountArg(args, strParam_threads, 0));
+    const auto files = ResSearch::CollectFiles(ResUtil::ExpandFileList(args.GetValue(strParam_in)));
+    const auto result = validate.Run(files, cout, cerr);
+    cerr << result.defects << " defect(s) in " << result.defective << " of " << result.files << " image(s)" << (result.errors ? ", " + std::to_string(result.errors) + " error(s)" : std::string()) << "\n";
+    return result.errors ? 2 : result.defects ? 1 : 0;
+}
+
+#ifndef _WIN32
+static ResServer* runningServer = nullptr;
+
+static int Serve(CmdArgsParser const& args)
+{
+    ResServer::Options options;
+    options.socketPath = args.GetValue(strParam_socket);
+    options.threads = GetCountArg(args, strParam_threads, 0);
+    options.cacheSize = GetCountArg(args, strParam_cache, options.cacheSize);
+
+    ResServer server(options);
+    runningServer = &server;
+    auto stop = [](int) { if (runningServer) runningServer->Stop(); };
+    ::signal(SIGINT, stop);
+    ::signal(SIGTERM, stop);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    server.Run();
+    runningServer = nullptr;
+    cerr << server.Requests() << " request(s) served, " << server.Cache().Hits() << " cache hit(s), " << server.Cache().Misses() << " miss(es)\n";
+    return 0;
+}
+#endif
+
+#ifdef _WIN32
+static ResLib::VersionInfo::Version ParseVersionArg(CmdArgsParser const& args, const char* param)
+{
+    try
+    {
+        return ResLib::VersionInfo::ParseVersion(args.GetValue(param));
+    }
+    catch (const ResLib::InvalidArgsException&)
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), std::string("argument '") + param + "' is not a valid version");
+    }
+}
+
+static int SetVersion(CmdArgsParser const& args)
+{
+    ResLib::VersionInfo::Update update;
+    if (args.HasValue(strParam_fileVersion)) update.fileVersion = ParseVersionArg(args, strParam_fileVersion);
+    if (args.HasValue(strParam_productVersion)) update.productVersion = ParseVersionArg(args, strParam_productVersion);
+    for (auto const& pair : StringHelper::split(args.GetValue(strParam_strings), ';'))
+    {
+        auto pos = pair.find('=');
+        if (pos == string::npos || pos == 0)
+        {
+            throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), "version string '" + pair + "' is not of the form key=value");
+        }
+        update.strings.emplace_back(pair.substr(0, pos), pair.substr(pos + 1));
+    }
+    if (update.Empty())
+    {
+        throw CmdArgsParser::InvalidCommandArgsException(args.GetCommand(), "nothing to update");
+    }
+
+    const auto options = GetCommitOptions(args);
+    int failed = 0;
+    for (auto const& file : ResUtil::ExpandFileList(args.GetValue(strParam_in)))
+    {
+        try
+        {
+            auto result = ResLib::SetVersion(file.c_str(), update, options);
+            cout << file << ": " << (result == ResLib::VersionInfo::Result::PatchedInPlace ? "patched in place" : "rewritten") << "\n";
+        }
+        catch (const std::exception& e)
+        {
+            cerr << file << ": error: " << e.what() << "\n";
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
+#endif
+
+#ifdef _WIN32
 int wmain(int argc, wchar_t** argv)
+#else
+int main(int argc, char** argv)
+#endif
 {
     CmdArgsParser argsParser{ "ResUtil v0.4 (c) 2015 Florian Muecke" };
 
     argsParser.Add({ strCommand_write, "write raw data into the specified file resource",
     {
-        { strParam_in, "file containing the raw data" },
-        { strParam_out, "target file" },
+        { strParam_in, "file containing the raw data or - for stdin" },
+        { strParam_out, "target file(s), separated by ';', given as @listfile or with wildcards" },
         { strParam_type, "type of the resouce (see below)" },
         { strParam_id, "resource id" },
-        //{"lang", "language id", CmdArgsParser::RequiredArg::no }
+        { strParam_lang, "language id (default: neutral)", CmdArgsParser::RequiredArg::no },
+        { strParam_threads, "number of targets updated in parallel (default: one per core)", CmdArgsParser::RequiredArg::no },
+        { strParam_depth, "number of targets written to disk at once (default: threads)", CmdArgsParser::RequiredArg::no },
+        { strParam_batch, "number of targets flushed to disk and replaced together (default: 256)", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
         } });
 
-    argsParser.Add({ strCommand_read, "read the specified resource and dump it to disk",
+    argsParser.Add({ strCommand_read, "read the specified resource and dump it to disk, or all selected resources to a directory",
     {
         { strParam_in, "source file" },
-        { strParam_out, "target file" },
-        { strParam_type, "type of the resouce (see below)" },
-        { strParam_id, "resource id" },
-        //{ "lang", "the language id" }
+        { strParam_out, "target file or - for stdout", CmdArgsParser::RequiredArg::no },
+        { strParam_outDir, "target directory for all selected resources, written to <type>/<name>_<lang>.bin, ids as #<id>", CmdArgsParser::RequiredArg::no },
+        { strParam_type, "type of the resouce (see below); with outDir: types separated by ';', '*' and '?' as wildcards" },
+        { strParam_id, "resource id; with outDir: names, name patterns or id ranges separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
+        { strParam_lang, "language id (default: the first one listed); with outDir: language id(s) separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
     } });
 
-    argsParser.Add({ strCommand_enum, "enumerate resources of a given type",
+    argsParser.Add({ strCommand_enum, "enumerate the names of the resources of a given type",
     {
         { strParam_in, "source file" },
-        { strParam_type, "type of the resouces (see below)" },
-        //{ "lang", "language id" }
+        { strParam_type, "type(s) of the resources, separated by ';', '*' and '?' as wildcards (see below); names are printed as type<TAB>name unless it is a single type" },
+        { strParam_id, "resource id(s), name pattern(s) or id ranges (e.g. '100-199'), separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
+        { strParam_lang, "language id(s), separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
+        { strParam_minSize, "only resources of at least this many bytes", CmdArgsParser::RequiredArg::no },
+        { strParam_maxSize, "only resources of at most this many bytes", CmdArgsParser::RequiredArg::no },
     } });
 
+#ifdef _WIN32
     argsParser.Add({ strCommand_enumTypes, "enumerate resources types",
     {
         { strParam_in, "source file" },
         //{ "lang", "language id" }
     } });
 
+    argsParser.Add({ strCommand_setVersion, "update file/product version and version strings in place",
+    {
+        { strParam_in, "target file(s), separated by ';' or given as @listfile" },
+        { strParam_fileVersion, "file version, e.g. 1.2.3.4", CmdArgsParser::RequiredArg::no },
+        { strParam_productVersion, "product version, e.g. 1.2.3.4", CmdArgsParser::RequiredArg::no },
+        { strParam_strings, "version strings, e.g. CompanyName=ACME;ProductName=Foo", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_writeIcon, "write an .ico file as icon group, storing identical images only once",
+    {
+        { strParam_in, "icon file (.ico)" },
+        { strParam_out, "target file" },
+        { strParam_id, "resource id of the icon group" },
+        { strParam_lang, "language id (default: neutral)", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+#endif
+
+    argsParser.Add({ strCommand_messages, "resolve message ids using the message tables of the given modules",
+    {
+        { strParam_in, "source file(s), separated by ';' or given as @listfile" },
+        { strParam_ids, "message ids (decimal or 0x hex), separated by ';', @listfile or - for stdin" },
+        { strParam_lang, "language id (default: any)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_watch, "watch input files and write changed ones into their target resources",
+    {
+        { strParam_spec, "file with one 'input;target;type;id[;lang]' mapping per line" },
+        { strParam_debounce, "milliseconds without changes before updating (default: 200)", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_archive, "store the resources of binaries in a content addressable store (see ResStore.hpp)",
+    {
+        { strParam_in, "source file(s), separated by ';' or given as @listfile" },
+        { strParam_store, "store directory, created if missing" },
+        { strParam_label, "index directory for this run, e.g. a build number (default: 'default')", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_restore, "write the resources of an archived binary into a file",
+    {
+        { strParam_store, "store directory" },
+        { strParam_index, "archived binary as <label>/<path>, as printed by archive" },
+        { strParam_out, "target file" },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_search, "find a byte pattern or string in the resources of files or directory trees",
+    {
+        { strParam_in, "files or directories (searched recursively), separated by ';' or given as @listfile" },
+        { strParam_pattern, "the pattern, e.g. 'Copyright' or '4D 5A 90'" },
+        { strParam_format, "hex, utf8, utf16 or text (= utf8 and utf16, default)", CmdArgsParser::RequiredArg::no },
+        { strParam_type, "only search resources of this type", CmdArgsParser::RequiredArg::no },
+        { strParam_threads, "number of worker threads (default: one per core)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_has, "list the files containing a resource of the given type, e.g. a manifest",
+    {
+        { strParam_in, "files or directories (searched recursively), separated by ';' or given as @listfile" },
+        { strParam_type, "type of the resource (see below)" },
+        { strParam_id, "resource id (default: any)", CmdArgsParser::RequiredArg::no },
+        { strParam_lang, "language id (default: any)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_create, "create a resource-only DLL from the resources listed in a spec file",
+    {
+        { strParam_spec, "file with one 'input;type;id[;lang]' entry per line" },
+        { strParam_out, "target file or - for stdout" },
+        { strParam_machine, "x86, x64 or arm64 (default: x64)", CmdArgsParser::RequiredArg::no },
+        { strParam_layout, "'locality' (startup resources first, large ones page aligned) or 'compact' (default)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_importRes, "write all resources of a compiled .res file into the target",
+    {
+        { strParam_in, "resource file (.res)" },
+        { strParam_out, "target file" },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_remove, "remove all matching resources from the target files, rebuilding each resource section once",
+    {
+        { strParam_in, "target file(s), separated by ';', given as @listfile or with wildcards" },
+        { strParam_type, "type(s) of the resources, separated by ';', '*' and '?' as wildcards (e.g. 'dialog;bitmap' or '*')" },
+        { strParam_id, "resource id(s), name pattern(s) or id ranges (e.g. '100-199'), separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
+        { strParam_lang, "language id(s) to remove, separated by ';' (default: all)", CmdArgsParser::RequiredArg::no },
+        { strParam_exceptLang, "language id(s) to keep, separated by ';'", CmdArgsParser::RequiredArg::no },
+        { strParam_minSize, "only resources of at least this many bytes", CmdArgsParser::RequiredArg::no },
+        { strParam_maxSize, "only resources of at most this many bytes", CmdArgsParser::RequiredArg::no },
+        { strParam_threads, "number of files updated in parallel (default: one per core)", CmdArgsParser::RequiredArg::no },
+        { strParam_batch, "number of files flushed to disk and replaced together (default: 256)", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_makePatch, "write the resource changes between two builds as patch bundle",
+    {
+        { strParam_from, "old build" },
+        { strParam_to, "new build" },
+        { strParam_out, "patch bundle or - for stdout" },
+    } });
+
+    argsParser.Add({ strCommand_applyPatch, "apply a patch bundle to every target that is the old build, with one commit each",
+    {
+        { strParam_patch, "patch bundle (see makePatch)" },
+        { strParam_in, "target file(s), separated by ';', given as @listfile or with wildcards" },
+        { strParam_threads, "number of files updated in parallel (default: one per core)", CmdArgsParser::RequiredArg::no },
+        { strParam_batch, "number of files flushed to disk and replaced together (default: 256)", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_relayout, "rebuild the resource sections of the targets and report the pages they take before and after",
+    {
+        { strParam_in, "target file(s), separated by ';', given as @listfile or with wildcards" },
+        { strParam_layout, "'locality' (startup resources first, large ones page aligned, default) or 'compact'", CmdArgsParser::RequiredArg::no },
+        { strParam_checksum, "'update' or 'keep' the PE checksum (default: keep)", CmdArgsParser::RequiredArg::no },
+        { strParam_signed, "'refuse' or 'strip' signed files (default: refuse)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_validate, "check the resource sections of files or directory trees for structural defects",
+    {
+        { strParam_in, "files or directories (searched recursively), separated by ';' or given as @listfile" },
+        { strParam_threads, "number of worker threads (default: one per core)", CmdArgsParser::RequiredArg::no },
+    } });
+
+    argsParser.Add({ strCommand_exportRes, "save all resources of a file as compiled .res file",
+    {
+        { strParam_in, "source file" },
+        { strParam_out, "resource file (.res) or - for stdout" },
+    } });
+
+#ifndef _WIN32
+    argsParser.Add({ strCommand_serve, "answer read/enum/hash requests on a unix domain socket (see ResServer.hpp)",
+    {
+        { strParam_socket, "path of the socket" },
+        { strParam_threads, "number of worker threads (default: one per core)", CmdArgsParser::RequiredArg::no },
+        { strParam_cache, "number of modules kept mapped (default: 256)", CmdArgsParser::RequiredArg::no },
+    } });
+#endif
+
     //argsParser.Add({ strCommand_copy, "copy a resource from one file to another",
     //{
     //    { strParam_in, "source file" },
@@ -80,7 +1021,7 @@ int wmain(int argc, wchar_t** argv)
     {
         stringstream helpText;
         helpText << "Predefined resource types are: ";
-        helpText << StringHelper::join(ResLib::Types::ResNameToValueMap) << endl;
+        helpText << StringHelper::join(ResLib::Types::ResNameToIdMap) << endl;
         helpText << "Custom types can be specified as strings";
         argsParser.AddAdditionalHelp(helpText.str());
     }
@@ -103,45 +1044,109 @@ int wmain(int argc, wchar_t** argv)
 
     try
     {
-        if (argsParser.GetCommand() == strCommand_enumTypes)
+        if (argsParser.GetCommand() == strCommand_write)
         {
-            auto types = ResLib::EnumerateTypes(argsParser.GetValue(strParam_in).c_str());
-            cout << StringHelper::join(types, "\n") << endl;
+            return Write(argsParser);
         }
-        else
+        else if (argsParser.GetCommand() == strCommand_read)
         {
-            if (argsParser.GetCommand() == strCommand_write)
-            {
-                //auto lang = langId.empty() ? WORD(MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL)) : static_cast<WORD>(stoi(langId));
-                auto data = ResUtil::ReadData(argsParser.GetValue(strParam_in).c_str());
-                ResLib::Write(data, argsParser.GetValue(strParam_out).c_str(), argsParser.GetValue(strParam_type).c_str(), argsParser.GetValue(strParam_id).c_str());
-            }
-            else if (argsParser.GetCommand() == strCommand_read)
-            {
-                auto data = ResLib::Read(
-                    argsParser.GetValue(strParam_in).c_str(),
-                    argsParser.GetValue(strParam_type).c_str(),
-                    argsParser.GetValue(strParam_id).c_str());
-
-                ResUtil::WriteData(data, argsParser.GetValue(strParam_out).c_str());
-            }
-            else if (argsParser.GetCommand() == strCommand_enum)
-            {
-                auto data = ResLib::Enum(
-                    argsParser.GetValue(strParam_in).c_str(),
-                    argsParser.GetValue(strParam_type).c_str());
-
-                cout << StringHelper::join(data, "\n") << endl;
-            }
-            //else if (argsParser.GetCommand() == strCommand_copy)
-            //{
-            //    throw std::exception("NOT IMPLEMENTED");
-            //}
-            else
+            return Read(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_messages)
+        {
+            return ResolveMessages(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_watch)
+        {
+            return Watch(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_archive)
+        {
+            return Archive(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_restore)
+        {
+            return Restore(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_search)
+        {
+            return Search(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_has)
+        {
+            return Has(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_create)
+        {
+            return Create(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_importRes)
+        {
+            return ImportRes(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_exportRes)
+        {
+            return ExportRes(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_validate)
+        {
+            return Validate(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_remove)
+        {
+            return Remove(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_makePatch)
+        {
+            return MakePatch(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_applyPatch)
+        {
+            return ApplyPatch(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_relayout)
+        {
+            return Relayout(argsParser);
+        }
+        else if (argsParser.GetCommand() == strCommand_enum)
+        {
+            return Enum(argsParser);
+        }
+#ifndef _WIN32
+        else if (argsParser.GetCommand() == strCommand_serve)
+        {
+            return Serve(argsParser);
+        }
+#endif
+#ifdef _WIN32
+        else if (argsParser.GetCommand() == strCommand_enumTypes)
+        {
+            for (auto const& type : ResLib::ListTypes(argsParser.GetValue(strParam_in).c_str()))
             {
-                cerr << argsParser.HelpText();
-                return ERROR_BAD_ARGUMENTS;
+                if (type.IsId()) cout << ResLib::Types::GetTypeName(type.id) << '\n';
+                else cout << type.name << '\n';
             }
+            cout << flush;
+        }
+        else if (argsParser.GetCommand() == strCommand_writeIcon)
+        {
+            auto data = ResUtil::ReadData(argsParser.GetValue(strParam_in).c_str());
+            auto result = ResLib::WriteIcon(data, argsParser.GetValue(strParam_out).c_str(), argsParser.GetValue(strParam_id).c_str(), GetLangArg(argsParser), GetCommitOptions(argsParser));
+            cout << result.added << " image(s) added, " << result.reused << " reused, " << result.removed << " removed" << endl;
+        }
+        else if (argsParser.GetCommand() == strCommand_setVersion)
+        {
+            return SetVersion(argsParser);
+        }
+#endif
+        //else if (argsParser.GetCommand() == strCommand_copy)
+        //{
+        //    throw std::exception("NOT IMPLEMENTED");
+        //}
+        else
+        {
+            cerr << argsParser.HelpText();
+            return ERROR_BAD_ARGUMENTS;
         }
     }
     catch (const std::exception& e)
@@ -150,4 +1155,3 @@ int wmain(int argc, wchar_t** argv)
         return 1;
     }
 }
-
@@ -10,10 +10,14 @@
 // If you wish to build your application for a previous Windows platform, include WinSDKVer.h and
 // set the _WIN32_WINNT macro to the platform you wish to support before including SDKDDKVer.h.
 
+#ifdef _WIN32
 #include <SDKDDKVer.h>
+#endif
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#ifdef _WIN32
 #include <Windows.h>
+#endif